@@ -20,6 +20,13 @@
 #include "utils/timeutil.h" //for getRealTime()
 #include "utils/progress.h" //for progress_display
 #include "alignmentsummary.h"
+#include <functional>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if !defined(WIN32) && !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include <Eigen/LU>
 #ifdef USE_BOOST
@@ -538,13 +545,16 @@ Alignment::Alignment(char *filename, char *sequence_type, InputType &intype, str
             readNexus(filename);
         } else if (intype == IN_FASTA) {
             cout << "Fasta format detected" << endl;
-            readFasta(filename, sequence_type);
+            if (!Params::getInstance().stream_alignment || !readStreaming(filename, sequence_type, intype))
+                readFasta(filename, sequence_type);
         } else if (intype == IN_PHYLIP) {
             cout << "Phylip format detected" << endl;
-            if (Params::getInstance().phylip_sequential_format)
-                readPhylipSequential(filename, sequence_type);
-            else
-                readPhylip(filename, sequence_type);
+            if (!Params::getInstance().stream_alignment || !readStreaming(filename, sequence_type, intype)) {
+                if (Params::getInstance().phylip_sequential_format)
+                    readPhylipSequential(filename, sequence_type);
+                else
+                    readPhylip(filename, sequence_type);
+            }
         } else if (intype == IN_COUNTS) {
             cout << "Counts format (PoMo) detected" << endl;
             readCountsFormat(filename, sequence_type);
@@ -1105,14 +1115,16 @@ bool Alignment::addPatternLazy(Pattern &pat, int site, int freq, bool& gaps_only
             cout << "Site " << site << " contains only gaps or ambiguous characters" << endl;
         }
     }
-    PatternIntMap::iterator pat_it = pattern_index.find(pat);
+    // the key buffer keeps its memory, only new patterns copy it into the index
+    packed_key.pack(pat);
+    PatternIntMap::iterator pat_it = pattern_index.find(packed_key);
     if (pat_it == pattern_index.end()) { // not found
         pat.frequency = freq;
         //We don't do computeConst(pat); here, that's why
         //there's a "Lazy" in this member function's name!
         //We do that in addPattern...
         push_back(pat);
-        pattern_index[back()] = size()-1;
+        pattern_index[packed_key] = size()-1;
         site_pattern[site] = size()-1;
         return true;
     } else {
@@ -1344,6 +1356,46 @@ SeqType Alignment::detectSequenceType(StrVector &sequences) {
     return SEQ_UNKNOWN;
 }
 
+SeqType Alignment::detectSequenceType(size_t *char_count) {
+    size_t num_nuc   = 0;
+    size_t num_ungap = 0;
+    size_t num_bin   = 0;
+    size_t num_alpha = 0;
+    size_t num_digit = 0;
+    // same classification as detectSequenceType(StrVector&)
+    for (int c = 0; c < NUM_CHAR; c++) {
+        size_t count = char_count[c];
+        if (count == 0)
+            continue;
+        if (c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'U') {
+            num_nuc += count;
+            num_ungap += count;
+            continue;
+        }
+        if (c == '?' || c == '-' || c == '.')
+            continue;
+        if (c != 'N' && c != 'X' && c != '~') {
+            num_ungap += count;
+            if (isdigit(c)) {
+                num_digit += count;
+                if (c == '0' || c == '1')
+                    num_bin += count;
+            }
+        }
+        if (isalpha(c))
+            num_alpha += count;
+    }
+    if (((double)num_nuc) / num_ungap > 0.9)
+        return SEQ_DNA;
+    if (num_bin == num_ungap) // For binary data, only 0, 1, ?, -, . can occur
+        return SEQ_BINARY;
+    if (((double)num_alpha + num_nuc) / num_ungap > 0.9)
+        return SEQ_PROTEIN;
+    if (((double)(num_alpha + num_digit + num_nuc)) / num_ungap > 0.9)
+        return SEQ_MORPH;
+    return SEQ_UNKNOWN;
+}
+
 void Alignment::buildStateMap(char *map, SeqType seq_type) {
     memset(map, STATE_INVALID, NUM_CHAR);
     ASSERT(STATE_UNKNOWN < 126);
@@ -1679,6 +1731,15 @@ int getMorphStates(StrVector &sequences) {
 	return 0;
 }
 
+int getMorphStates(size_t *char_count) {
+	int maxstate = 0;
+	for (int c = 0; c < NUM_CHAR; c++)
+		if (char_count[c] && c > maxstate && isalnum(c)) maxstate = c;
+	if (maxstate >= '0' && maxstate <= '9') return (maxstate - '0' + 1);
+	if (maxstate >= 'A' && maxstate <= 'V') return (maxstate - 'A' + 11);
+	return 0;
+}
+
 SeqType Alignment::getSeqType(const char *sequence_type) {
     SeqType user_seq_type = SEQ_UNKNOWN;
     if (strcmp(sequence_type, "BIN") == 0) {
@@ -1722,7 +1783,8 @@ string Alignment::getSeqTypeStr(SeqType sequence_type) {
     }
 }
 
-int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite) {
+int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite,
+                            vector<IntVector> *column_sites, size_t *char_count) {
     int seq_id;
     ostringstream err_str;
     codon_table = NULL;
@@ -1753,10 +1815,12 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         cout << "Duplicate sequence name check took " << (getRealTime()-seqCheckStart) << " seconds." << endl;
     }
     /* now check that all sequences have the same length */
+    // only distinct columns are stored if column_sites is given
+    int seq_len = column_sites ? sequences[0].length() : nsite;
     for (seq_id = 0; seq_id < nseq; seq_id ++) {
-        if (sequences[seq_id].length() != nsite) {
+        if (sequences[seq_id].length() != seq_len) {
             err_str << "Sequence " << seq_names[seq_id] << " contains ";
-            if (sequences[seq_id].length() < nsite)
+            if (sequences[seq_id].length() < seq_len)
                 err_str << "not enough";
             else
                 err_str << "too many";
@@ -1769,7 +1833,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         throw err_str.str();
 
     /* now check data type */
-    seq_type = detectSequenceType(sequences);
+    seq_type = char_count ? detectSequenceType(char_count) : detectSequenceType(sequences);
     switch (seq_type) {
     case SEQ_BINARY:
         num_states = 2;
@@ -1784,7 +1848,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         cout << "Alignment most likely contains protein sequences" << endl;
         break;
     case SEQ_MORPH:
-        num_states = getMorphStates(sequences);
+        num_states = char_count ? getMorphStates(char_count) : getMorphStates(sequences);
         if (num_states < 2 || num_states > 32) throw "Invalid number of states.";
         cout << "Alignment most likely contains " << num_states << "-state morphological data" << endl;
         break;
@@ -1816,7 +1880,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             nt2aa = true;
             cout << "Translating to amino-acid sequences with genetic code " << &sequence_type[5] << " ..." << endl;
         } else if (strcmp(sequence_type, "NUM") == 0 || strcmp(sequence_type, "MORPH") == 0) {
-            num_states = getMorphStates(sequences);
+            num_states = char_count ? getMorphStates(char_count) : getMorphStates(sequences);
             if (num_states < 2 || num_states > 32) throw "Invalid number of states";
             user_seq_type = SEQ_MORPH;
         } else if (strcmp(sequence_type, "TINA") == 0 || strcmp(sequence_type, "MULTI") == 0) {
@@ -1860,7 +1924,9 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     int num_error = 0;
     
     progress_display progress(nsite, "Constructing alignment", "examined", "site");
-    for (site = 0; site < nsite; site+=step) {
+    for (site = 0; site < seq_len; site+=step) {
+        // site number in the alignment for messages
+        int aln_site = column_sites ? (*column_sites)[site/step][0]*step : site;
         for (seq = 0; seq < nseq; seq++) {
             //char state = convertState(sequences[seq][site], seq_type);
             char state = char_to_state[(int)(sequences[seq][site])];
@@ -1874,7 +1940,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             		if (genetic_code[(int)state] == '*') {
                         err_str << "Sequence " << seq_names[seq] << " has stop codon " <<
                         		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1 << endl;
+                        		" at site " << aln_site+1 << endl;
                         num_error++;
                         state = STATE_UNKNOWN;
             		} else if (nt2aa) {
@@ -1889,7 +1955,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             			ostringstream warn_str;
                         warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
                         		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1;
+                        		" at site " << aln_site+1;
                         outWarning(warn_str.str());
             		}
             		state = STATE_UNKNOWN;
@@ -1900,20 +1966,33 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
                     err_str << "Sequence " << seq_names[seq] << " has invalid character " << sequences[seq][site];
                     if (seq_type == SEQ_CODON)
                         err_str << sequences[seq][site+1] << sequences[seq][site+2];
-                    err_str << " at site " << site+1 << endl;
+                    err_str << " at site " << aln_site+1 << endl;
                 } else if (num_error == 100)
                     err_str << "...many more..." << endl;
                 num_error++;
             }
             pat[seq] = state;
         }
-        if (!num_error)
-        {
+        if (!num_error && column_sites) {
+            // all sites with the same column share the pattern
+            IntVector &sites = (*column_sites)[site/step];
             bool gaps_only;
-            addPatternLazy(pat, site/step, 1, gaps_only);
-            num_gaps_only += gaps_only ? 1 : 0;
+            addPatternLazy(pat, sites[0], 1, gaps_only);
+            int ptn = site_pattern[sites[0]];
+            at(ptn).frequency += sites.size()-1;
+            for (auto it = sites.begin()+1; it != sites.end(); it++)
+                site_pattern[*it] = ptn;
+            num_gaps_only += gaps_only ? sites.size() : 0;
+            progress += step*sites.size();
+        } else {
+            if (!num_error)
+            {
+                bool gaps_only;
+                addPatternLazy(pat, site/step, 1, gaps_only);
+                num_gaps_only += gaps_only ? 1 : 0;
+            }
+            progress += step;
         }
-        progress += step;
     }
     progress.done();
     updatePatterns(0);
@@ -2103,6 +2182,55 @@ int Alignment::readPhylipSequential(char *filename, char *sequence_type) {
     return buildPattern(sequences, sequence_type, nseq, nsite);
 }
 
+/**
+    cut down FASTA sequence names at the first blank if they stay distinct,
+    otherwise keep more words joined by '_'
+    @param[in,out] seq_names sequence names
+*/
+static void shortenSeqNames(StrVector &seq_names) {
+    int i, step = 0;
+    StrVector new_seq_names, remain_seq_names;
+    new_seq_names.resize(seq_names.size());
+    remain_seq_names = seq_names;
+
+    double startShorten = getRealTime();
+    for (step = 0; step < 4; step++) {
+        bool duplicated = false;
+        unordered_set<string> namesSeenThisTime;
+        //Set of shorted names seen so far, this iteration
+        for (i = 0; i < seq_names.size(); i++) {
+            if (remain_seq_names[i].empty()) continue;
+            size_t pos = remain_seq_names[i].find_first_of(" \t");
+            if (pos == string::npos) {
+                new_seq_names[i] += remain_seq_names[i];
+                remain_seq_names[i] = "";
+            } else {
+                new_seq_names[i] += remain_seq_names[i].substr(0, pos);
+                remain_seq_names[i] = "_" + remain_seq_names[i].substr(pos+1);
+            }
+            if (!duplicated) {
+                //add the shortened name for sequence i to the
+                //set of shortened names seen so far, and set
+                //duplicated to true if it was already there.
+                duplicated = !namesSeenThisTime.insert(new_seq_names[i]).second;
+            }
+        }
+        if (!duplicated) break;
+    }
+    if (verbose_mode >= VB_MED) {
+        cout.precision(6);
+        cout << "Name shortening took " << (getRealTime() - startShorten) << " seconds." << endl;
+    }
+    if (step > 0) {
+        for (i = 0; i < seq_names.size(); i++)
+            if (seq_names[i] != new_seq_names[i]) {
+                cout << "NOTE: Change sequence name '" << seq_names[i] << "' -> " << new_seq_names[i] << endl;
+            }
+    }
+
+    seq_names = new_seq_names;
+}
+
 void Alignment::doReadFasta(char *filename, char *sequence_type, StrVector &sequences, int &nseq, int &nsite){
     ostringstream err_str;
     igzstream in;
@@ -2153,47 +2281,7 @@ void Alignment::doReadFasta(char *filename, char *sequence_type, StrVector &sequ
     in.close();
 
     // now try to cut down sequence name if possible
-    int i, step = 0;
-    StrVector new_seq_names, remain_seq_names;
-    new_seq_names.resize(seq_names.size());
-    remain_seq_names = seq_names;
-
-    double startShorten = getRealTime();
-    for (step = 0; step < 4; step++) {
-        bool duplicated = false;
-        unordered_set<string> namesSeenThisTime;
-        //Set of shorted names seen so far, this iteration
-        for (i = 0; i < seq_names.size(); i++) {
-            if (remain_seq_names[i].empty()) continue;
-            size_t pos = remain_seq_names[i].find_first_of(" \t");
-            if (pos == string::npos) {
-                new_seq_names[i] += remain_seq_names[i];
-                remain_seq_names[i] = "";
-            } else {
-                new_seq_names[i] += remain_seq_names[i].substr(0, pos);
-                remain_seq_names[i] = "_" + remain_seq_names[i].substr(pos+1);
-            }
-            if (!duplicated) {
-                //add the shortened name for sequence i to the
-                //set of shortened names seen so far, and set
-                //duplicated to true if it was already there.
-                duplicated = !namesSeenThisTime.insert(new_seq_names[i]).second;
-            }
-        }
-        if (!duplicated) break;
-    }
-    if (verbose_mode >= VB_MED) {
-        cout.precision(6);
-        cout << "Name shortening took " << (getRealTime() - startShorten) << " seconds." << endl;
-    }
-    if (step > 0) {
-        for (i = 0; i < seq_names.size(); i++)
-            if (seq_names[i] != new_seq_names[i]) {
-                cout << "NOTE: Change sequence name '" << seq_names[i] << "' -> " << new_seq_names[i] << endl;
-            }
-    }
-
-    seq_names = new_seq_names;
+    shortenSeqNames(seq_names);
     
     nseq = seq_names.size();
     nsite = sequences.front().length();
@@ -2211,6 +2299,308 @@ int Alignment::readFasta(char *filename, char *sequence_type) {
     return buildPattern(sequences, sequence_type, nseq, nsite);
 }
 
+/**
+    line-by-line access to an alignment file for readStreaming: uncompressed files are
+    memory-mapped, gzip-compressed files are read block-wise through igzstream
+*/
+class AlignmentLineReader {
+public:
+    AlignmentLineReader(const char *filename) {
+        this->filename = filename;
+        data = NULL;
+        length = 0;
+        pos = 0;
+#if !defined(WIN32) && !defined(_WIN32)
+        int fd = open(filename, O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            unsigned char magic[2];
+            if (fstat(fd, &st) == 0 && st.st_size > 2 && read(fd, magic, 2) == 2 &&
+                !(magic[0] == 0x1f && magic[1] == 0x8b)) {
+                void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED) {
+                    data = (const char*)addr;
+                    length = st.st_size;
+                    madvise(addr, length, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+        }
+#endif
+        if (!data)
+            openStream();
+    }
+
+    ~AlignmentLineReader() {
+#if !defined(WIN32) && !defined(_WIN32)
+        if (data)
+            munmap((void*)data, length);
+#endif
+        if (!data)
+            closeStream();
+    }
+
+    /**
+        read the next line without end-of-line characters
+        @return FALSE at the end of file
+    */
+    bool getLine(string &line) {
+        if (data) {
+            if (pos >= length)
+                return false;
+            const char *start = data + pos;
+            const char *end = (const char*)memchr(start, '\n', length - pos);
+            size_t len = end ? (end - start) : (length - pos);
+            line.assign(start, len);
+            pos += end ? len+1 : len;
+        } else {
+            if (in.eof())
+                return false;
+            safeGetline(in, line);
+        }
+        line = line.substr(0, line.find_first_of("\n\r"));
+        return true;
+    }
+
+    /** go back to the beginning of the file */
+    void rewind() {
+        if (data) {
+            pos = 0;
+        } else {
+            closeStream();
+            openStream();
+        }
+    }
+
+    /** @return file size for progress display */
+    double getLength() {
+        return data ? length : in.getCompressedLength();
+    }
+
+    /** @return current file position for progress display */
+    double getPosition() {
+        return data ? pos : in.getCompressedPosition();
+    }
+
+private:
+
+    void openStream() {
+        // set the failbit and badbit
+        in.exceptions(ios::failbit | ios::badbit);
+        in.open(filename);
+        // remove the failbit
+        in.exceptions(ios::badbit);
+    }
+
+    void closeStream() {
+        in.clear();
+        in.close();
+    }
+
+    const char *filename;
+
+    /** memory-mapped file, NULL if read through in */
+    const char *data;
+    size_t length;
+    size_t pos;
+
+    igzstream in;
+};
+
+/**
+    parse the sequences of a FASTA or PHYLIP file for readStreaming, mirroring
+    doReadFasta, doReadPhylip and doReadPhylipSequential
+    @param in line reader
+    @param intype IN_FASTA or IN_PHYLIP
+    @param sequential TRUE for sequential PHYLIP
+    @param[out] seq_names sequence names
+    @param[out] nseq, nsite number of sequences and sites
+    @param add_chars called with sequence ID, position and characters appended to that sequence,
+        for every site the sequences come in increasing order
+*/
+static void scanAlignmentFile(AlignmentLineReader &in, InputType intype, bool sequential,
+                              StrVector &seq_names, int &nseq, int &nsite,
+                              function<void(int, int, string&)> add_chars)
+{
+    IntVector seq_len;
+    string line, chars;
+    int seq_id = 0;
+    nseq = nsite = 0;
+    seq_names.clear();
+    progress_display progress(in.getLength(), "Scanning alignment file", "", "");
+    for (int line_num = 1; in.getLine(line); line_num++) {
+        if (line == "") continue;
+        if (intype == IN_FASTA) {
+            if (line[0] == '>') { // next sequence
+                seq_names.push_back(line.substr(1));
+                trimString(seq_names.back());
+                seq_len.push_back(0);
+                continue;
+            }
+            if (seq_len.empty())
+                throw "First line must begin with '>' to define sequence name";
+            seq_id = seq_len.size()-1;
+        } else if (nseq == 0) { // read number of sequences and sites
+            istringstream line_in(line);
+            if (!(line_in >> nseq >> nsite))
+                throw "Invalid PHYLIP format. First line must contain number of sequences and sites";
+            if (nseq < 3)
+                throw "There must be at least 3 sequences";
+            if (nsite < 1)
+                throw "No alignment columns";
+            seq_names.resize(nseq, "");
+            seq_len.resize(nseq, 0);
+            continue;
+        } else {
+            if (seq_id >= nseq)
+                throw "Line " + convertIntToString(line_num) + ": Too many sequences detected";
+            if (seq_names[seq_id] == "") { // cut out the sequence name
+                string::size_type pos = line.find_first_of(" \t");
+                if (pos == string::npos) pos = 10; //  assume standard phylip
+                seq_names[seq_id] = line.substr(0, pos);
+                line.erase(0, pos);
+            }
+        }
+        chars.clear();
+        processSeq(chars, line, line_num);
+        if (!chars.empty())
+            add_chars(seq_id, seq_len[seq_id], chars);
+        seq_len[seq_id] += chars.length();
+        if (intype == IN_PHYLIP && sequential) {
+            if (seq_len[seq_id] > nsite)
+                throw ("Line " + convertIntToString(line_num) + ": Sequence " + seq_names[seq_id] + " is too long (" + convertIntToString(seq_len[seq_id]) + ")");
+            if (seq_len[seq_id] == nsite)
+                seq_id++;
+        } else if (intype == IN_PHYLIP) {
+            if (seq_len[seq_id] != seq_len[0])
+                throw "Line " + convertIntToString(line_num) + ": Sequence " + seq_names[seq_id] + " has wrong sequence length " + convertIntToString(seq_len[seq_id]);
+            if (!chars.empty())
+                seq_id++;
+            if (seq_id == nseq)
+                seq_id = 0;
+        }
+        progress = in.getPosition();
+    }
+    progress.done();
+    if (intype == IN_FASTA) {
+        nseq = seq_names.size();
+        nsite = seq_len.empty() ? 0 : seq_len[0];
+    }
+    // same check as in buildPattern, all sites must be complete before columns are hashed
+    ostringstream err_str;
+    for (seq_id = 0; seq_id < nseq; seq_id++)
+        if (seq_len[seq_id] != nsite) {
+            err_str << "Sequence " << seq_names[seq_id] << " contains ";
+            if (seq_len[seq_id] < nsite)
+                err_str << "not enough";
+            else
+                err_str << "too many";
+            err_str << " characters (" << seq_len[seq_id] << ")\n";
+        }
+    if (err_str.str() != "")
+        throw err_str.str();
+}
+
+/** hash of a pair of 64-bit column hashes */
+struct ColumnHash {
+    size_t operator()(const pair<uint64_t, uint64_t> &h) const {
+        return h.first ^ (h.second * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+int Alignment::readStreaming(char *filename, char *sequence_type, InputType intype) {
+    // multi-state PHYLIP has numbers instead of characters
+    if (sequence_type && (strcmp(sequence_type,"TINA") == 0 || strcmp(sequence_type,"MULTI") == 0))
+        return 0;
+    bool sequential = Params::getInstance().phylip_sequential_format;
+    int step = (sequence_type && (strncmp(sequence_type, "CODON", 5) == 0 || strncmp(sequence_type, "NT2AA", 5) == 0)) ? 3 : 1;
+    int nseq = 0, nsite = 0;
+    AlignmentLineReader in(filename);
+
+    // pass 1: hash every column incrementally, sequence by sequence
+    vector<uint64_t> hash1, hash2;
+    size_t char_count[NUM_CHAR];
+    memset(char_count, 0, sizeof(char_count));
+    scanAlignmentFile(in, intype, sequential, seq_names, nseq, nsite,
+                      [&](int seq_id, int pos, string &chars) {
+        if (pos + chars.length() > hash1.size()) {
+            hash1.resize(pos + chars.length(), 0xcbf29ce484222325ULL);
+            hash2.resize(pos + chars.length(), 0);
+        }
+        uint64_t *h1 = &hash1[pos], *h2 = &hash2[pos];
+        for (auto c : chars) {
+            *h1 = (*h1 ^ (unsigned char)c) * 0x100000001b3ULL;
+            *h2 = ((*h2 << 7) | (*h2 >> 57)) + ((unsigned char)c + 1) * 0x9E3779B97F4A7C15ULL;
+            h1++; h2++;
+            char_count[(unsigned char)c]++;
+        }
+    });
+    if (nseq == 0 || nsite % step != 0) {
+        // let the usual reader report the error
+        seq_names.clear();
+        return 0;
+    }
+
+    // group identical columns (codons), distinct columns in order of first occurrence
+    int nunit = nsite / step;
+    vector<IntVector> column_sites;
+    IntVector unit_column(nunit);
+    {
+        unordered_map<pair<uint64_t, uint64_t>, int, ColumnHash> column_index;
+        for (int unit = 0; unit < nunit; unit++) {
+            pair<uint64_t, uint64_t> key(0, 0);
+            for (int i = unit*step; i < (unit+1)*step; i++) {
+                key.first = key.first * 0x100000001b3ULL ^ hash1[i];
+                key.second = key.second * 0x9E3779B97F4A7C15ULL ^ hash2[i];
+            }
+            auto it = column_index.find(key);
+            if (it == column_index.end()) {
+                unit_column[unit] = column_sites.size();
+                column_index[key] = column_sites.size();
+                column_sites.push_back(IntVector(1, unit));
+            } else {
+                unit_column[unit] = it->second;
+                column_sites[it->second].push_back(unit);
+            }
+        }
+    }
+    vector<uint64_t>().swap(hash1);
+    vector<uint64_t>().swap(hash2);
+    if (verbose_mode >= VB_MED)
+        cout << column_sites.size() << " distinct columns out of " << nunit << endl;
+
+    // pass 2: only store the distinct columns and verify all others against them
+    StrVector sequences(nseq, string(column_sites.size()*step, 0));
+    bool collision = false;
+    in.rewind();
+    scanAlignmentFile(in, intype, sequential, seq_names, nseq, nsite,
+                      [&](int seq_id, int pos, string &chars) {
+        string &seq = sequences[seq_id];
+        for (auto c : chars) {
+            int unit = pos / step;
+            int col = unit_column[unit];
+            char &dst = seq[col*step + pos%step];
+            // first occurrences precede the others within a sequence
+            if (column_sites[col][0] == unit)
+                dst = c;
+            else if (dst != c)
+                collision = true;
+            pos++;
+        }
+    });
+    if (collision) {
+        // hash collision: different columns were grouped together
+        if (verbose_mode >= VB_MED)
+            cout << "Column hash collision, reading alignment again" << endl;
+        seq_names.clear();
+        return 0;
+    }
+    if (intype == IN_FASTA)
+        shortenSeqNames(seq_names);
+
+    return buildPattern(sequences, sequence_type, nseq, nsite, &column_sites, char_count);
+}
+
 void Alignment::doReadClustal(char *filename, char *sequence_type, StrVector &sequences, int &nseq, int &nsite){
     igzstream in;
     int line_num = 1;
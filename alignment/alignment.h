@@ -71,17 +71,10 @@ public:
 std::ostream& operator<< (std::ostream& stream, const SymTestResult& res);
 
 #ifdef USE_HASH_MAP
-struct hashPattern {
-    size_t operator()(const vector<StateType> &sp) const {
-        size_t sum = 0;
-        for (Pattern::const_iterator it = sp.begin(); it != sp.end(); it++)
-            sum = (*it) + (sum << 6) + (sum << 16) - sum;
-        return sum;
-    }
-};
-typedef unordered_map<vector<StateType>, int, hashPattern> PatternIntMap;
+/** patterns are looked up by their packed form, see PackedPattern; the stored patterns are not packed */
+typedef unordered_map<PackedPattern, int, hashPackedPattern> PatternIntMap;
 #else
-typedef map<vector<StateType>, int> PatternIntMap;
+typedef map<PackedPattern, int> PatternIntMap;
 #endif
 
 
@@ -199,7 +192,20 @@ public:
      */
     int readNexus(char *filename);
 
-    int buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite);
+    /**
+            convert sequences into patterns
+            @param sequences sequences, of nsite characters unless column_sites is given
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param nseq number of sequences
+            @param nsite number of sites of the alignment
+            @param column_sites if not NULL, sequences only contain the distinct columns (codons),
+                column_sites[i] lists all sites (or codon positions) of the i-th distinct column
+            @param char_count if not NULL, number of occurrences of every character in the whole
+                alignment, used to detect the sequence type
+            @return 1 on success
+     */
+    int buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite,
+                     vector<IntVector> *column_sites = NULL, size_t *char_count = NULL);
     
     /**
             do-read the alignment in PHYLIP format (interleaved)
@@ -249,6 +255,17 @@ public:
      */
     int readFasta(char *filename, char *sequence_type);
 
+    /**
+            read the alignment in FASTA or PHYLIP format without keeping all sequences in memory:
+            a first pass over the (memory-mapped or gzip) file hashes all columns, a second pass
+            only stores the distinct columns, which are then converted into patterns
+            @param filename file name
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param intype IN_FASTA or IN_PHYLIP
+            @return 1 on success, 0 if the file has to be read the usual way
+     */
+    int readStreaming(char *filename, char *sequence_type, InputType intype);
+
     /** 
      * Read the alignment in counts format (PoMo).
      *
@@ -337,6 +354,12 @@ public:
      ****************************************************************************/
     SeqType detectSequenceType(StrVector &sequences);
 
+    /**
+            detect the sequence type from character counts
+            @param char_count number of occurrences of every character
+     */
+    SeqType detectSequenceType(size_t *char_count);
+
     void computeUnknownState();
 
     void buildStateMap(char *map, SeqType seq_type);
@@ -1032,6 +1055,9 @@ protected:
             hash map from pattern to index in the vector of patterns (the alignment)
      */
     PatternIntMap pattern_index;
+
+    /** key buffer of addPatternLazy, so that looking up a pattern does not allocate */
+    PackedPattern packed_key;
     
     /**
             alisim: caching ntfreq if it has already randomly initialized
@@ -19,6 +19,10 @@
  ***************************************************************************/
 #include "alignmentpairwise.h"
 #include "tree/phylosupertree.h"
+#include "model/modelmarkov.h"
+#include <Eigen/Core>
+
+using namespace Eigen;
 
 AlignmentPairwise::AlignmentPairwise()
         : Alignment(), Optimization()
@@ -37,6 +41,7 @@ AlignmentPairwise::AlignmentPairwise()
     sum_derv1          = nullptr;
     sum_derv2          = nullptr;
     sum_trans          = nullptr;
+    use_eigen_kernel   = false;
     pairCount = 0;
     derivativeCalculationCount = 0;
     costCalculationCount = 0;
@@ -73,6 +78,7 @@ void AlignmentPairwise::setTree(PhyloTree* atree) {
     trans_derv2   = new double[trans_size];
     total_size    = num_states_squared;
     pair_freq     = new double[total_size];
+    use_eigen_kernel = false;
     
     pairCount = 0;
     derivativeCalculationCount = 0;
@@ -87,6 +93,7 @@ void AlignmentPairwise::setSequenceNumbers(int seq1, int seq2) {
     ++pairCount;
     seq_id1 = seq1;
     seq_id2 = seq2;
+    use_eigen_kernel = false;
     auto rate = tree->getRate();
     bool isRateSiteSpecific = (rate==nullptr) ? false : rate->isSiteSpecificRate();
     auto model = tree->getModel();
@@ -122,6 +129,7 @@ void AlignmentPairwise::setSequenceNumbers(int seq1, int seq2) {
                 += tree->getSumOfFrequenciesForSitesWithConstantState(state);
         }
         //Todo: Handle the multiple category case here
+        prepareEigenKernel();
         return;
     } else if (tree->getRate()->getPtnCat(0) >= 0) {
         int i = 0;
@@ -137,6 +145,7 @@ void AlignmentPairwise::setSequenceNumbers(int seq1, int seq2) {
             int state2 = tree->aln->convertPomoState((*it)[seq_id2]);
             addPattern(state1, state2, it->frequency);
         }
+        prepareEigenKernel();
         return;
     }
 }
@@ -265,6 +274,10 @@ double AlignmentPairwise::computeFunction(double value) {
         return lh;
     }
 
+    if (use_eigen_kernel) {
+        return computeEigenFunction(value);
+    }
+
     if (tree->getModelFactory()->site_rate->getGammaShape() == 0.0)
         tree->getModelFactory()->computeTransMatrix(value, sum_trans_mat);
     else {
@@ -410,6 +423,11 @@ void AlignmentPairwise::computeFuncDerv(double value, double &df, double &ddf) {
         return;
     }
 
+    if (use_eigen_kernel) {
+        computeEigenFuncDerv(value, df, ddf);
+        return;
+    }
+
     memset(sum_trans, 0, sizeof(double) * trans_size);
     memset(sum_derv1, 0, sizeof(double) * trans_size);
     memset(sum_derv2, 0, sizeof(double) * trans_size);
@@ -450,6 +468,136 @@ void AlignmentPairwise::computeFuncDerv(double value, double &df, double &ddf) {
     return;
 }
 
+bool AlignmentPairwise::prepareEigenKernel() {
+    use_eigen_kernel = false;
+    if (!Params::getInstance().ml_dist_eigen) {
+        return false;
+    }
+    RateHeterogeneity *site_rate = tree->getRate();
+    ModelMarkov *model = dynamic_cast<ModelMarkov*>(tree->getModel());
+    if (model == nullptr || site_rate == nullptr || model->isMixture()
+        || !model->isReversible() || model->isSiteSpecificModel()
+        || site_rate->isSiteSpecificRate() || site_rate->getPtnCat(0) >= 0
+        || tree->aln->seq_type == SEQ_POMO) {
+        // PoMo computes P(t) by its own method; other cases keep the generic path
+        return false;
+    }
+    double *eval     = model->getEigenvalues();
+    double *evec     = model->getEigenvectors();
+    double *inv_evec = model->getInverseEigenvectors();
+    if (eval == nullptr || evec == nullptr || inv_evec == nullptr) {
+        return false;
+    }
+    eigen_index.clear();
+    eigen_freq.clear();
+    eigen_coeff.clear();
+    for (int i = 0; i < num_states; ++i) {
+        for (int j = 0; j < num_states; ++j) {
+            double freq = pair_freq[i*num_states + j];
+            if (freq <= 0.0) {
+                continue;
+            }
+            eigen_index.push_back(i*num_states + j);
+            eigen_freq.push_back(freq);
+            for (int k = 0; k < num_states; ++k) {
+                eigen_coeff.push_back(evec[i*num_states + k] * inv_evec[k*num_states + j]);
+            }
+        }
+    }
+    eigen_weight.resize(num_states * 3);
+    eigen_sum.resize(eigen_freq.size() * 3);
+    use_eigen_kernel = true;
+    return true;
+}
+
+double AlignmentPairwise::computeEigenFunction(double value) {
+    // Same quantity as the non-categorized case of computeFunction():
+    // P(t) (or the sum of P(t*r) over categories) for each nonzero entry,
+    // taken as a dot product of its coefficients with exp(eval*t).
+    ModelMarkov       *model     = dynamic_cast<ModelMarkov*>(tree->getModel());
+    RateHeterogeneity *site_rate = tree->getRate();
+    double *eval      = model->getEigenvalues();
+    double  evol_time = value / model->total_num_subst;
+    int     ncat      = site_rate->getNDiscreteRate();
+    int     nnz       = static_cast<int>(eigen_freq.size());
+    double *w         = eigen_weight.data();
+    if (site_rate->getGammaShape() == 0.0) {
+        for (int k = 0; k < num_states; ++k) {
+            w[k] = exp(eval[k] * evol_time);
+        }
+    } else {
+        memset(w, 0, sizeof(double) * num_states);
+        for (int cat = 0; cat < ncat; ++cat) {
+            double cat_time = evol_time * site_rate->getRate(cat);
+            for (int k = 0; k < num_states; ++k) {
+                w[k] += exp(eval[k] * cat_time);
+            }
+        }
+    }
+    Map<const Matrix<double, Dynamic, Dynamic, RowMajor> > coeff(eigen_coeff.data(), nnz, num_states);
+    Map<const VectorXd> weight(w, num_states);
+    Map<VectorXd> trans(eigen_sum.data(), nnz);
+    trans.noalias() = coeff * weight;
+    double lh = 0.0;
+    for (int e = 0; e < nnz; ++e) {
+        lh -= eigen_freq[e] * log(trans[e]);
+    }
+    return lh;
+}
+
+void AlignmentPairwise::computeEigenFuncDerv(double value, double &df, double &ddf) {
+    // Same quantities as the non-categorized case of computeFuncDerv().
+    // Mixing the categories happens on num_states eigenvalue weights
+    // (columns: P, dP/dt, d2P/dt2), so a single (nonzero entries x num_states)
+    // by (num_states x 3) product yields sum_trans, sum_derv1 and sum_derv2
+    // for every entry that has a nonzero pair frequency.
+    ModelMarkov       *model     = dynamic_cast<ModelMarkov*>(tree->getModel());
+    RateHeterogeneity *site_rate = tree->getRate();
+    double *eval      = model->getEigenvalues();
+    double  evol_time = value / model->total_num_subst;
+    int     ncat      = site_rate->getNDiscreteRate();
+    int     nnz       = static_cast<int>(eigen_freq.size());
+    bool    no_gamma  = (site_rate->getGammaShape() == 0.0);
+    double *w0        = eigen_weight.data();
+    double *w1        = w0 + num_states;
+    double *w2        = w1 + num_states;
+    memset(w0, 0, sizeof(double) * num_states * 3);
+    for (int cat = 0; cat < ncat; ++cat) {
+        double rate_val = no_gamma ? 1.0 : site_rate->getRate(cat);
+        double prop_val = site_rate->getProp(cat);
+        double coeff1   = rate_val * prop_val;
+        double coeff2   = rate_val * coeff1;
+        double cat_time = evol_time * rate_val;
+        for (int k = 0; k < num_states; ++k) {
+            double e = exp(eval[k] * cat_time);
+            w0[k] += e * prop_val;
+            w1[k] += e * eval[k] * coeff1;
+            w2[k] += e * eval[k] * eval[k] * coeff2;
+        }
+    }
+    Map<const Matrix<double, Dynamic, Dynamic, RowMajor> > coeff(eigen_coeff.data(), nnz, num_states);
+    Map<const Matrix<double, Dynamic, 3> > weight(w0, num_states, 3);
+    Map<Matrix<double, Dynamic, 3> > sum(eigen_sum.data(), nnz, 3);
+    sum.noalias() = coeff * weight;
+
+    // 2019-07-03: incorporate p_invar
+    double p_invar = site_rate->getPInvar();
+    df  = 0.0;
+    ddf = 0.0;
+    for (int e = 0; e < nnz; ++e) {
+        double trans = sum(e, 0);
+        if (p_invar > 0.0 && eigen_index[e] % (num_states + 1) == 0) {
+            trans += p_invar;
+        }
+        if (trans <= 0.0) {
+            continue;
+        }
+        double d1 = sum(e, 1) / trans;
+        df  -= eigen_freq[e] * d1;
+        ddf -= eigen_freq[e] * (sum(e, 2) / trans - d1 * d1);
+    }
+}
+
 double AlignmentPairwise::optimizeDist(double initial_dist, double &d2l) {
     // initial guess of the distance using Juke-Cantor correction
     double dist = initial_dist;
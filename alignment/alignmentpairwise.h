@@ -106,6 +106,29 @@ public:
     */
 
     virtual double recomputeDist( int seq1, int seq2, double initial_dist, double &d2l );
+
+    /**
+        set up the eigenspace kernel for the current pair (--ml-dist-eigen):
+        collect the nonzero entries of pair_freq and, for each of them,
+        the coefficients U[i][k]*V[k][j] of the eigendecomposition Q = U diag(eval) V
+        @return TRUE if the kernel applies to the current model and rate
+     */
+    bool prepareEigenKernel();
+
+    /**
+        eigenspace version of computeFunction() for the current pair
+        @param value x-value of the function
+        @return negative log-likelihood
+     */
+    double computeEigenFunction(double value);
+
+    /**
+        eigenspace version of computeFuncDerv() for the current pair
+        @param value x-value of the function
+        @param df (OUT) first derivative
+        @param ddf (OUT) second derivative
+     */
+    void computeEigenFuncDerv(double value, double &df, double &ddf);
     
 	/**
 		destructor
@@ -135,6 +158,14 @@ protected:
 
     int        seq_id1;
     int        seq_id2;
+
+    bool           use_eigen_kernel; //TRUE if prepareEigenKernel() succeeded for this pair
+    vector<int>    eigen_index;      //positions in pair_freq of its nonzero entries
+    vector<double> eigen_freq;       //the corresponding frequencies
+    vector<double> eigen_coeff;      //(nonzero entries) x num_states matrix, row-major,
+                                     //of U[i][k]*V[k][j] for each entry (i,j)
+    vector<double> eigen_weight;     //num_states x 3 (column-major) per-eigenvalue weights
+    vector<double> eigen_sum;        //(nonzero entries) x 3 (column-major) contraction result
 protected:
     void setTree(PhyloTree* atree);
     
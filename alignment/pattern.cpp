@@ -50,6 +50,48 @@ Pattern::~Pattern()
 {
 }
 
+/**
+    @return 4-bit nucleotide code of a state: bit mask of A,C,G,T for ambiguity codes (num_states-1 + mask)
+    and single bits for A,C,G,T, or -1 if the state has no such code
+*/
+static inline int nucleotideCode(StateType state) {
+    if (state < 4)
+        return 1 << state;
+    if (state > 18)
+        return -1;
+    int mask = state - 3;
+    // single nucleotides are not ambiguity codes
+    return (mask & (mask-1)) ? mask : -1;
+}
+
+void PackedPattern::pack(const vector<StateType> &pat)
+{
+    size_t nstates = pat.size();
+    int bits = 4;
+    StateType max_state = 0;
+    for (auto it = pat.begin(); it != pat.end(); it++) {
+        if (bits == 4 && nucleotideCode(*it) < 0)
+            bits = 0;
+        max_state = max(max_state, *it);
+    }
+    if (bits == 0)
+        bits = (max_state < (1 << 8)) ? 8 : ((max_state < (1 << 16)) ? 16 : 32);
+    size_t per_word = 64 / bits;
+    assign(1 + (nstates + per_word - 1) / per_word, 0);
+    (*this)[0] = ((uint64_t)nstates << 8) | bits;
+    uint64_t *word = data() + 1;
+    size_t shift = 0;
+    for (auto it = pat.begin(); it != pat.end(); it++) {
+        uint64_t code = (bits == 4) ? nucleotideCode(*it) : (*it);
+        *word |= code << shift;
+        shift += bits;
+        if (shift == 64) {
+            word++;
+            shift = 0;
+        }
+    }
+}
+
 int Pattern::computeAmbiguousChar(int num_states) {
     int num = 0;
     for (iterator i = begin(); i != end(); i++)
@@ -95,4 +95,42 @@ public:
     int num_chars;
 };
 
+/**
+	Pattern packed into 64-bit words, only used as key of Alignment::pattern_index.
+	A pattern of nucleotides, including ambiguity codes and gaps, takes 4 bits per state,
+	other patterns 8, 16 or 32 bits per state depending on their largest state.
+	The first word stores the number of states and the number of bits per state,
+	so that the packing is one-to-one.
+	The patterns stored in Alignment remain unpacked (one StateType per state).
+*/
+class PackedPattern : public vector<uint64_t>
+{
+public:
+    PackedPattern() : vector<uint64_t>() {}
+
+    /**
+		pack a pattern, implicit to look up patterns directly
+		@param pat pattern
+	*/
+    PackedPattern(const vector<StateType> &pat) : vector<uint64_t>() {
+        pack(pat);
+    }
+
+    /**
+		pack a pattern into this key, reusing its memory
+		@param pat pattern
+	*/
+    void pack(const vector<StateType> &pat);
+};
+
+/** hash of a packed pattern */
+struct hashPackedPattern {
+    size_t operator()(const PackedPattern &pat) const {
+        uint64_t sum = 0;
+        for (auto it = pat.begin(); it != pat.end(); it++)
+            sum = (sum ^ (*it)) * 0x9E3779B97F4A7C15ULL + (sum >> 29);
+        return (size_t)sum;
+    }
+};
+
 #endif
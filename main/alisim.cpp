@@ -718,10 +718,6 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
     if (super_alisimulator->params->root_ref_seq_name.length() > 0)
         retrieveAncestralSequenceFromInputFile(super_alisimulator, ancestral_sequence);
     
-    // terminate if users employ more MPI processes than the number of alignments
-    if (MPIHelper::getInstance().getNumProcesses() > super_alisimulator->params->alisim_dataset_num)
-        outError("You are employing more MPI processes (" + convertIntToString(MPIHelper::getInstance().getNumProcesses()) + ") than the number of alignments (" + convertIntToString(super_alisimulator->params->alisim_dataset_num) + "). Please reduce the number of MPI processes to save the computational resources and try again!");
-    
     // BUG FIXED: set auto num_threads to the max #cores
 #ifdef _OPENMP
     // num_threads == 0 <=> auto
@@ -832,6 +828,18 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
         }
     }
     
+    // split the sites of each alignment across MPI processes if the user wants to do so
+    int64_t segment_start = 0, segment_length = 0, total_length = 0;
+    bool mpi_segments = initMPISiteSegment(super_alisimulator, ancestral_sequence, segment_start, segment_length, total_length);
+    
+    // terminate if users employ more MPI processes than the number of alignments
+    if (!mpi_segments && MPIHelper::getInstance().getNumProcesses() > super_alisimulator->params->alisim_dataset_num)
+        outError("You are employing more MPI processes (" + convertIntToString(MPIHelper::getInstance().getNumProcesses()) + ") than the number of alignments (" + convertIntToString(super_alisimulator->params->alisim_dataset_num) + "). Please reduce the number of MPI processes to save the computational resources and try again!");
+    
+    // compute the transition matrices of each branch once for all alignments
+    if (super_alisimulator->params->alisim_batch_replicates && super_alisimulator->params->alisim_dataset_num > 1 && !super_alisimulator->tree->isSuperTree())
+        super_alisimulator->trans_matrix_cache = new TransMatrixCache();
+    
     // the output format of the simulated alignment
     InputType actual_output_format = super_alisimulator->params->aln_output_format;
     vector<SeqType> seqtypes;
@@ -846,10 +854,10 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
     // iteratively generate multiple datasets for each tree
     for (int i = 0; i < super_alisimulator->params->alisim_dataset_num; i++)
     {
-        // parallelize over MPI ranks statically
+        // parallelize over MPI ranks statically (every rank works on every alignment if sites are split across ranks)
         int proc_ID = MPIHelper::getInstance().getProcessID();
         int nprocs  = MPIHelper::getInstance().getNumProcesses();
-        if (i%nprocs != proc_ID) continue;
+        if (!mpi_segments && i%nprocs != proc_ID) continue;
         
         // If users want to output Maple format -> clear seqtypes and aln_names
         if (actual_output_format == IN_MAPLE)
@@ -960,8 +968,15 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
                 aln_names.push_back(output_filepath);
             }
             
+            // each MPI rank writes its site segment into a temporary file, then all segments are written into the output file
+            if (mpi_segments)
+            {
+                string segment_filepath = output_filepath + "_segment_" + convertIntToString(proc_ID + 1);
+                generatePartitionAlignmentFromSingleSimulator(super_alisimulator, ancestral_sequence, input_msa, site_locked_vec, segment_filepath, open_mode);
+                writeMPISiteSegment(super_alisimulator, segment_filepath, output_filepath, segment_start, segment_length, total_length);
+            }
             // check whether we could write the output to file immediately after simulating it
-            if (super_alisimulator->tree->getModelFactory() && super_alisimulator->tree->getModelFactory()->getASC() == ASC_NONE && super_alisimulator->params->alisim_insertion_ratio + super_alisimulator->params->alisim_deletion_ratio == 0)
+            else if (super_alisimulator->tree->getModelFactory() && super_alisimulator->tree->getModelFactory()->getASC() == ASC_NONE && super_alisimulator->params->alisim_insertion_ratio + super_alisimulator->params->alisim_deletion_ratio == 0)
                 generatePartitionAlignmentFromSingleSimulator(super_alisimulator, ancestral_sequence, input_msa, site_locked_vec, output_filepath, open_mode);
             // otherwise, writing output to file after completing the simulation
             else
@@ -1039,6 +1054,205 @@ void generateMultipleAlignmentsFromSingleTree(AliSimulator *super_alisimulator,
     // delete site_locked_vec (if necessary)
     if (site_locked_vec)
         delete site_locked_vec;
+    
+    // delete the shared transition matrices
+    if (super_alisimulator->trans_matrix_cache)
+    {
+        delete super_alisimulator->trans_matrix_cache;
+        super_alisimulator->trans_matrix_cache = NULL;
+    }
+}
+
+/**
+    check whether any branch of the tree has its own model
+*/
+bool hasBranchSpecificModels(Node *node, Node *dad)
+{
+    NeighborVec::iterator it;
+    FOR_NEIGHBOR(node, dad, it) {
+        if ((*it)->attributes.find("model") != (*it)->attributes.end()
+            || hasBranchSpecificModels((*it)->node, node))
+            return true;
+    }
+    return false;
+}
+
+/**
+    split the sites of each alignment across MPI processes
+*/
+bool initMPISiteSegment(AliSimulator *super_alisimulator, vector<short int> &ancestral_sequence, int64_t &segment_start, int64_t &segment_length, int64_t &total_length)
+{
+    Params *params = super_alisimulator->params;
+    if (!params->alisim_mpi_segments)
+        return false;
+    
+#ifndef _IQTREE_MPI
+    outWarning("Ignore --mpi-segments option since it is only supported in IQ-TREE version with MPI.");
+    params->alisim_mpi_segments = false;
+    return false;
+#else
+    int proc_ID = MPIHelper::getInstance().getProcessID();
+    int nprocs  = MPIHelper::getInstance().getNumProcesses();
+    if (nprocs == 1)
+    {
+        params->alisim_mpi_segments = false;
+        return false;
+    }
+    
+    // sites could be simulated separately only if they evolve independently
+    if (params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0
+        || super_alisimulator->tree->isSuperTree()
+        || (super_alisimulator->tree->getModelFactory() && super_alisimulator->tree->getModelFactory()->getASC() != ASC_NONE)
+        || params->alisim_fundi_taxon_set.size() > 0
+        || params->include_pre_mutations
+        || params->alisim_inference_mode
+        || hasBranchSpecificModels(super_alisimulator->tree->root, NULL))
+    {
+        outWarning("Ignore --mpi-segments option since it is not supported in simulations with Indels, Partitions, +ASC, FunDi models, branch-specific models, predefined mutations, or when mimicking an input alignment. AliSim will distribute alignments across MPI processes.");
+        params->alisim_mpi_segments = false;
+        return false;
+    }
+    if (params->do_compression || params->aln_output_format == IN_MAPLE || params->no_merge)
+    {
+        outWarning("Ignore --mpi-segments option since it is not supported with compression, Maple format, or --no-merge option. AliSim will distribute alignments across MPI processes.");
+        params->alisim_mpi_segments = false;
+        return false;
+    }
+    
+    // Lie-Markov models randomly draw their state frequencies when being initialized -> all processes use those of the master
+    ModelSubst *model = super_alisimulator->tree->getModel();
+    if (ModelLieMarkov::validModelName(model->getName()))
+    {
+        double *state_freqs = new double[super_alisimulator->max_num_states];
+        model->getStateFrequency(state_freqs);
+        super_alisimulator->broadcastStateFreqs(state_freqs);
+        model->setStateFrequency(state_freqs);
+        model->decomposeRateMatrix();
+        delete[] state_freqs;
+    }
+    
+    // split the sequence into segments of whole states (e.g., codons)
+    int num_sites_per_state = super_alisimulator->num_sites_per_state;
+    int64_t total_num_states = params->alisim_sequence_length / num_sites_per_state;
+    int64_t default_num_states = total_num_states / nprocs;
+    if (default_num_states == 0)
+        outError("You are employing more MPI processes (" + convertIntToString(nprocs) + ") than the number of sites (" + convertInt64ToString(total_num_states) + "). Please reduce the number of MPI processes and try again!");
+    int64_t start_state = proc_ID * default_num_states;
+    int64_t num_states = proc_ID < nprocs - 1 ? default_num_states : total_num_states - (nprocs - 1) * default_num_states;
+    
+    // lengths of the output sequences (in characters)
+    segment_start = start_state * num_sites_per_state;
+    segment_length = num_states * num_sites_per_state;
+    total_length = total_num_states * num_sites_per_state;
+    
+    // only simulate the current segment
+    params->alisim_sequence_length = segment_length;
+    super_alisimulator->refreshExpectedNumSites();
+    
+    // extract the current segment of the ancestral sequence
+    if (ancestral_sequence.size() > 0)
+    {
+        ASSERT(ancestral_sequence.size() >= start_state + num_states);
+        vector<short int> segment_sequence(ancestral_sequence.begin() + start_state, ancestral_sequence.begin() + start_state + num_states);
+        ancestral_sequence.swap(segment_sequence);
+    }
+    
+    // all segment files must list the sequences in the same order
+    if (params->num_threads != 1)
+        params->keep_seq_order = true;
+    
+    if (MPIHelper::getInstance().isMaster())
+        cout << "Splitting " << total_length << " sites of each alignment across " << nprocs << " MPI processes" << endl;
+    
+    return true;
+#endif
+}
+
+/**
+    write the site segment of the current MPI process into the output file
+*/
+void writeMPISiteSegment(AliSimulator *alisimulator, string segment_filepath, string output_filepath, int64_t segment_start, int64_t segment_length, int64_t total_length)
+{
+#ifdef _IQTREE_MPI
+    InputType output_format = alisimulator->params->aln_output_format;
+    string segment_filename = getOutputNameWithExt(output_format, segment_filepath);
+    string output_filename = getOutputNameWithExt(output_format, output_filepath);
+    bool is_first = MPIHelper::getInstance().isMaster();
+    bool is_last = MPIHelper::getInstance().getProcessID() == MPIHelper::getInstance().getNumProcesses() - 1;
+    
+    ifstream in(segment_filename.c_str(), std::ifstream::binary);
+    if (!in.is_open())
+        outError(ERR_READ_INPUT, segment_filename);
+    
+    // all processes open the output file, and drop any content left from a previous run
+    MPI_File out;
+    if (MPI_File_open(MPI_COMM_WORLD, output_filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &out) != MPI_SUCCESS)
+        outError(ERR_WRITE_OUTPUT, output_filename);
+    MPI_File_set_size(out, 0);
+    // make sure the truncation completes everywhere before any process writes its segment
+    MPI_File_sync(out);
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    string line, prefix, output;
+    MPI_Offset pos = 0;
+    
+    // PHYLIP: rewrite the first line with the total length
+    if (output_format == IN_PHYLIP)
+    {
+        safeGetline(in, line);
+        string first_line = line.substr(0, line.find(' ')) + " " + convertInt64ToString(total_length) + "\n";
+        if (is_first)
+            MPI_File_write_at(out, pos, first_line.c_str(), first_line.length(), MPI_CHAR, MPI_STATUS_IGNORE);
+        pos += first_line.length();
+    }
+    
+    // all processes read the same sequence names in the same order -> they compute the same offset for each sequence
+    while (safeGetline(in, line))
+    {
+        if (line.length() == 0)
+            continue;
+        
+        size_t seq_start;
+        // FASTA: the sequence follows the name line
+        if (output_format == IN_FASTA)
+        {
+            prefix = line + "\n";
+            safeGetline(in, line);
+            seq_start = 0;
+        }
+        // PHYLIP: the sequence follows the padded name
+        else
+        {
+            seq_start = line.find_last_of(' ') + 1;
+            prefix = line.substr(0, seq_start);
+        }
+        
+        if (line.length() - seq_start != segment_length)
+            outError("Unexpected sequence length in " + segment_filename);
+        
+        // the first process also writes the sequence name, the last one writes the line break
+        MPI_Offset write_pos = pos + prefix.length() + segment_start;
+        output.clear();
+        if (is_first)
+        {
+            output = prefix;
+            write_pos = pos;
+        }
+        output.append(line, seq_start, string::npos);
+        if (is_last)
+            output += "\n";
+        MPI_File_write_at(out, write_pos, output.c_str(), output.length(), MPI_CHAR, MPI_STATUS_IGNORE);
+        
+        pos += prefix.length() + total_length + 1;
+    }
+    
+    MPI_File_close(&out);
+    in.close();
+    remove(segment_filename.c_str());
+    
+    if (is_first)
+        cout << "An alignment has just been exported to " << output_filename << endl;
+#endif
 }
 
 /**
@@ -99,6 +99,21 @@ void writeSequencesToFile(string file_path, Alignment *aln, int sequence_length,
 */
 void writeASequenceToFile(Alignment *aln, int sequence_length, int num_threads, bool keep_seq_order, uint64_t start_pos, uint64_t output_line_length,ostream &out, ostream &out_indels, bool write_indels_output, vector<string> &state_mapping, InputType output_format, int max_length_taxa_name, bool write_sequences_from_tmp_data, Node *node, Node *dad);
 
+/**
+*  check whether any branch of the tree has its own model
+*/
+bool hasBranchSpecificModels(Node *node, Node *dad);
+
+/**
+*  split the sites of each alignment across MPI processes, return FALSE if it is not applicable
+*/
+bool initMPISiteSegment(AliSimulator *super_alisimulator, vector<short int> &ancestral_sequence, int64_t &segment_start, int64_t &segment_length, int64_t &total_length);
+
+/**
+*  write the site segment of the current MPI process into the output file at its offset
+*/
+void writeMPISiteSegment(AliSimulator *alisimulator, string segment_filepath, string output_filepath, int64_t segment_start, int64_t segment_length, int64_t total_length);
+
 /**
 *  merge and write all sequences to output files
 */
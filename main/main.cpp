@@ -1864,6 +1864,9 @@ void funcExit(void) {
         while (getchar() != '\n');
     }
     
+    // checkpoint dumps queued for the background writer
+    CheckpointWriter::flushAll();
+    ThreadPool::shutdown();
     endLogFile();
     MPIHelper::getInstance().finalize();
 }
@@ -2273,6 +2276,10 @@ int main(int argc, char *argv[]) {
     // 2015-12-05
     Checkpoint *checkpoint = new Checkpoint;
     string filename = (string)Params::getInstance().out_prefix +".ckp.gz";
+    if (Params::getInstance().checkpoint_binary) {
+        filename = (string)Params::getInstance().out_prefix +".ckp.bin";
+        checkpoint->setBinary(true);
+    }
     checkpoint->setFileName(filename);
     
     bool append_log = false;
@@ -2308,6 +2315,8 @@ int main(int argc, char *argv[]) {
 
     if (MPIHelper::getInstance().isWorker())
         checkpoint->setFileName("");
+    else if (Params::getInstance().checkpoint_async)
+        checkpoint->setAsync(true);
 
     _log_file = Params::getInstance().out_prefix;
     _log_file += ".log";
@@ -2409,6 +2418,10 @@ int main(int argc, char *argv[]) {
         cout << "Safe ";
     }
 
+    if (Params::getInstance().lk_float) {
+        cout << "Float ";
+    }
+
     if (Params::getInstance().pll) {
 #ifdef __AVX__
         cout << "PLL-AVX";
@@ -1569,15 +1569,122 @@ void fixPartitions(PhyloSuperTree* super_tree) {
     super_tree->deleteAllPartialLh();
 }
 
+SharedModelTree::~SharedModelTree() {
+    delete tree;
+}
+
+bool SharedModelTree::isSupported(Params &params, CandidateModel *model) {
+    return params.modelfinder_shared_tree && !params.model_test_and_tree &&
+        !model->aln->isSuperAlignment() && posRateHeterotachy(model->getName()) == string::npos;
+}
+
+IQTree *SharedModelTree::getTree(Params &params, Alignment *in_aln, int num_threads, Checkpoint *ckp) {
+    if (tree && aln != in_aln) {
+        // modelomatic: codon, AA and DNA candidates have different alignments
+        delete tree;
+        tree = NULL;
+    }
+    if (!tree) {
+        tree = new IQTree(in_aln);
+        tree->setParams(&params);
+        tree->setLikelihoodKernel(params.SSE);
+        tree->optimize_by_newton = params.optimize_by_newton;
+        aln = in_aln;
+        alloc_ncat = 0;
+    }
+    tree->setNumThreads(num_threads);
+
+    // the model of the previous candidate is not needed anymore
+    if (tree->getModelFactory()) {
+        delete tree->getModelFactory();
+        delete tree->getModel();
+        delete tree->getRate();
+        tree->setModelFactory(NULL);
+    }
+
+    // always read the tree again: the previous candidate changed its branch lengths
+    tree->setCheckpoint(ckp);
+    string ckp_newick;
+    bool found;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    {
+    tree->startCheckpoint();
+    found = ckp->getString("newick", ckp_newick);
+    tree->endCheckpoint();
+    }
+    if (found)
+        tree->PhyloTree::readTreeString(ckp_newick);
+    return tree;
+}
+
+void SharedModelTree::initializePartialLh() {
+    ModelFactory *model_factory = tree->getModelFactory();
+    ModelSubst *model = tree->getModel();
+    RateHeterogeneity *site_rate = tree->getRate();
+    size_t nmix = model_factory->fused_mix_rate ? 1 : model->getNMixtures();
+    size_t ncat = max(site_rate->getNRate(), site_rate->getNDiscreteRate()) * nmix;
+    size_t nptn = get_safe_upper_limit(aln->getNPattern()) + max(get_safe_upper_limit(aln->num_states),
+        get_safe_upper_limit(model_factory->unobserved_ptns.size()));
+    // tip partial likelihoods are stored after the internal ones and depend on the mixture
+    if (ncat > alloc_ncat || nptn != alloc_nptn || model->getNMixtures() != alloc_nmix ||
+        model->isSiteSpecificModel() || alloc_site_specific) {
+        if (alloc_ncat > 0 && verbose_mode >= VB_MED)
+            cout << "Reallocating partial likelihoods for " << ncat << " categories" << endl;
+        tree->deleteAllPartialLh();
+        tree->getMemoryRequired();
+        alloc_ncat = ncat;
+        alloc_nptn = nptn;
+        alloc_nmix = model->getNMixtures();
+        alloc_site_specific = model->isSiteSpecificModel();
+    }
+    // buffers are kept, only pointers are assigned for the current model
+    tree->initializeAllPartialLh();
+}
+
+bool CandidateModel::initFromNestedRate(RateHeterogeneity *rate, CandidateModelSet *models) {
+    if (rate_name.find("+R") != string::npos || rate_name.find('*') != string::npos)
+        return false;
+    size_t posG = rate_name.find("+G");
+    bool has_invar = rate_name.find("+I") != string::npos && !rate->isFixPInvar();
+    bool has_gamma = posG != string::npos && !rate->isFixGammaShape();
+    string gamma_name = has_gamma ? rate_name.substr(posG) : "";
+    bool gamma_done = false, invar_done = false;
+    for (auto it = models->begin(); it != models->end() && ((has_gamma && !gamma_done) || (has_invar && !invar_done)); it++) {
+        if (&(*it) == this || !it->hasFlag(MF_DONE) || it->aln != aln || it->subst_name != subst_name)
+            continue;
+        if (it->rate_name.find("+R") != string::npos || it->rate_name.find('*') != string::npos)
+            continue;
+        size_t it_posG = it->rate_name.find("+G");
+        if (has_gamma && !gamma_done && it->gamma_shape > 0.0 && it_posG != string::npos &&
+            it->rate_name.substr(it_posG) == gamma_name) {
+            rate->setGammaShape(it->gamma_shape);
+            gamma_done = true;
+            if (verbose_mode >= VB_MED)
+                cout << getName() << " Gamma shape initialized from " << it->getName() << endl;
+        }
+        if (has_invar && !invar_done && it->p_invar > 0.0 && it->rate_name.find("+I") != string::npos) {
+            rate->setPInvar(it->p_invar);
+            invar_done = true;
+            if (verbose_mode >= VB_MED)
+                cout << getName() << " p-invar initialized from " << it->getName() << endl;
+        }
+    }
+    return gamma_done || invar_done;
+}
+
 string CandidateModel::evaluate(Params &params,
     ModelCheckpoint &in_model_info, ModelCheckpoint &out_model_info,
     ModelsBlock *models_block,
-    int &num_threads, int brlen_type)
+    int &num_threads, int brlen_type, SharedModelTree *shared_tree)
 {
     //string model_name = name;
     Alignment *in_aln = aln;
     IQTree *iqtree = NULL;
-    if (in_aln->isSuperAlignment()) {
+    if (shared_tree) {
+        iqtree = shared_tree->getTree(params, in_aln, num_threads, &in_model_info);
+    } else if (in_aln->isSuperAlignment()) {
         SuperAlignment *saln = (SuperAlignment*)in_aln;
         if (params.partition_type == BRLEN_OPTIMIZE)
             iqtree = new PhyloSuperTree(saln);
@@ -1594,16 +1701,18 @@ string CandidateModel::evaluate(Params &params,
         iqtree = new PhyloTreeMixlen(in_aln, 0);
     else
         iqtree = new IQTree(in_aln);
-    iqtree->setParams(&params);
-    iqtree->setLikelihoodKernel(params.SSE);
-    iqtree->optimize_by_newton = params.optimize_by_newton;
-    iqtree->setNumThreads(num_threads);
+    if (!shared_tree) {
+        iqtree->setParams(&params);
+        iqtree->setLikelihoodKernel(params.SSE);
+        iqtree->optimize_by_newton = params.optimize_by_newton;
+        iqtree->setNumThreads(num_threads);
 
-    iqtree->setCheckpoint(&in_model_info);
+        iqtree->setCheckpoint(&in_model_info);
 #ifdef _OPENMP
 #pragma omp critical
 #endif
-    iqtree->restoreCheckpoint();
+        iqtree->restoreCheckpoint();
+    }
     ASSERT(iqtree->root);
     iqtree->initializeModel(params, getName(), models_block);
     if (!iqtree->getModel()->isMixture() || in_aln->seq_type == SEQ_POMO) {
@@ -1613,7 +1722,8 @@ string CandidateModel::evaluate(Params &params,
 
 
     if (restoreCheckpoint(&in_model_info)) {
-        delete iqtree;
+        if (!shared_tree)
+            delete iqtree;
         return "";
     }
 
@@ -1677,7 +1787,10 @@ string CandidateModel::evaluate(Params &params,
             cout << "Optimizing model " << getName() << endl;
 
         iqtree->ensureNumberOfThreadsIsSet(nullptr);
-        iqtree->initializeAllPartialLh();
+        if (shared_tree)
+            shared_tree->initializePartialLh();
+        else
+            iqtree->initializeAllPartialLh();
         
         // try to initialise +R[k+1] from +R[k] if not restored from checkpoint
         CandidateModel prev_info;
@@ -1688,6 +1801,10 @@ string CandidateModel::evaluate(Params &params,
             iqtree->getRate()->initFromCatMinusOne(in_model_info, weight_rescale);
             if (verbose_mode >= VB_MED)
                 cout << iqtree->getRate()->name << " initialized from " << prev_info.rate_name << endl;
+        } else if (!rate_restored && shared_tree && shared_tree->warm_start) {
+            // warm start from e.g. +I+G4 for +G4
+            if (initFromNestedRate(iqtree->getRate(), shared_tree->models))
+                iqtree->clearAllPartialLH();
         }
 
         for (int step = 0; step < 5; step++) {
@@ -1714,6 +1831,8 @@ string CandidateModel::evaluate(Params &params,
     // sum in case of adjusted df and logl already stored
     df += iqtree->getModelFactory()->getNParameters(brlen_type);
     logl += new_logl;
+    gamma_shape = iqtree->getRate()->getGammaShape();
+    p_invar = iqtree->getRate()->getPInvar();
     string tree_string = iqtree->getTreeString();
 
 #ifdef _OPENMP
@@ -1725,7 +1844,8 @@ string CandidateModel::evaluate(Params &params,
     }
 #endif
 
-    delete iqtree;
+    if (!shared_tree)
+        delete iqtree;
     return tree_string;
 }
 
@@ -3046,6 +3166,12 @@ CandidateModel CandidateModelSet::evaluateAll(Params &params, PhyloTree* in_tree
 #pragma omp parallel num_threads(num_threads)
 #endif
     {
+    // one tree per thread for all candidates on the fixed topology
+    SharedModelTree shared_tree(this);
+#ifdef _OPENMP
+    // other threads' candidates finish in a schedule-dependent order -> only warm start if evaluated one by one
+    shared_tree.warm_start = (omp_get_num_threads() == 1);
+#endif
     int64_t model;
     do {
         model = getNextModel();
@@ -3061,7 +3187,8 @@ CandidateModel CandidateModelSet::evaluateAll(Params &params, PhyloTree* in_tree
         
         // main call to estimate model parameters
         tree_string = at(model).evaluate(params, model_info, out_model_info,
-                                         models_block, num_threads, brlen_type);
+                                         models_block, num_threads, brlen_type,
+                                         SharedModelTree::isSupported(params, &at(model)) ? &shared_tree : NULL);
         at(model).computeICScores();
         at(model).setFlag(MF_DONE);
         
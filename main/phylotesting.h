@@ -17,6 +17,9 @@
 class PhyloTree;
 class IQTree;
 class ModelCheckpoint;
+class CandidateModelSet;
+class SharedModelTree;
+class RateHeterogeneity;
 
 const int MF_SAMPLE_SIZE_TRIPLE = 1;
 const int MF_IGNORED            = 2;
@@ -36,6 +39,8 @@ public:
         logl = 0.0;
         df = 0;
         tree_len = 0.0;
+        gamma_shape = 0.0;
+        p_invar = 0.0;
         aln = NULL;
         AIC_score = DBL_MAX;
         AICc_score = DBL_MAX;
@@ -74,11 +79,22 @@ public:
      @param models_block models block
      @param num_thread number of threads
      @param brlen_type BRLEN_OPTIMIZE | BRLEN_FIX | BRLEN_SCALE | TOPO_UNLINKED
+     @param shared_tree per-thread tree to reuse instead of creating a new one (NULL if none)
      @return tree string
      */
     string evaluate(Params &params,
                     ModelCheckpoint &in_model_info, ModelCheckpoint &out_model_info,
-                    ModelsBlock *models_block, int &num_threads, int brlen_type);
+                    ModelsBlock *models_block, int &num_threads, int brlen_type,
+                    SharedModelTree *shared_tree = NULL);
+
+    /**
+     initialize Gamma shape and proportion of invariable sites from a finished candidate
+     with the same substitution model that nests or is nested in this one (e.g. +G4 and +I+G4)
+     @param rate rate heterogeneity of this model
+     @param models all candidate models
+     @return TRUE if some parameter was initialized
+     */
+    bool initFromNestedRate(RateHeterogeneity *rate, CandidateModelSet *models);
     
     /**
      evaluate concatenated alignment
@@ -163,6 +179,8 @@ public:
     int df;      // #parameters
     double tree_len; // tree length, added 2015-06-24 for rcluster algorithm
     string tree; // added 2015-04-28: tree string
+    double gamma_shape; // estimated Gamma shape, 0 if none
+    double p_invar; // estimated proportion of invariable sites, 0 if none
     double AIC_score, AICc_score, BIC_score;    // scores
     double AIC_weight, AICc_weight, BIC_weight; // weights
     bool AIC_conf, AICc_conf, BIC_conf;         // in confidence set?
@@ -292,6 +310,75 @@ private:
     int64_t current_model;
 };
 
+/**
+ Tree shared by all candidate models that one thread evaluates on a fixed topology.
+ The tree and its partial likelihood buffers are created once and only reallocated
+ when a candidate needs more rate categories than allocated so far.
+ */
+class SharedModelTree {
+public:
+
+    SharedModelTree(CandidateModelSet *models) {
+        this->models = models;
+        tree = NULL;
+        aln = NULL;
+        alloc_ncat = 0;
+        alloc_nptn = 0;
+        alloc_nmix = 0;
+        alloc_site_specific = false;
+        warm_start = true;
+    }
+
+    ~SharedModelTree();
+
+    /**
+     @return TRUE if a candidate model can be evaluated on the shared tree
+     */
+    static bool isSupported(Params &params, CandidateModel *model);
+
+    /**
+     get the tree for the next candidate model, rereading the tree from the checkpoint
+     @param params program parameters
+     @param in_aln alignment of the candidate
+     @param num_threads number of threads
+     @param ckp checkpoint holding the current tree
+     @return tree without model
+     */
+    IQTree *getTree(Params &params, Alignment *in_aln, int num_threads, Checkpoint *ckp);
+
+    /**
+     assign partial likelihood vectors for the current model of the tree,
+     reusing the buffers if they are large enough
+     */
+    void initializePartialLh();
+
+    /** all candidate models, to warm-start rate parameters */
+    CandidateModelSet *models;
+
+    /** TRUE to warm-start rate parameters from finished candidates */
+    bool warm_start;
+
+private:
+
+    /** the tree */
+    IQTree *tree;
+
+    /** alignment of the tree */
+    Alignment *aln;
+
+    /** number of rate categories times mixture classes the buffers were allocated for */
+    size_t alloc_ncat;
+
+    /** number of patterns (including unobserved ones) the buffers were allocated for */
+    size_t alloc_nptn;
+
+    /** number of mixture classes the tip partial likelihoods were allocated for */
+    size_t alloc_nmix;
+
+    /** TRUE if buffers were allocated for a site-specific model */
+    bool alloc_site_specific;
+};
+
 //typedef vector<ModelInfo> ModelCheckpoint;
 
 class ModelCheckpoint : public Checkpoint {
@@ -182,22 +182,7 @@ void runterraceanalysis(Params &params){
 
 };
 
-void run_generate_trees(Terrace *terrace, Params &params,const int m){
-    
-    assert(m>=0 && "ERROR: required number m of leaves to be removed from the input tree is incorrect! m must be >=0. Exiting...");
-    if(m>=0){
-        terrace->rm_leaves = m;
-    }
-    // GET INFO FOR INITIAL TREE and TAXA TO INSERT
-    vector<string> taxa_names_sub;      // taxa to appear on initial tree
-    vector<string> list_taxa_to_insert; // list of taxa to be inserted.
-    int part_init = terrace->matrix->getINFO_init_tree_taxon_order(taxa_names_sub,list_taxa_to_insert,terrace->rm_leaves);
-    
-
-    // INITIAL TERRACE
-    // - to be used for generating trees
-    // - agile master tree is the initial tree
-    // - induced partition trees are common subtrees with induced partition trees of considered terrace
+Terrace *create_init_terrace(Terrace *terrace, vector<string> &taxa_names_sub, int part_init, const int m){
     
     // Creating a subterrace: submatrix and an initial tree
     PresenceAbsenceMatrix *submatrix = new PresenceAbsenceMatrix();
@@ -215,6 +200,27 @@ void run_generate_trees(Terrace *terrace, Params &params,const int m){
     Terrace *init_terrace = new Terrace(tree_init, submatrix);
     init_terrace->rm_leaves = m;
     init_terrace->master_terrace = terrace;
+    return init_terrace;
+}
+
+void run_generate_trees(Terrace *terrace, Params &params,const int m){
+    
+    assert(m>=0 && "ERROR: required number m of leaves to be removed from the input tree is incorrect! m must be >=0. Exiting...");
+    if(m>=0){
+        terrace->rm_leaves = m;
+    }
+    // GET INFO FOR INITIAL TREE and TAXA TO INSERT
+    vector<string> taxa_names_sub;      // taxa to appear on initial tree
+    vector<string> list_taxa_to_insert; // list of taxa to be inserted.
+    int part_init = terrace->matrix->getINFO_init_tree_taxon_order(taxa_names_sub,list_taxa_to_insert,terrace->rm_leaves);
+    
+
+    // INITIAL TERRACE
+    // - to be used for generating trees
+    // - agile master tree is the initial tree
+    // - induced partition trees are common subtrees with induced partition trees of considered terrace
+    
+    Terrace *init_terrace = create_init_terrace(terrace, taxa_names_sub, part_init, m);
 
     //init_terrace->printInfo();
     //init_terrace->matrix->print_pr_ab_matrix();
@@ -308,7 +314,9 @@ void run_generate_trees(Terrace *terrace, Params &params,const int m){
     cout<<"\n"<<"Generating trees from a stand...."<<"\n";
     
     bool use_dynamic_taxon_order = true;
-    if(use_dynamic_taxon_order){
+    if(params.terrace_task_depth > 0 && params.terrace_task_depth < list_taxa_to_insert.size()){
+        run_generate_trees_parallel(terrace, init_terrace, part_tree_pairs, params, taxa_names_sub, part_init, list_taxa_to_insert, use_dynamic_taxon_order);
+    }else if(use_dynamic_taxon_order){
         // TAXON ORDER: Based on the number of allowed branches.
         vector<string> ordered_taxa_to_insert;
         ordered_taxa_to_insert = list_taxa_to_insert;
@@ -326,6 +334,103 @@ void run_generate_trees(Terrace *terrace, Params &params,const int m){
 
 
 
+void run_generate_trees_parallel(Terrace *terrace, Terrace *init_terrace, vector<Terrace*> &part_tree_pairs, Params &params, vector<string> &taxa_names_sub, int part_init, vector<string> &list_taxa_to_insert, bool use_dynamic_taxon_order){
+    
+    // Collect the tasks: all insertions of the first terrace_task_depth taxa
+    vector<TerraceTask> tasks;
+    vector<string> ordered_taxa_to_insert = list_taxa_to_insert;
+    init_terrace->task_depth = params.terrace_task_depth;
+    init_terrace->tasks = &tasks;
+    init_terrace->generateTerraceTrees(terrace, part_tree_pairs, list_taxa_to_insert, 0, use_dynamic_taxon_order ? &ordered_taxa_to_insert : nullptr);
+    init_terrace->tasks = nullptr;
+    
+    int num_tasks = tasks.size();
+    cout<<"Number of subtrees of the search to be explored in parallel (depth "<<params.terrace_task_depth<<"): "<<num_tasks<<"\n";
+    
+    init_terrace->shared_terrace_trees_num = init_terrace->terrace_trees_num;
+    init_terrace->shared_intermediated_trees_num = init_terrace->intermediated_trees_num;
+    
+    vector<unsigned int> task_trees_num(num_tasks, 0), task_intermediated_num(num_tasks, 0), task_dead_ends_num(num_tasks, 0);
+    vector<string> task_out_file(num_tasks);
+    
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int k=0; k<num_tasks; k++){
+        if(init_terrace->task_stop_type != 0){
+            continue;
+        }
+        Terrace *task_terrace;
+        vector<Terrace*> task_part_tree_pairs;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            task_terrace = create_init_terrace(terrace, taxa_names_sub, part_init, init_terrace->rm_leaves);
+            task_terrace->linkTrees(true, false);
+            task_terrace->create_Top_Low_Part_Tree_Pairs(task_part_tree_pairs, terrace, false);
+        }
+        task_terrace->fillbrNodes();
+        task_terrace->matrix->uniq_taxa_num = terrace->matrix->uniq_taxa_num;
+        task_terrace->matrix->uniq_taxa_to_insert_num = terrace->matrix->uniq_taxa_to_insert_num;
+        
+        task_terrace->trees_out_lim = init_terrace->trees_out_lim;
+        task_terrace->terrace_out = init_terrace->terrace_out;
+        if(task_terrace->terrace_out){
+            task_out_file[k] = init_terrace->out_file + ".task" + convertIntToString(k);
+            task_terrace->out_file = task_out_file[k];
+            task_terrace->out.exceptions(ios::failbit | ios::badbit);
+            task_terrace->out.open(task_out_file[k]);
+        }
+        
+        task_terrace->generateTaskTrees(terrace, task_part_tree_pairs, tasks[k], init_terrace);
+        
+        if(task_terrace->terrace_out){
+            task_terrace->out.close();
+        }
+        task_trees_num[k] = task_terrace->terrace_trees_num;
+        task_intermediated_num[k] = task_terrace->intermediated_trees_num;
+        task_dead_ends_num[k] = task_terrace->dead_ends_num;
+        
+        for(const auto &p: task_part_tree_pairs){
+            p->unset_part_trees();
+            delete p;
+        }
+        delete task_terrace;
+    }
+    
+    // Merge in task order, so that the output does not depend on the thread schedule
+    for(int k=0; k<num_tasks; k++){
+        init_terrace->terrace_trees_num += task_trees_num[k];
+        init_terrace->intermediated_trees_num += task_intermediated_num[k];
+        init_terrace->dead_ends_num += task_dead_ends_num[k];
+    }
+    
+    if(init_terrace->terrace_out){
+        int trees_printed = 0;
+        for(int k=0; k<num_tasks; k++){
+            if(task_out_file[k].empty()){
+                continue;
+            }
+            ifstream in(task_out_file[k]);
+            string line;
+            while(getline(in, line)){
+                if(init_terrace->trees_out_lim>0 && trees_printed>=init_terrace->trees_out_lim){
+                    break;
+                }
+                init_terrace->out<<line<<"\n";
+                trees_printed++;
+            }
+            in.close();
+            remove(task_out_file[k].c_str());
+        }
+    }
+    
+    if(init_terrace->task_stop_type != 0){
+        init_terrace->write_warning_stop(init_terrace->task_stop_type);
+    }
+}
+
 void run_terrace_check(Terrace *terrace,Params &params){
     
     int i, count = 0;
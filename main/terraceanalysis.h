@@ -29,6 +29,16 @@ void run_terrace_check(Terrace *terrace, Params &params);
  */
 void run_generate_trees(Terrace *terrace, Params &params,const int m);
 
+/*
+        Create the initial terrace to generate trees from: a tree on taxa_names_sub and the corresponding submatrix
+ */
+Terrace *create_init_terrace(Terrace *terrace, vector<string> &taxa_names_sub, int part_init, const int m);
+
+/*
+        Parallel generation of terrace trees: the subtrees of the search below the first params.terrace_task_depth insertions are explored by OpenMP threads
+ */
+void run_generate_trees_parallel(Terrace *terrace, Terrace *init_terrace, vector<Terrace*> &part_tree_pairs, Params &params, vector<string> &taxa_names_sub, int part_init, vector<string> &list_taxa_to_insert, bool use_dynamic_taxon_order);
+
 /**
         The function is used to read a set of subtrees to be considered as partition trees for terrace analysis
  */
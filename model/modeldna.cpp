@@ -524,6 +524,25 @@ bool ModelDNA::getVariables(double *variables) {
 //              state_freq[highest_freq_state] = 1.0/sum;
 }
 
+bool ModelDNA::hasAnalyticGradient() {
+    // special DNA frequency types (e.g. FREQ_DNA_RY) are parameterized by freqsFromParams
+    return ModelMarkov::hasAnalyticGradient() && (freq_type == FREQ_ESTIMATE || getNDim() == num_params);
+}
+
+void ModelDNA::setVariablesGradient(double *grad_rates, double *grad_state_freq, double *dfx) {
+    if (num_params > 0) {
+        // rates linked by param_spec share one variable
+        int num_all = param_spec.length();
+        for (int i = 0; i < num_all; i++)
+            if (!param_fixed[param_spec[i]])
+                dfx[(int)param_spec[i]] += grad_rates[i];
+    }
+	if (freq_type == FREQ_ESTIMATE) {
+		int ndim = getNDim();
+		memcpy(dfx+(ndim-num_states+2), grad_state_freq, (num_states-1)*sizeof(double));
+    }
+}
+
 /*
  * setVariables *reads* the state of the model and writes into "variables"
  * Model does not change state. *variables should have length getNDim()+1
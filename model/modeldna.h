@@ -131,6 +131,20 @@ protected:
 	*/
 	virtual bool getVariables(double *variables);
 
+	/**
+		@return TRUE if the gradient w.r.t. the variables can be computed analytically
+	*/
+	virtual bool hasAnalyticGradient();
+
+	/**
+		convert the gradient w.r.t. rates and state_freq into the gradient w.r.t.
+		the variables, in the same layout as setVariables()
+		@param grad_rates gradient w.r.t. rates
+		@param grad_state_freq gradient w.r.t. state_freq
+		@param dfx (OUT) gradient w.r.t. the variables, indexed from 1
+	*/
+	virtual void setVariablesGradient(double *grad_rates, double *grad_state_freq, double *dfx);
+
 	/**
 		rate parameter specification, a string of 6 characters
 	*/
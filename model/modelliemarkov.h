@@ -137,6 +137,9 @@ protected:
 	*/
 	virtual bool getVariables(double *variables);
 
+	/** @return FALSE, the variables are not rates and state_freq of ModelMarkov */
+	virtual bool hasAnalyticGradient() { return false; }
+
 	static void parseModelName(string model_name, int* model_num, int* symmetry);
 	/*
          * Overrides ModelMarkov::getName().
@@ -1117,6 +1117,143 @@ double ModelMarkov::targetFunk(double x[]) {
 
 }
 
+double ModelMarkov::derivativeFunk(double x[], double dfx[]) {
+    if (!Params::getInstance().analytic_gradient || !hasAnalyticGradient() ||
+        phylo_tree->getModel() != this || !phylo_tree->isRateMatrixGradientSupported())
+        return Optimization::derivativeFunk(x, dfx);
+
+	bool changed = getVariables(x);
+	if (changed) {
+		decomposeRateMatrix();
+		phylo_tree->clearAllPartialLH();
+	}
+
+    // same checks as targetFunk, zero frequencies are eliminated from the eigensystem
+    for (int i = 0; i < num_states; i++)
+        if (state_freq[i] <= ZERO_FREQ || state_freq[i] < Params::getInstance().min_state_freq)
+            return Optimization::derivativeFunk(x, dfx);
+    // +I: invariant sites depend on state_freq
+    if (freq_type == FREQ_ESTIMATE && phylo_tree->getRate()->getPInvar() > 0.0)
+        return Optimization::derivativeFunk(x, dfx);
+
+    int ndim = getNDim();
+    double *grad_Q = new double[num_states*num_states];
+    double *grad_freq = new double[num_states];
+    double *grad_rates = new double[getNumRateEntries()];
+    double *grad_state_freq = new double[num_states];
+
+    double tree_lh = phylo_tree->computeRateMatrixGradient(grad_Q, grad_freq);
+    computeRateFreqGradient(grad_Q, grad_freq, grad_rates, grad_state_freq);
+    memset(dfx+1, 0, sizeof(double)*ndim);
+    setVariablesGradient(grad_rates, grad_state_freq, dfx);
+    // minimizing the negative log-likelihood
+    for (int i = 1; i <= ndim; i++)
+        dfx[i] = -dfx[i];
+
+    if (verbose_mode >= VB_DEBUG) {
+        // compare with the finite-difference gradient, then restore the model at x
+        double *fd_dfx = new double[ndim+1];
+        Optimization::derivativeFunk(x, fd_dfx);
+        targetFunk(x);
+        cout << "Gradient (analytic / finite difference):";
+        for (int i = 1; i <= ndim; i++)
+            cout << " " << dfx[i] << "/" << fd_dfx[i];
+        cout << endl;
+        delete [] fd_dfx;
+    }
+
+    delete [] grad_state_freq;
+    delete [] grad_rates;
+    delete [] grad_freq;
+    delete [] grad_Q;
+    return -tree_lh;
+}
+
+bool ModelMarkov::hasAnalyticGradient() {
+    // F81-type models (num_params == -1) use a non-symmetric eigensystem
+    return is_reversible && half_matrix && num_params >= 0 && !fixed_parameters;
+}
+
+void ModelMarkov::setVariablesGradient(double *grad_rates, double *grad_state_freq, double *dfx) {
+	int nrate = getNDim();
+	if (freq_type == FREQ_ESTIMATE) nrate -= (num_states-1);
+	if (nrate > 0)
+		memcpy(dfx+1, grad_rates, nrate*sizeof(double));
+	if (freq_type == FREQ_ESTIMATE) {
+		int ndim = getNDim();
+		memcpy(dfx+(ndim-num_states+2), grad_state_freq, (num_states-1)*sizeof(double));
+    }
+}
+
+void ModelMarkov::computeRateFreqGradient(double *grad_Q, double *grad_freq, double *grad_rates, double *grad_state_freq) {
+    int i, j, k;
+    int n = num_states;
+    double sum_freq = 0.0;
+    for (i = 0; i < n; i++)
+        sum_freq += state_freq[i];
+    double *f = new double[n];
+    double *fa = new double[n]; // frequency factor of the rate matrix
+    double *m = new double[n]; // row sums of the unnormalized rate matrix
+    double *grad_f = new double[n];
+    for (i = 0; i < n; i++) {
+        f[i] = state_freq[i] / sum_freq;
+        fa[i] = ignore_state_freq ? 1.0 : f[i];
+    }
+
+    // unnormalized rate matrix A[i][j] = fa[j]*rates[i][j] as in computeRateMatrix
+    double total = 0.0;
+    for (i = 0; i < n; i++) {
+        m[i] = 0.0;
+        for (j = 0; j < n; j++)
+            if (j != i)
+                m[i] += fa[j] * rates[(i < j) ? (i*(2*n-i-1)/2 + j-i-1) : (j*(2*n-j-1)/2 + i-j-1)];
+        total += f[i] * m[i];
+    }
+    double delta = normalize_matrix ? total_num_subst / total : 1.0;
+
+    // Q[i][j] = delta*A[i][j] and Q[i][i] = -sum of row i, so d/dA[i][j] includes
+    // the diagonal and, through delta, the normalization
+    double K = 0.0;
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            if (j != i) {
+                k = (i < j) ? (i*(2*n-i-1)/2 + j-i-1) : (j*(2*n-j-1)/2 + i-j-1);
+                K += (grad_Q[i*n+j] - grad_Q[i*n+i]) * fa[j] * rates[k];
+            }
+    double norm_coeff = normalize_matrix ? K / total : 0.0;
+    // E[i][j] = d lnL / dA[i][j], stored into grad_Q
+    double *E = grad_Q;
+    for (i = 0; i < n; i++) {
+        double diag = grad_Q[i*n+i];
+        for (j = 0; j < n; j++)
+            E[i*n+j] = (j == i) ? 0.0 : delta * (grad_Q[i*n+j] - diag - norm_coeff * f[i]);
+    }
+
+    for (i = 0, k = 0; i < n; i++)
+        for (j = i+1; j < n; j++, k++)
+            grad_rates[k] = E[i*n+j] * fa[j] + E[j*n+i] * fa[i];
+
+    for (i = 0; i < n; i++) {
+        grad_f[i] = grad_freq[i] - delta * norm_coeff * m[i];
+        if (!ignore_state_freq)
+            for (j = 0; j < n; j++)
+                if (j != i)
+                    grad_f[i] += E[j*n+i] * rates[(i < j) ? (i*(2*n-i-1)/2 + j-i-1) : (j*(2*n-j-1)/2 + i-j-1)];
+    }
+
+    // state_freq is not required to sum to 1 during optimization, f = state_freq/sum
+    double proj = 0.0;
+    for (i = 0; i < n; i++)
+        proj += f[i] * grad_f[i];
+    for (i = 0; i < n; i++)
+        grad_state_freq[i] = (grad_f[i] - proj) / sum_freq;
+
+    delete [] grad_f;
+    delete [] m;
+    delete [] fa;
+    delete [] f;
+}
+
 bool ModelMarkov::isUnstableParameters() {
 	int nrates = getNumRateEntries();
 	int i;
@@ -303,6 +303,15 @@ public:
 	*/
 	virtual double targetFunk(double x[]);
 
+	/**
+		the derivative function, analytic for reversible models with --analytic-grad,
+		otherwise by finite differences
+		@param x the input vector x
+		@param dfx the derivative at x
+		@return the function value at x
+	*/
+	virtual double derivativeFunk(double x[], double dfx[]);
+
 	/**
 	 * setup the bounds for joint optimization with BFGS
 	 */
@@ -461,6 +470,31 @@ protected:
 	*/
 	virtual bool getVariables(double *variables);
 
+	/**
+		@return TRUE if the gradient w.r.t. the variables can be computed analytically,
+		i.e. setVariablesGradient() is implemented for the variables of this model
+	*/
+	virtual bool hasAnalyticGradient();
+
+	/**
+		convert the gradient w.r.t. rates and state_freq into the gradient w.r.t.
+		the variables, in the same layout as setVariables()
+		@param grad_rates gradient w.r.t. rates
+		@param grad_state_freq gradient w.r.t. state_freq
+		@param dfx (OUT) gradient w.r.t. the variables, indexed from 1
+	*/
+	virtual void setVariablesGradient(double *grad_rates, double *grad_state_freq, double *dfx);
+
+	/**
+		chain rule from the gradient w.r.t. the rate matrix and the root frequencies,
+		computed by PhyloTree::computeRateMatrixGradient, to rates and state_freq
+		@param grad_Q gradient w.r.t. entries of the normalized rate matrix
+		@param grad_freq gradient w.r.t. normalized state frequencies at the root
+		@param grad_rates (OUT) gradient w.r.t. rates
+		@param grad_state_freq (OUT) gradient w.r.t. state_freq, which need not sum to 1
+	*/
+	void computeRateFreqGradient(double *grad_Q, double *grad_freq, double *grad_rates, double *grad_state_freq);
+
 
 	/**
 	 * Called from getVariables to update the rate matrix for the new
@@ -343,6 +343,9 @@ protected:
 		@return TRUE if parameters are changed, FALSE otherwise (2015-10-20)
 	*/
 	virtual bool getVariables(double *variables);
+
+	/** @return FALSE, the variables are not rates and state_freq of ModelMarkov */
+	virtual bool hasAnalyticGradient() { return false; }
     
     /**
      * check whether the mixture model contains dna error model: -1: undefined; 0: FALSE; 1: TRUE
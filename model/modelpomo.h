@@ -341,6 +341,9 @@ class ModelPoMo : virtual public ModelMarkov
      */
     virtual bool getVariables(double *variables);
 
+    /** @return FALSE, the variables are not rates and state_freq of ModelMarkov */
+    virtual bool hasAnalyticGradient() { return false; }
+
     /**
 	 * Called from getVariables() to update the rate matrix for the
 	 * new model parameters.  For ModelPoMo this is only a dummy
@@ -175,6 +175,9 @@ protected:
 	*/
 	virtual bool getVariables(double *variables);
 
+	/** @return FALSE, the variables are not rates and state_freq of ModelMarkov */
+	virtual bool hasAnalyticGradient() { return false; }
+
 	
 };
 
@@ -5,6 +5,7 @@
 //  Created by Nhan Ly-Trong on 23/03/2021.
 //
 
+#include <vectorclass/vectorclass.h>
 #include "alisimulator.h"
 #include "alisimulatorheterogeneity.h"
 #include "alisimulatorheterogeneityinvar.h"
@@ -697,8 +698,14 @@ void AliSimulator::getStateFrequenciesFromModel(IQTree* tree, double *state_freq
         // otherwise, randomly generate base frequencies based on uniform distribution
         else
             generateRandomBaseFrequencies(state_freqs);
+        if (tree == this->tree)
+            broadcastStateFreqs(state_freqs);
         tree->getModel()->setStateFrequency(state_freqs);
         tree->getModel()->decomposeRateMatrix();
+        
+        // the model has been re-parameterized -> the matrices cached from the previous alignment are outdated
+        if (trans_matrix_cache && tree == this->tree)
+            trans_matrix_cache->clear();
     }
 }
 
@@ -777,7 +784,7 @@ void AliSimulator::simulateSeqsForTree(map<string,string> input_msa, std::vector
     
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(getRandomSeed(0));
 
     
     // init variables
@@ -793,6 +800,20 @@ void AliSimulator::simulateSeqsForTree(map<string,string> input_msa, std::vector
     postSimulateSeqs(sequence_length, output_filepath, write_sequences_to_tmp_data);
 }
 
+/**
+    get the random seed of a thread for the current alignment
+*/
+int AliSimulator::getRandomSeed(int thread_id)
+{
+    int proc_ID = MPIHelper::getInstance().getProcessID();
+    
+    // every process simulates every alignment if sites are split across processes -> give each (alignment, process, thread) its own seed
+    if (params->alisim_mpi_segments)
+        return params->ran_seed + (params->alignment_id * MPIHelper::getInstance().getNumProcesses() + proc_ID) * params->num_threads + thread_id;
+    
+    return params->ran_seed + proc_ID * 1000 + thread_id + params->alignment_id;
+}
+
 void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, std::vector<bool>* const site_locked_vec, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping)
 {
     ostream *single_output = NULL;
@@ -803,7 +824,7 @@ void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_se
     
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(getRandomSeed(0));
     
     // simulate Sequences
     #ifdef _OPENMP
@@ -811,7 +832,7 @@ void AliSimulator::executeEM(int thread_id, int &sequence_length, int default_se
     {
         thread_id = omp_get_thread_num();
         // init random generators
-        int ran_seed = params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + thread_id + params->alignment_id;
+        int ran_seed = getRandomSeed(thread_id);
         init_random(ran_seed, false, &rstream);
         generator.seed(ran_seed);
 
@@ -1038,7 +1059,7 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
     vector<vector<short int>> sequence_cache;
     // default_random_engine for generating a random number from a discrete distribution
     default_random_engine generator;
-    generator.seed(params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + params->alignment_id);
+    generator.seed(getRandomSeed(0));
     
     // Bug fix: in some cases the ids of leaves are not continuous -> in IM algorithm with multiple threads, we use the leaf id to jump to the current position to output the simulated sequences -> we need to build a vector of continuous ids
     if (num_threads > 1)
@@ -1053,7 +1074,7 @@ void AliSimulator::executeIM(int thread_id, int &sequence_length, int default_se
     {
         thread_id = omp_get_thread_num();
         // init random generators
-        int ran_seed = params->ran_seed + MPIHelper::getInstance().getProcessID() * 1000 + thread_id + params->alignment_id;
+        int ran_seed = getRandomSeed(thread_id);
         init_random(ran_seed, false, &rstream);
         generator.seed(ran_seed);
             
@@ -2096,6 +2117,57 @@ int AliSimulator::getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *acc
     return binarysearchItemWithAccumulatedProbabilityMatrix(accumulated_probability_maxtrix, random_number, starting_index, starting_index+max_prob_position-1, starting_index)-starting_index;
 }
 
+/**
+*  count the entries of an accumulated probability row that are smaller than random_number, i.e., the index of the selected item
+*/
+static inline int countAccumulatedProbLessThan(const double *accumulated_probability_row, int num_columns, double random_number)
+{
+    Vec4d random_vec(random_number), row_vec;
+    int count = 0;
+    int c = 0;
+    for (; c + 4 <= num_columns; c += 4)
+    {
+        row_vec.load(accumulated_probability_row + c);
+        count += horizontal_count(row_vec < random_vec);
+    }
+    for (; c < num_columns; c++)
+        count += accumulated_probability_row[c] < random_number;
+    
+    // random_number may exceed the last entry due to numerical precision
+    return count < num_columns ? count : num_columns - 1;
+}
+
+/**
+*  sample the states of a sequence chunk from its parent's states
+*/
+void AliSimulator::sampleStatesWithAccumulatedProbMatrix(double *accumulated_trans_matrix, vector<short int> &dad_seq_chunk, vector<short int> &node_seq_chunk, const double *site_specific_rates, int* rstream)
+{
+    const int block_size = 256;
+    double random_numbers[block_size];
+    int num_sites = node_seq_chunk.size();
+    for (int block_start = 0; block_start < num_sites; block_start += block_size)
+    {
+        int block_end = min(block_start + block_size, num_sites);
+        
+        // draw random numbers in the same order as the site-by-site sampling, so the simulated sequences are unchanged
+        int num_randoms = 0;
+        for (int i = block_start; i < block_end; i++)
+            if (dad_seq_chunk[i] != STATE_UNKNOWN && !(site_specific_rates && site_specific_rates[i] == 0))
+                random_numbers[num_randoms++] = random_double(rstream);
+        
+        // select the state of each site from the row of its parent's state
+        num_randoms = 0;
+        for (int i = block_start; i < block_end; i++)
+        {
+            // gaps and invariant sites keep the parent's state
+            if (dad_seq_chunk[i] == STATE_UNKNOWN || (site_specific_rates && site_specific_rates[i] == 0))
+                node_seq_chunk[i] = dad_seq_chunk[i];
+            else
+                node_seq_chunk[i] = countAccumulatedProbLessThan(accumulated_trans_matrix + dad_seq_chunk[i] * max_num_states, max_num_states, random_numbers[num_randoms++]);
+        }
+    }
+}
+
 /**
 *  binary search an item from a set with accumulated probability array
 */
@@ -2477,6 +2549,18 @@ void AliSimulator::processDelayedFundi(Node *node, Node *dad)
     }
 }
 
+/**
+    share the state frequencies randomly drawn by the master with the other MPI processes
+*/
+void AliSimulator::broadcastStateFreqs(double *state_freqs)
+{
+#ifdef _IQTREE_MPI
+    // all segments of an alignment must be simulated under the same model
+    if (params->alisim_mpi_segments)
+        MPI_Bcast(state_freqs, max_num_states, MPI_DOUBLE, PROC_MASTER, MPI_COMM_WORLD);
+#endif
+}
+
 /**
     initialize state freqs for all model components (of a mixture model)
 */
@@ -2501,10 +2585,16 @@ void AliSimulator::intializeStateFreqsMixtureModel(IQTree* tree)
                 // otherwise, randomly generate base frequencies based on uniform distribution
                 else
                     generateRandomBaseFrequencies(state_freq);
+                if (tree == this->tree)
+                    broadcastStateFreqs(state_freq);
                 
                 model->getMixtureClass(i)->setStateFrequency(state_freq);
             }
         
+        // the mixture classes have been re-parameterized -> the matrices cached from the previous alignment are outdated
+        if (trans_matrix_cache && tree == this->tree)
+            trans_matrix_cache->clear();
+        
         // delete state_freq
         delete [] state_freq;
     }
@@ -2607,11 +2697,25 @@ void AliSimulator::simulateASequenceFromBranch(ModelSubst *model, int sequence_l
 */
 void AliSimulator::simulateASequenceFromBranchAfterInitVariables(int segment_start, ModelSubst *model, double *trans_matrix, vector<short int> &dad_seq_chunk, vector<short int> &node_seq_chunk, Node *node, NeighborVec::iterator it, int* rstream, string lengths)
 {
-    // compute the transition probability matrix
-    model->computeTransMatrix(partition_rate * params->alisim_branch_scale * (*it)->length, trans_matrix);
+    // reuse the accumulated probability matrix of this branch if it has been computed for a previous alignment
+    double *accumulated_trans_matrix = trans_matrix;
+    if (!findCachedTransMatrices(it, lengths, accumulated_trans_matrix))
+    {
+        // compute the transition probability matrix
+        model->computeTransMatrix(partition_rate * params->alisim_branch_scale * (*it)->length, trans_matrix);
+        
+        // convert the probability matrix into an accumulated probability matrix
+        convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
+        
+        cacheTransMatrices(it, lengths, trans_matrix, max_num_states * max_num_states);
+    }
     
-    // convert the probability matrix into an accumulated probability matrix
-    convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
+    // estimate the sequence for the current neighbor by blocks of sites
+    if (params->alisim_simd_sampling)
+    {
+        sampleStatesWithAccumulatedProbMatrix(accumulated_trans_matrix, dad_seq_chunk, node_seq_chunk, NULL, rstream);
+        return;
+    }
     
     // estimate the sequence for the current neighbor
     for (int i = 0; i < node_seq_chunk.size(); i++)
@@ -2623,11 +2727,32 @@ void AliSimulator::simulateASequenceFromBranchAfterInitVariables(int segment_sta
         {
             // iteratively select the state for each site of the child node, considering it's dad states, and the transition_probability_matrix
             int parent_state = dad_seq_chunk[i];
-            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
+            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(accumulated_trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
         }
     }
 }
 
+/**
+    get the accumulated transition matrices of a branch cached from a previous alignment
+*/
+bool AliSimulator::findCachedTransMatrices(NeighborVec::iterator it, string lengths, double *&matrices)
+{
+    // branch-specific models/lengths are not cached
+    if (!trans_matrix_cache || lengths.length() > 0 || (*it)->attributes.find("model") != (*it)->attributes.end())
+        return false;
+    return trans_matrix_cache->find((*it)->node, matrices);
+}
+
+/**
+    cache the accumulated transition matrices of a branch for the next alignments
+*/
+void AliSimulator::cacheTransMatrices(NeighborVec::iterator it, string lengths, double *matrices, int num_entries)
+{
+    if (!trans_matrix_cache || lengths.length() > 0 || (*it)->attributes.find("model") != (*it)->attributes.end())
+        return;
+    trans_matrix_cache->add((*it)->node, matrices, num_entries);
+}
+
 /**
     initialize variables (e.g., site-specific rate)
 */
@@ -2860,6 +2985,22 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
     else // otherwise, TRANS_PROB_MATRIX approach is used -> only count the number of gaps
         num_gaps = (*it)->node->sequence->num_gaps;
     
+    // dummy variables
+    int ori_seq_length = node_seq_chunk.size();
+    Insertion* insertion_before_simulation = latest_insertion;
+    
+    // move the sequence and its site rates into ropes, so that an insertion only shifts the sites of one chunk
+    int max_chunk_size = params->alisim_indel_rope ? ALISIM_ROPE_CHUNK_SIZE : INT_MAX;
+    ChunkedSequence<short int> seq_rope(max_chunk_size);
+    ChunkedSequence<double> sub_rate_rope(max_chunk_size);
+    seq_rope.assign(node_seq_chunk);
+    sub_rate_rope.assign(sub_rate_by_site);
+    
+    // select sites of events in O(log L) instead of building a discrete_distribution per event
+    SiteRateSampler *site_rate_sampler = NULL;
+    if (params->alisim_fenwick_sampler && (simulation_method == RATE_MATRIX || params->indel_rate_variation))
+        site_rate_sampler = new SiteRateSampler(sub_rate_rope);
+    
     double total_ins_rate = 0;
     double total_del_rate = 0;
     if (params->alisim_insertion_ratio + params->alisim_deletion_ratio > 0)
@@ -2886,10 +3027,6 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
     if (simulation_method == RATE_MATRIX)
         total_event_rate += total_sub_rate;
     
-    // dummy variables
-    int ori_seq_length = node_seq_chunk.size();
-    Insertion* insertion_before_simulation = latest_insertion;
-    
     double branch_length = (*it)->length * params->alisim_branch_scale;
     while (branch_length > 0)
     {
@@ -2920,13 +3057,13 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
             {
                 case INSERTION:
                 {
-                    length_change = handleInsertion(sequence_length, node_seq_chunk, total_sub_rate, sub_rate_by_site, simulation_method, generator);
+                    length_change = handleInsertion(sequence_length, seq_rope, total_sub_rate, sub_rate_rope, site_rate_sampler, simulation_method, generator);
                     segment_length = sequence_length;
                     break;
                 }
                 case DELETION:
                 {
-                    int deletion_length = handleDeletion(sequence_length, node_seq_chunk, total_sub_rate, sub_rate_by_site, simulation_method, generator);
+                    int deletion_length = handleDeletion(sequence_length, seq_rope, total_sub_rate, sub_rate_rope, site_rate_sampler, simulation_method, generator);
                     length_change = -deletion_length;
                     (*it)->node->sequence->num_gaps += deletion_length;
                     break;
@@ -2940,7 +3077,7 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
                             --predefined_mutation_count;
                         // otherwise, no predefined mutations or all of them were paid, handle a new substitution
                         else
-                            handleSubs(segment_start, total_sub_rate, sub_rate_by_site, node_seq_chunk, model->getNMixtures(), site_locked_vec, rstream, generator);
+                            handleSubs(segment_start, total_sub_rate, sub_rate_rope, site_rate_sampler, seq_rope, model->getNMixtures(), site_locked_vec, rstream, generator);
                     }
                     break;
                 }
@@ -2974,6 +3111,12 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
 
     }
     
+    if (site_rate_sampler)
+        delete site_rate_sampler;
+    
+    // materialize the evolved sequence once per branch
+    seq_rope.release(node_seq_chunk);
+    
     // if insertion events occur -> insert gaps to other nodes
     if (insertion_before_simulation && insertion_before_simulation->next)
     {
@@ -2996,9 +3139,9 @@ void AliSimulator::simulateSeqByGillespie(int segment_start, int &segment_length
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulator::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulator::insertNewSequenceForInsertionEvent(ChunkedSequence<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
-    indel_sequence.insert(indel_sequence.begin()+position, new_sequence.begin(), new_sequence.end());
+    indel_sequence.insert(position, new_sequence.begin(), new_sequence.end());
 }
 
 /**
@@ -3076,7 +3219,7 @@ void AliSimulator::updateInternalSeqsFromNodeToRoot(GenomeTree* genome_tree, int
 /**
     handle insertion events
 */
-int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator)
+int AliSimulator::handleInsertion(int &sequence_length, ChunkedSequence<short int> &indel_sequence, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, SIMULATION_METHOD simulation_method, default_random_engine& generator)
 {
     // Randomly select the position/site (from the set of all sites) where the insertion event occurs
     int position;
@@ -3085,10 +3228,7 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
         position = selectValidPositionForIndels(sequence_length + 1, indel_sequence);
     // with indel-rate variation -> based on the sub_rate_by_site
     else
-    {
-        discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-        position = random_discrete_dis(generator);
-    }
+        position = selectSiteBySubRates(sub_rate_by_site, site_rate_sampler, generator);
     
     // Randomly generate the length (length_I) of inserted sites from the indel-length distribution (​​geometric distribution (by default) or user-defined distributions).
     int length = -1;
@@ -3114,7 +3254,7 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
     {
         // update sub_rate_by_site of the inserted sites
         double sub_rate_change = 0;
-        sub_rate_by_site.insert(sub_rate_by_site.begin()+position, length, 0);
+        sub_rate_by_site.insert(position, length, 0.0);
         for (int i = position; i < position + length; i++)
         {
             // NHANLT: potential improvement
@@ -3124,6 +3264,10 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
             sub_rate_change += sub_rate_by_site[i];
         }
         
+        // refresh the sampler for the chunk receiving the inserted sites
+        if (site_rate_sampler)
+            site_rate_sampler->insert(position);
+        
         // update total_sub_rate
         total_sub_rate += sub_rate_change;
     }
@@ -3143,7 +3287,7 @@ int AliSimulator::handleInsertion(int &sequence_length, vector<short int> &indel
 /**
     handle deletion events
 */
-int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator)
+int AliSimulator::handleDeletion(int sequence_length, ChunkedSequence<short int> &indel_sequence, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, SIMULATION_METHOD simulation_method, default_random_engine& generator)
 {
     // Randomly generate the length (length_D) of sites (which will be deleted) from the indel-length distribution.
     int length = -1;
@@ -3170,10 +3314,7 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
     }
     // with indel-rate variation -> based on the sub_rate_by_site
     else
-    {
-        discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
-        position = random_discrete_dis(generator);
-    }
+        position = selectSiteBySubRates(sub_rate_by_site, site_rate_sampler, generator);
     
     // Replace up to length_D sites by gaps from the sequence starting at the selected location
     int real_deleted_length = 0;
@@ -3196,8 +3337,11 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
         // if RATE_MATRIX approach is used -> update sub_rate_by_site
         if (simulation_method == RATE_MATRIX || params->indel_rate_variation)
         {
-            sub_rate_change -= sub_rate_by_site[position + i];
+            double site_rate = sub_rate_by_site[position + i];
+            sub_rate_change -= site_rate;
             sub_rate_by_site[position + i] = 0;
+            if (site_rate_sampler && site_rate != 0)
+                site_rate_sampler->update(position + i, -site_rate);
         }
     }
     
@@ -3212,15 +3356,14 @@ int AliSimulator::handleDeletion(int sequence_length, vector<short int> &indel_s
 /**
     handle substitution events
 */
-void AliSimulator::handleSubs(int segment_start, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models, std::vector<bool>* const site_locked_vec, int* rstream, default_random_engine& generator)
+void AliSimulator::handleSubs(int segment_start, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, ChunkedSequence<short int> &indel_sequence, int num_mixture_models, std::vector<bool>* const site_locked_vec, int* rstream, default_random_engine& generator)
 {
     // select a position where the substitution event occurs
-    discrete_distribution<> random_discrete_dis(sub_rate_by_site.begin(), sub_rate_by_site.end());
     int pos;
     // make up to indel_sequence.size() attempts to select an unlocked site
     for (int i = 0; i < indel_sequence.size(); i++)
     {
-        pos = random_discrete_dis(generator);
+        pos = selectSiteBySubRates(sub_rate_by_site, site_rate_sampler, generator);
         
         // a valid site must NOT be locked
         if (!site_locked_vec || !site_locked_vec->at(segment_start + pos))
@@ -3255,13 +3398,38 @@ void AliSimulator::handleSubs(int segment_start, double &total_sub_rate, vector<
     
     // update sub_rate_by_site
     sub_rate_by_site[pos] += sub_rate_change;
+    if (site_rate_sampler)
+        site_rate_sampler->update(pos, sub_rate_change);
+}
+
+/**
+    select a site with probability proportional to its substitution rate
+*/
+int AliSimulator::selectSiteBySubRates(ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, default_random_engine& generator)
+{
+    if (site_rate_sampler)
+        return site_rate_sampler->sample(generator);
+    
+    // without a sampler, draw from a discrete_distribution over all sites in O(L)
+    if (sub_rate_by_site.getNumChunks() == 1)
+    {
+        vector<double> &rates = sub_rate_by_site.getChunk(0);
+        discrete_distribution<> random_discrete_dis(rates.begin(), rates.end());
+        return random_discrete_dis(generator);
+    }
+    vector<double> rates;
+    rates.reserve(sub_rate_by_site.size());
+    for (int i = 0; i < sub_rate_by_site.getNumChunks(); i++)
+        rates.insert(rates.end(), sub_rate_by_site.getChunk(i).begin(), sub_rate_by_site.getChunk(i).end());
+    discrete_distribution<> random_discrete_dis(rates.begin(), rates.end());
+    return random_discrete_dis(generator);
 }
 
 /**
 *  randomly select a valid position (not a deleted-site) for insertion/deletion event
 *
 */
-int AliSimulator::selectValidPositionForIndels(int upper_bound, vector<short int> &sequence)
+int AliSimulator::selectValidPositionForIndels(int upper_bound, ChunkedSequence<short int> &sequence)
 {
     int position = -1;
     for (int i = 0; i < upper_bound; i++)
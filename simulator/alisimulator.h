@@ -30,6 +30,12 @@
 #endif
 #include "utils/MPIHelper.h"
 #include "alignment/sequencechunkstr.h"
+#include "siteratesampler.h"
+#include "chunkedsequence.h"
+#include "transmatrixcache.h"
+
+// maximum number of sites per chunk of the evolving sequence with --indel-rope
+#define ALISIM_ROPE_CHUNK_SIZE 4096
 
 struct FunDi_Item {
   int selected_site;
@@ -93,6 +99,12 @@ protected:
     *  get a random item from a set of items with an accumulated probability array by binary search starting at the max probability
     */
     int getRandomItemWithAccumulatedProbMatrixMaxProbFirst(double *accumulated_probability_maxtrix, int starting_index, int num_columns, int max_prob_position, int* rstream);
+    
+    /**
+    *  sample the states of a sequence chunk from its parent's states, drawing random numbers in blocks and selecting states by vectorized compare-and-count
+    *  @param site_specific_rates sites with zero rate keep the parent's state (NULL if all sites are variable)
+    */
+    void sampleStatesWithAccumulatedProbMatrix(double *accumulated_trans_matrix, vector<short int> &dad_seq_chunk, vector<short int> &node_seq_chunk, const double *site_specific_rates, int* rstream);
 
     /**
     *  convert an probability matrix into an accumulated probability matrix
@@ -213,6 +225,17 @@ protected:
     */
     virtual void simulateASequenceFromBranchAfterInitVariables(int segment_start, ModelSubst *model, double *trans_matrix, vector<short int> &dad_seq_chunk, vector<short int> &node_seq_chunk, Node *node, NeighborVec::iterator it, int* rstream, string lengths = "");
     
+    /**
+        get the accumulated transition matrices of a branch cached from a previous alignment
+        @return FALSE if they have not been cached or caching is not applicable to this branch
+    */
+    bool findCachedTransMatrices(NeighborVec::iterator it, string lengths, double *&matrices);
+    
+    /**
+        cache the accumulated transition matrices of a branch for the next alignments
+    */
+    void cacheTransMatrices(NeighborVec::iterator it, string lengths, double *matrices, int num_entries);
+    
     /**
         initialize variables
     */
@@ -251,17 +274,17 @@ protected:
     /**
         handle substitution events
     */
-    void handleSubs(int segment_start, double &total_sub_rate, vector<double> &sub_rate_by_site, vector<short int> &indel_sequence, int num_mixture_models, std::vector<bool>* const site_locked_vec, int* rstream, default_random_engine& generator);
+    void handleSubs(int segment_start, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, ChunkedSequence<short int> &indel_sequence, int num_mixture_models, std::vector<bool>* const site_locked_vec, int* rstream, default_random_engine& generator);
     
     /**
         handle insertion events, return the insertion-size
     */
-    int handleInsertion(int &sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator);
+    int handleInsertion(int &sequence_length, ChunkedSequence<short int> &indel_sequence, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, SIMULATION_METHOD simulation_method, default_random_engine& generator);
     
     /**
         handle deletion events, return the deletion-size
     */
-    int handleDeletion(int sequence_length, vector<short int> &indel_sequence, double &total_sub_rate, vector<double> &sub_rate_by_site, SIMULATION_METHOD simulation_method, default_random_engine& generator);
+    int handleDeletion(int sequence_length, ChunkedSequence<short int> &indel_sequence, double &total_sub_rate, ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, SIMULATION_METHOD simulation_method, default_random_engine& generator);
     
     /**
         extract array of substitution rates and Jmatrix
@@ -277,7 +300,7 @@ protected:
     *  insert a new sequence into the current sequence
     *
     */
-    virtual void insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator);
+    virtual void insertNewSequenceForInsertionEvent(ChunkedSequence<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator);
     
     /**
     *  update internal sequences due to Indels
@@ -301,7 +324,12 @@ protected:
     *  randomly select a valid position (not a deleted-site) for insertion/deletion event
     *
     */
-    int selectValidPositionForIndels(int upper_bound, vector<short int> &sequence);
+    int selectValidPositionForIndels(int upper_bound, ChunkedSequence<short int> &sequence);
+    
+    /**
+        select a site with probability proportional to its substitution rate
+    */
+    int selectSiteBySubRates(ChunkedSequence<double> &sub_rate_by_site, SiteRateSampler *site_rate_sampler, default_random_engine& generator);
     
     /**
         generate indel-size from its distribution
@@ -423,6 +451,11 @@ protected:
     */
     void executeEM(int thread_id, int &sequence_length, int default_segment_length, ModelSubst *model, map<string,string> input_msa, std::vector<bool>* const site_locked_vec, string output_filepath, std::ios_base::openmode open_mode, bool write_sequences_to_tmp_data, bool store_seq_at_cache, int max_depth, vector<string> &state_mapping);
     
+    /**
+        get the random seed of a thread for the current alignment
+    */
+    int getRandomSeed(int thread_id);
+    
     /**
         merge output files when using multiple threads
     */
@@ -464,6 +497,7 @@ public:
     map<string, Node*> map_seqname_node; // mapping sequence name to Node (using when temporarily write sequences at tips to tmp_data file when simulating Indels)
     Insertion* latest_insertion = NULL;
     Insertion* first_insertion = NULL;
+    TransMatrixCache* trans_matrix_cache = NULL; // per-branch transition matrices shared by multiple alignments (owned by the caller)
     
     // variables to output sequences with multiple threads
     uint64_t starting_pos = 0;
@@ -517,6 +551,11 @@ public:
     */
     void refreshExpectedNumSites();
     
+    /**
+        share the state frequencies randomly drawn by the master with the other MPI processes when they simulate different sites of the same alignment
+    */
+    void broadcastStateFreqs(double *state_freqs);
+    
     /**
     *  initialize state_mapping (mapping from states into characters)
     *
@@ -33,6 +33,7 @@ AliSimulatorHeterogeneity::AliSimulatorHeterogeneity(AliSimulator *alisimulator)
     output_line_length = alisimulator->output_line_length;
     num_threads = alisimulator->num_threads;
     force_output_PHYLIP = alisimulator->force_output_PHYLIP;
+    trans_matrix_cache = alisimulator->trans_matrix_cache;
 }
 
 /**
@@ -611,29 +612,38 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
     {
         int num_models = tree->getModel()->isMixture()?tree->getModel()->getNMixtures():1;
         int num_rate_categories  = tree->getRateName().empty()?1:rate_heterogeneity->getNDiscreteRate();
-        double *cache_trans_matrix = new double[num_models * num_rate_categories * max_num_states * max_num_states];
         
-        // initialize a set of branch_lengths
-        DoubleVector branch_lengths;
-        // if heterotachy model is used in branch-specific model -> parse multiple lengths from the input string 'lengths'
-        if (rate_heterogeneity->isHeterotachy() && lengths.length() > 0)
+        // reuse the accumulated trans_matrices of this branch if they have been computed for a previous alignment
+        double *cache_trans_matrix = NULL;
+        bool is_cached = findCachedTransMatrices(it, lengths, cache_trans_matrix);
+        if (!is_cached)
         {
-            // parse lengths
-            convert_double_vec_with_distributions(lengths.c_str(), branch_lengths, true, '/');
+            int num_entries = num_models * num_rate_categories * max_num_states * max_num_states;
+            cache_trans_matrix = new double[num_entries];
+        
+            // initialize a set of branch_lengths
+            DoubleVector branch_lengths;
+            // if heterotachy model is used in branch-specific model -> parse multiple lengths from the input string 'lengths'
+            if (rate_heterogeneity->isHeterotachy() && lengths.length() > 0)
+            {
+                // parse lengths
+                convert_double_vec_with_distributions(lengths.c_str(), branch_lengths, true, '/');
             
-            if (num_rate_categories != branch_lengths.size())
-                outError("The number of lengths ("+convertIntToString(branch_lengths.size())+") is different from the number of caterogies ("+convertIntToString(num_rate_categories)+"). Please check and try again!");
-        }
-        // otherwise, get branch-length from the tree
-        else
-        {
-            branch_lengths.resize(num_rate_categories);
-            for (int i = 0; i < num_rate_categories; i++)
-                branch_lengths[i] = (*it)->getLength(i);
-        }
+                if (num_rate_categories != branch_lengths.size())
+                    outError("The number of lengths ("+convertIntToString(branch_lengths.size())+") is different from the number of caterogies ("+convertIntToString(num_rate_categories)+"). Please check and try again!");
+            }
+            // otherwise, get branch-length from the tree
+            else
+            {
+                branch_lengths.resize(num_rate_categories);
+                for (int i = 0; i < num_rate_categories; i++)
+                    branch_lengths[i] = (*it)->getLength(i);
+            }
         
-        // initialize caching accumulated trans_matrices
-        intializeCachingAccumulatedTransMatrices(cache_trans_matrix, num_models, num_rate_categories, branch_lengths, trans_matrix, model);
+            // initialize caching accumulated trans_matrices
+            intializeCachingAccumulatedTransMatrices(cache_trans_matrix, num_models, num_rate_categories, branch_lengths, trans_matrix, model);
+            cacheTransMatrices(it, lengths, cache_trans_matrix, num_entries);
+        }
 
         // estimate the sequence
         for (int i = 0 ; i < node_seq_chunk.size(); i++)
@@ -648,7 +658,8 @@ void AliSimulatorHeterogeneity::simulateASequenceFromBranchAfterInitVariables(in
         }
         
         // delete cache_trans_matrix
-        delete [] cache_trans_matrix;
+        if (!is_cached)
+            delete [] cache_trans_matrix;
     }
     // otherwise, estimating the sequence without trans_matrix caching
     else
@@ -698,7 +709,7 @@ void AliSimulatorHeterogeneity::initVariablesRateHeterogeneity(int sequence_leng
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulatorHeterogeneity::insertNewSequenceForInsertionEvent(ChunkedSequence<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
     // init new_site_to_patternID
     IntVector new_site_to_patternID;
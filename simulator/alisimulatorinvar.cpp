@@ -33,6 +33,7 @@ AliSimulatorInvar::AliSimulatorInvar(AliSimulator *alisimulator, double invar_pr
     output_line_length = alisimulator->output_line_length;
     num_threads = alisimulator->num_threads;
     force_output_PHYLIP = alisimulator->force_output_PHYLIP;
+    trans_matrix_cache = alisimulator->trans_matrix_cache;
 }
 
 /**
@@ -43,11 +44,25 @@ void AliSimulatorInvar::simulateASequenceFromBranchAfterInitVariables(int segmen
     // rescale ratio due to invariant sites
     double scale = 1.0 / (1 - invariant_proportion);
     
-    // compute the transition probability matrix
-    model->computeTransMatrix(partition_rate * params->alisim_branch_scale * (*it)->length * scale, trans_matrix);
+    // reuse the accumulated probability matrix of this branch if it has been computed for a previous alignment
+    double *accumulated_trans_matrix = trans_matrix;
+    if (!findCachedTransMatrices(it, lengths, accumulated_trans_matrix))
+    {
+        // compute the transition probability matrix
+        model->computeTransMatrix(partition_rate * params->alisim_branch_scale * (*it)->length * scale, trans_matrix);
+        
+        // convert the probability matrix into an accumulated probability matrix
+        convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
+        
+        cacheTransMatrices(it, lengths, trans_matrix, max_num_states * max_num_states);
+    }
     
-    // convert the probability matrix into an accumulated probability matrix
-    convertProMatrixIntoAccumulatedProMatrix(trans_matrix, max_num_states, max_num_states);
+    // estimate the sequence for the current neighbor by blocks of sites
+    if (params->alisim_simd_sampling)
+    {
+        sampleStatesWithAccumulatedProbMatrix(accumulated_trans_matrix, dad_seq_chunk, node_seq_chunk, site_specific_rates.data() + segment_start, rstream);
+        return;
+    }
     
     // estimate the sequence for the current neighbor
     for (int i = 0; i < node_seq_chunk.size(); i++)
@@ -61,7 +76,7 @@ void AliSimulatorInvar::simulateASequenceFromBranchAfterInitVariables(int segmen
             // NHANLT: potential improvement
             // cache parent_state * max_num_states
             int parent_state = dad_seq_chunk[i];
-            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
+            node_seq_chunk[i] = getRandomItemWithAccumulatedProbMatrixMaxProbFirst(accumulated_trans_matrix, parent_state * max_num_states, max_num_states, parent_state, rstream);
         }
     }
 }
@@ -94,7 +109,7 @@ void AliSimulatorInvar::initSiteSpecificRates(vector<double> &site_specific_rate
 *  insert a new sequence into the current sequence
 *
 */
-void AliSimulatorInvar::insertNewSequenceForInsertionEvent(vector<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
+void AliSimulatorInvar::insertNewSequenceForInsertionEvent(ChunkedSequence<short int> &indel_sequence, int position, vector<short int> &new_sequence, default_random_engine& generator)
 {
     // initialize new_site_specific_rates for new sequence
     vector<double> new_site_specific_rates;
@@ -0,0 +1,235 @@
+//
+//  chunkedsequence.h
+//  iqtree
+//
+//  A rope of bounded-size chunks holding the evolving sequence (or its site rates)
+//  during the Gillespie simulation of a branch. An insertion only moves the sites
+//  of one chunk and the chunk is located through a Fenwick tree over chunk sizes,
+//  so indels no longer shift the whole sequence.
+//
+
+#ifndef chunkedsequence_h
+#define chunkedsequence_h
+
+#include <vector>
+#include <climits>
+#include <cstddef>
+#include "fenwicktree.h"
+
+using namespace std;
+
+template <class T>
+class ChunkedSequence {
+public:
+
+    /**
+        constructor
+        @param max_chunk_size chunks longer than this are split; INT_MAX keeps a single chunk (plain vector behavior)
+    */
+    ChunkedSequence(int max_chunk_size = INT_MAX) : max_chunk_size(max_chunk_size < 2 ? 2 : max_chunk_size), total(0), last_split_chunk(0), last_split_pieces(1)
+    {
+        chunks.resize(1);
+        rebuildIndex();
+    }
+
+    /**
+        take over the content of seq (seq is left empty)
+    */
+    void assign(vector<T> &seq)
+    {
+        chunks.clear();
+        chunks.resize(1);
+        chunks[0].swap(seq);
+        total = chunks[0].size();
+        if (total > (size_t) max_chunk_size)
+            splitChunk(0);
+        else
+            rebuildIndex();
+    }
+
+    /**
+        materialize the whole sequence into seq (this rope is left empty)
+    */
+    void release(vector<T> &seq)
+    {
+        if (chunks.size() == 1)
+            seq.swap(chunks[0]);
+        else
+        {
+            seq.clear();
+            seq.reserve(total);
+            for (size_t i = 0; i < chunks.size(); i++)
+                seq.insert(seq.end(), chunks[i].begin(), chunks[i].end());
+        }
+        chunks.clear();
+        chunks.resize(1);
+        total = 0;
+        rebuildIndex();
+    }
+
+    /**
+        @return number of sites
+    */
+    size_t size() const
+    {
+        return total;
+    }
+
+    /**
+        access a site, O(log #chunks)
+    */
+    T& operator[](size_t pos)
+    {
+        if (chunks.size() == 1)
+            return chunks[0][pos];
+        size_t offset;
+        int chunk = findChunk(pos, offset);
+        return chunks[chunk][offset];
+    }
+
+    /**
+        insert count copies of value before pos
+    */
+    void insert(size_t pos, size_t count, const T &value)
+    {
+        size_t offset;
+        int chunk = findChunkForInsert(pos, offset);
+        chunks[chunk].insert(chunks[chunk].begin() + offset, count, value);
+        afterInsert(chunk, count);
+    }
+
+    /**
+        insert [first, last) before pos
+    */
+    template <class InputIt>
+    void insert(size_t pos, InputIt first, InputIt last)
+    {
+        size_t offset;
+        int chunk = findChunkForInsert(pos, offset);
+        size_t old_size = chunks[chunk].size();
+        chunks[chunk].insert(chunks[chunk].begin() + offset, first, last);
+        afterInsert(chunk, chunks[chunk].size() - old_size);
+    }
+
+    /**
+        @return number of chunks
+    */
+    int getNumChunks() const
+    {
+        return chunks.size();
+    }
+
+    /**
+        @return the sites of a chunk
+    */
+    vector<T>& getChunk(int chunk)
+    {
+        return chunks[chunk];
+    }
+
+    /**
+        @return the chunk containing pos, and the position of pos inside that chunk
+    */
+    int findChunk(size_t pos, size_t &offset) const
+    {
+        offset = pos;
+        return searchFenwickTree(index, top_step, offset);
+    }
+
+    /**
+        @return the position of the first site of a chunk
+    */
+    size_t getChunkStart(int chunk) const
+    {
+        return prefixSumFenwickTree(index, chunk);
+    }
+
+    /**
+        @param first_chunk (OUT) the first chunk produced by the split of the last insertion
+        @return the number of chunks the last insertion split its chunk into (1 if no split)
+    */
+    int getLastSplit(int &first_chunk) const
+    {
+        first_chunk = last_split_chunk;
+        return last_split_pieces;
+    }
+
+protected:
+
+    /**
+        locate the chunk to insert into; pos == size() appends to the last chunk
+    */
+    int findChunkForInsert(size_t pos, size_t &offset) const
+    {
+        if (pos >= total)
+        {
+            offset = chunks.back().size();
+            return chunks.size() - 1;
+        }
+        return findChunk(pos, offset);
+    }
+
+    /**
+        update the index after count sites were inserted into a chunk
+    */
+    void afterInsert(int chunk, size_t count)
+    {
+        total += count;
+        last_split_chunk = chunk;
+        last_split_pieces = 1;
+        if (chunks[chunk].size() > (size_t) max_chunk_size)
+            splitChunk(chunk);
+        else
+            updateFenwickTree(index, chunk, count);
+    }
+
+    /**
+        split an oversized chunk into pieces of half the maximum size, then rebuild the index in O(#chunks)
+    */
+    void splitChunk(int chunk)
+    {
+        size_t piece = max_chunk_size / 2;
+        vector<T> old_chunk;
+        old_chunk.swap(chunks[chunk]);
+        size_t num_pieces = (old_chunk.size() + piece - 1) / piece;
+        chunks.insert(chunks.begin() + chunk + 1, num_pieces - 1, vector<T>());
+        for (size_t i = 0; i < num_pieces; i++)
+        {
+            size_t start = i * piece;
+            size_t end = (start + piece < old_chunk.size()) ? start + piece : old_chunk.size();
+            chunks[chunk + i].assign(old_chunk.begin() + start, old_chunk.begin() + end);
+        }
+        last_split_chunk = chunk;
+        last_split_pieces = num_pieces;
+        rebuildIndex();
+    }
+
+    /**
+        rebuild the Fenwick tree over chunk sizes
+    */
+    void rebuildIndex()
+    {
+        top_step = buildFenwickTree(chunks, index, [](const vector<T> &chunk) { return chunk.size(); });
+    }
+
+    /** chunks of sites */
+    vector<vector<T> > chunks;
+
+    /** index[i] = sum of sizes of chunks[i-(i&-i) .. i-1], 1-based */
+    vector<size_t> index;
+
+    /** largest power of two <= number of chunks */
+    int top_step;
+
+    /** maximum number of sites per chunk */
+    int max_chunk_size;
+
+    /** number of sites */
+    size_t total;
+
+    /** first chunk and number of chunks produced by the last insertion (1 piece if it did not split) */
+    int last_split_chunk;
+    int last_split_pieces;
+};
+
+#endif /* chunkedsequence_h */
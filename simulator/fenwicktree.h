@@ -0,0 +1,99 @@
+//
+//  fenwicktree.h
+//  iqtree
+//
+//  Fenwick (binary indexed) tree helpers shared by ChunkedSequence (over chunk sizes)
+//  and SiteRateSampler (over site rates). Trees are 1-based: tree[i] holds the sum of
+//  values[i-(i&-i) .. i-1], tree[0] is unused.
+//
+
+#ifndef fenwicktree_h
+#define fenwicktree_h
+
+#include <vector>
+
+using namespace std;
+
+/**
+    build a Fenwick tree over values in O(n)
+    @param values values to index
+    @param tree (OUT) the Fenwick tree, of size values.size() + 1
+    @param get_value functor extracting the value to index from an element of values
+    @return the largest power of two <= values.size(), the first step of searchFenwickTree
+*/
+template <class V, class T, class GetValue>
+int buildFenwickTree(const vector<V> &values, vector<T> &tree, GetValue get_value)
+{
+    int n = values.size();
+    tree.resize(n + 1);
+    tree[0] = 0;
+    for (int i = 1; i <= n; i++)
+        tree[i] = get_value(values[i - 1]);
+    for (int i = 1; i <= n; i++)
+    {
+        int parent = i + (i & -i);
+        if (parent <= n)
+            tree[parent] += tree[i];
+    }
+    int top_step = 1;
+    while (top_step * 2 <= n)
+        top_step *= 2;
+    return top_step;
+}
+
+/**
+    build a Fenwick tree directly over values
+*/
+template <class T>
+int buildFenwickTree(const vector<T> &values, vector<T> &tree)
+{
+    return buildFenwickTree(values, tree, [](const T &value) { return value; });
+}
+
+/**
+    add delta at a 0-based position of a Fenwick tree
+*/
+template <class T>
+void updateFenwickTree(vector<T> &tree, int pos, T delta)
+{
+    int n = tree.size() - 1;
+    for (int i = pos + 1; i <= n; i += i & -i)
+        tree[i] += delta;
+}
+
+/**
+    @return the sum of the values at 0-based positions [0, pos)
+*/
+template <class T>
+T prefixSumFenwickTree(const vector<T> &tree, int pos)
+{
+    T sum = 0;
+    for (int i = pos; i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+/**
+    @param target (IN) the value to locate, (OUT) its offset inside the returned position
+    @param strict false: the interval of a position is [start, end), for 0-based offsets;
+        true: it is (start, end], so that a position with value 0 is never returned for target > 0
+    @return the 0-based position whose cumulative interval contains target (n if target exceeds the total)
+*/
+template <class T>
+int searchFenwickTree(const vector<T> &tree, int top_step, T &target, bool strict = false)
+{
+    int n = tree.size() - 1;
+    int pos = 0;
+    for (int step = top_step; step > 0; step >>= 1)
+    {
+        int next = pos + step;
+        if (next <= n && (strict ? tree[next] < target : tree[next] <= target))
+        {
+            pos = next;
+            target -= tree[next];
+        }
+    }
+    return pos;
+}
+
+#endif /* fenwicktree_h */
@@ -0,0 +1,99 @@
+//
+//  siteratesampler.cpp
+//  iqtree
+//
+
+#include "siteratesampler.h"
+
+SiteRateSampler::SiteRateSampler(ChunkedSequence<double> &rates) : rates(rates)
+{
+    build();
+}
+
+double SiteRateSampler::buildChunk(int chunk)
+{
+    vector<double> &chunk_rates = rates.getChunk(chunk);
+    top_steps[chunk] = buildFenwickTree(chunk_rates, trees[chunk]);
+    return prefixSumFenwickTree(trees[chunk], chunk_rates.size());
+}
+
+void SiteRateSampler::build()
+{
+    int num_chunks = rates.getNumChunks();
+    trees.resize(num_chunks);
+    top_steps.resize(num_chunks);
+    chunk_totals.resize(num_chunks);
+    for (int c = 0; c < num_chunks; c++)
+        chunk_totals[c] = buildChunk(c);
+    chunk_top_step = buildFenwickTree(chunk_totals, chunk_tree);
+    num_updates = 0;
+}
+
+void SiteRateSampler::update(int site, double delta)
+{
+    // rebuild once in a while so that the partial sums do not drift away from the rates
+    if (++num_updates > (int)rates.size())
+    {
+        build();
+        return;
+    }
+    size_t offset;
+    int chunk = rates.findChunk(site, offset);
+    updateFenwickTree(trees[chunk], offset, delta);
+    chunk_totals[chunk] += delta;
+    updateFenwickTree(chunk_tree, chunk, delta);
+}
+
+void SiteRateSampler::insert(int site)
+{
+    // the inserted sites split a chunk -> rebuild only the pieces of that chunk and the tree over chunk totals
+    int first_chunk;
+    int num_pieces = rates.getLastSplit(first_chunk);
+    if (num_pieces > 1)
+    {
+        int num_new = rates.getNumChunks() - trees.size();
+        trees.insert(trees.begin() + first_chunk + 1, num_new, vector<double>());
+        top_steps.insert(top_steps.begin() + first_chunk + 1, num_new, 0);
+        chunk_totals.insert(chunk_totals.begin() + first_chunk + 1, num_new, 0.0);
+        for (int c = first_chunk; c < first_chunk + num_pieces; c++)
+            chunk_totals[c] = buildChunk(c);
+        chunk_top_step = buildFenwickTree(chunk_totals, chunk_tree);
+        return;
+    }
+    size_t offset;
+    int chunk = (site < (int) rates.size()) ? rates.findChunk(site, offset) : rates.getNumChunks() - 1;
+    double total = buildChunk(chunk);
+    updateFenwickTree(chunk_tree, chunk, total - chunk_totals[chunk]);
+    chunk_totals[chunk] = total;
+}
+
+double SiteRateSampler::getTotal() const
+{
+    return prefixSumFenwickTree(chunk_tree, chunk_totals.size());
+}
+
+int SiteRateSampler::findSite(double target) const
+{
+    // strict search: target in (0, total] never falls into the empty interval of a zero-rate site
+    int chunk = searchFenwickTree(chunk_tree, chunk_top_step, target, true);
+    if (chunk >= (int) trees.size())
+        return rates.size();
+    int offset = searchFenwickTree(trees[chunk], top_steps[chunk], target, true);
+    return rates.getChunkStart(chunk) + offset;
+}
+
+int SiteRateSampler::sample(default_random_engine &generator)
+{
+    int n = rates.size();
+    uniform_real_distribution<double> random_uniform(0.0, 1.0);
+    for (;;)
+    {
+        // 1 - u lies in (0, 1]
+        int site = findSite((1.0 - random_uniform(generator)) * getTotal());
+        if (site < n && rates[site] > 0)
+            return site;
+        // round-off in the partial sums pushed target past a chunk or onto a zero-rate site:
+        // rebuild the trees from the rates and redraw
+        build();
+    }
+}
@@ -0,0 +1,95 @@
+//
+//  siteratesampler.h
+//  iqtree
+//
+//  Fenwick (binary indexed) trees over the substitution rates of sites,
+//  used to pick the site of an event in the Gillespie simulation
+//  in O(log L) instead of building a discrete_distribution per event.
+//  One tree is kept per chunk of the site rates, plus one over the chunk totals,
+//  so that an insertion only rebuilds the tree of the chunk(s) it falls into.
+//
+
+#ifndef siteratesampler_h
+#define siteratesampler_h
+
+#include <vector>
+#include <random>
+#include "chunkedsequence.h"
+#include "fenwicktree.h"
+
+using namespace std;
+
+class SiteRateSampler {
+public:
+
+    /**
+        constructor
+        @param rates site rates, kept in sync by the caller (not copied)
+    */
+    SiteRateSampler(ChunkedSequence<double> &rates);
+
+    /**
+        rebuild all trees from the site rates in O(L)
+    */
+    void build();
+
+    /**
+        add delta to the rate of a site, the caller has already updated rates[site]
+        @param site site index
+        @param delta rate change
+    */
+    void update(int site, double delta);
+
+    /**
+        refresh the trees after sites were inserted at a position, the caller has already inserted them into rates
+        @param site position of the first inserted site
+    */
+    void insert(int site);
+
+    /**
+        @return total rate of all sites
+    */
+    double getTotal() const;
+
+    /**
+        select a site with probability proportional to its rate
+        @param generator random number generator
+        @return site index
+    */
+    int sample(default_random_engine &generator);
+
+protected:
+
+    /**
+        rebuild the tree of one chunk and return the chunk total
+    */
+    double buildChunk(int chunk);
+
+    /**
+        @return the site whose cumulative rate interval contains target
+    */
+    int findSite(double target) const;
+
+    /** site rates */
+    ChunkedSequence<double> &rates;
+
+    /** trees[c][i] = sum of rates of chunk c at [i-(i&-i) .. i-1], 1-based */
+    vector<vector<double> > trees;
+
+    /** largest power of two <= number of sites of each chunk */
+    vector<int> top_steps;
+
+    /** tree over chunk_totals, same layout as trees[c] */
+    vector<double> chunk_tree;
+
+    /** total rate of each chunk */
+    vector<double> chunk_totals;
+
+    /** largest power of two <= number of chunks */
+    int chunk_top_step;
+
+    /** number of updates since the last build, to bound round-off drift */
+    int num_updates;
+};
+
+#endif /* siteratesampler_h */
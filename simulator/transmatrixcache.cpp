@@ -0,0 +1,39 @@
+//
+//  transmatrixcache.cpp
+//  iqtree
+//
+
+#include "transmatrixcache.h"
+
+bool TransMatrixCache::find(Node *node, double *&matrices)
+{
+    bool found = false;
+    #ifdef _OPENMP
+    #pragma omp critical (trans_matrix_cache)
+    #endif
+    {
+        map<Node*, vector<double> >::iterator it = branch_matrices.find(node);
+        if (it != branch_matrices.end())
+        {
+            matrices = it->second.data();
+            found = true;
+        }
+    }
+    return found;
+}
+
+void TransMatrixCache::add(Node *node, double *matrices, int num_entries)
+{
+    #ifdef _OPENMP
+    #pragma omp critical (trans_matrix_cache)
+    #endif
+    {
+        if (branch_matrices.find(node) == branch_matrices.end())
+            branch_matrices[node].assign(matrices, matrices + num_entries);
+    }
+}
+
+void TransMatrixCache::clear()
+{
+    branch_matrices.clear();
+}
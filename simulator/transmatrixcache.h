@@ -0,0 +1,48 @@
+//
+//  transmatrixcache.h
+//  iqtree
+//
+//  Accumulated transition probability matrices of each branch, computed once
+//  and reused when simulating multiple alignments from the same tree and model.
+//
+
+#ifndef transmatrixcache_h
+#define transmatrixcache_h
+
+#include <map>
+#include <vector>
+#include "tree/node.h"
+
+using namespace std;
+
+class TransMatrixCache {
+public:
+
+    /**
+        find the matrices of the branch leading to a node (thread-safe)
+        @param node the child node of the branch
+        @param matrices (OUT) the cached matrices
+        @return TRUE if the matrices of this branch have been cached
+    */
+    bool find(Node *node, double *&matrices);
+
+    /**
+        store the matrices of the branch leading to a node, keeping the first copy if several threads add the same branch (thread-safe)
+        @param node the child node of the branch
+        @param matrices the accumulated transition matrices
+        @param num_entries number of entries of matrices
+    */
+    void add(Node *node, double *matrices, int num_entries);
+
+    /**
+        remove all cached matrices
+    */
+    void clear();
+
+protected:
+
+    /** cached matrices of each branch, keyed by its child node */
+    map<Node*, vector<double> > branch_matrices;
+};
+
+#endif /* transmatrixcache_h */
@@ -795,7 +795,7 @@ void Terrace::printBackMapInfo(){
     }
 }
 
-void Terrace::create_Top_Low_Part_Tree_Pairs(vector<Terrace*> &part_tree_pairs, Terrace *terrace){
+void Terrace::create_Top_Low_Part_Tree_Pairs(vector<Terrace*> &part_tree_pairs, Terrace *terrace, bool check_compatibility){
     
     int i=0;
     NodeVector aux_taxon_nodes;
@@ -803,7 +803,7 @@ void Terrace::create_Top_Low_Part_Tree_Pairs(vector<Terrace*> &part_tree_pairs,
     IntVector parts;
     bool back_branch_map = false, back_taxon_map = true;
 
-    if(!terrace->root){
+    if(!terrace->root && check_compatibility){
         cout<<"Since no represenative tree was provided, performing a basic compatibility check..\n";
         /* ---------------------------------------------------------------------------------------------
             If no input representative tree, perform basic compatibility check:
@@ -1090,7 +1090,11 @@ void Terrace::extendNewTaxon(string node_name, TerraceNode *node_1_branch, Terra
     //printTree(cout, WT_BR_SCALE | WT_NEWLINE);
     
     intermediated_trees_num +=1;
-    if(verbose_mode>=VB_MED){
+    if(task_master){
+        if(++task_master->shared_intermediated_trees_num >= intermediate_max_trees){
+            write_warning_stop(1);
+        }
+    } else if(verbose_mode>=VB_MED){
         if((intermediated_trees_num+terrace_trees_num) % 100000 == 0 and terrace_trees_num < 10000000){
             cout<<"... trees generated - "<<intermediated_trees_num + terrace_trees_num<<"; intermediated - "<<intermediated_trees_num<<"; stand - "<<terrace_trees_num<<"; dead paths - "<<dead_ends_num<<"\n";
         }else if(terrace_trees_num == 10000000){
@@ -1098,7 +1102,7 @@ void Terrace::extendNewTaxon(string node_name, TerraceNode *node_1_branch, Terra
         }
     }
     
-    if(intermediated_trees_num == intermediate_max_trees){
+    if(!task_master && intermediated_trees_num == intermediate_max_trees){
         for(const auto &p: part_tree_pairs){
             p->unset_part_trees();
         }
@@ -1156,12 +1160,44 @@ void Terrace::generateTerraceTrees(Terrace *terrace, vector<Terrace*> &part_tree
             
             //id = terrace->matrix->findTaxonID(taxon_name);
             //assert(id!=-1);
+            string split_name;
+            if(tasks && taxon_to_insert < task_depth){
+                split_name = getBranchSplitName(node1_vec_branch[j],node2_vec_branch[j]);
+            }
             extendNewTaxon(taxon_name,(TerraceNode*)node1_vec_branch[j],(TerraceNode*)node2_vec_branch[j],part_tree_pairs);
             //this->printTree(cout,WT_NEWLINE);
+            if(task_stopped()){
+                return;
+            }
+            
+            if(tasks && taxon_to_insert == task_depth-1){
+                // Parallel generation: the search below this insertion is left to a task
+                TerraceTask task = current_task;
+                task.taxa.push_back(taxon_name);
+                task.branches.push_back(split_name);
+                task.list_taxa_to_insert = list_taxa_to_insert;
+                if(ordered_taxa_to_insert){
+                    task.ordered_taxa_to_insert = *ordered_taxa_to_insert;
+                }
+                tasks->push_back(task);
+                remove_one_taxon(taxon_name,part_tree_pairs);
+                continue;
+            }
             
             if(taxon_to_insert != list_taxa_to_insert.size()-1){
                 
+                if(tasks){
+                    current_task.taxa.push_back(taxon_name);
+                    current_task.branches.push_back(split_name);
+                }
                 generateTerraceTrees(terrace, part_tree_pairs, list_taxa_to_insert, taxon_to_insert+1,ordered_taxa_to_insert);
+                if(tasks){
+                    current_task.taxa.pop_back();
+                    current_task.branches.pop_back();
+                }
+                if(task_stopped()){
+                    return;
+                }
                 
                 // INFO: IF NEXT TAXON DOES NOT HAVE ALLOWED BRANCHES CURRENT TAXON IS DELETED AND NEXT BRANCH IS EXPLORED.
                 remove_one_taxon(taxon_name,part_tree_pairs);
@@ -1183,7 +1219,12 @@ void Terrace::generateTerraceTrees(Terrace *terrace, vector<Terrace*> &part_tree
                 //    cout<<"... generated tree "<<terrace_trees_num<<"\n";
                 //}
                 //printTree(cout, WT_BR_SCALE | WT_NEWLINE);
-                if(terrace_trees_num == terrace_max_trees){
+                if(task_master){
+                    task_master->shared_intermediated_trees_num--;
+                    if(++task_master->shared_terrace_trees_num >= terrace_max_trees){
+                        write_warning_stop(2);
+                    }
+                } else if(terrace_trees_num == terrace_max_trees){
                     write_warning_stop(2);
                 }
                 remove_one_taxon(taxon_name,part_tree_pairs);
@@ -1203,6 +1244,66 @@ void Terrace::generateTerraceTrees(Terrace *terrace, vector<Terrace*> &part_tree
 
 }
 
+void Terrace::generateTaskTrees(Terrace *terrace, vector<Terrace*> &part_tree_pairs, TerraceTask &task, Terrace *master){
+    
+    // these insertions were already counted by the master, the stopping rules are off
+    task_master = nullptr;
+    intermediate_max_trees = UINT_MAX;
+    seconds_max = -1;
+    
+    // Re-insert the taxa above the split depth on the branches recorded by the master
+    for(int i=0; i<task.taxa.size(); i++){
+        NodeVector node1_vec_branch, node2_vec_branch;
+        getAllowedBranches(task.taxa[i], part_tree_pairs, &node1_vec_branch, &node2_vec_branch);
+        int j;
+        for(j=0; j<node1_vec_branch.size(); j++){
+            if(getBranchSplitName(node1_vec_branch[j],node2_vec_branch[j]) == task.branches[i]){
+                break;
+            }
+        }
+        assert(j < node1_vec_branch.size() && "ERROR: in generateTaskTrees: the branch of the task is not allowed!");
+        extendNewTaxon(task.taxa[i],(TerraceNode*)node1_vec_branch[j],(TerraceNode*)node2_vec_branch[j],part_tree_pairs);
+    }
+    
+    intermediated_trees_num = 0;
+    terrace_trees_num = 0;
+    dead_ends_num = 0;
+    
+    task_master = master;
+    terrace_max_trees = master->terrace_max_trees;
+    intermediate_max_trees = master->intermediate_max_trees;
+    seconds_max = master->seconds_max;
+    
+    if(task.ordered_taxa_to_insert.empty()){
+        generateTerraceTrees(terrace, part_tree_pairs, task.list_taxa_to_insert, task.taxa.size(), nullptr);
+    }else{
+        generateTerraceTrees(terrace, part_tree_pairs, task.list_taxa_to_insert, task.taxa.size(), &task.ordered_taxa_to_insert);
+    }
+}
+
+string Terrace::getBranchSplitName(Node *node1, Node *node2){
+    
+    string side_name[2];
+    NodeVector taxa;
+    for(int k=0; k<2; k++){
+        taxa.clear();
+        if(k==0){
+            getTaxa(taxa, node1, node2);
+        }else{
+            getTaxa(taxa, node2, node1);
+        }
+        vector<string> names;
+        for(const auto &t: taxa){
+            names.push_back(t->name);
+        }
+        sort(names.begin(), names.end());
+        for(const auto &n: names){
+            side_name[k] += n + ",";
+        }
+    }
+    return min(side_name[0], side_name[1]);
+}
+
 void Terrace::remove_one_taxon(string taxon_name, vector<Terrace*> part_tree_pairs){
     
     //cout<<"-----------------------------------"<<"\n"<<"REMOVING TAXON: "<<taxon_name<<"\n"<<"-----------------------------------"<<"\n";
@@ -1671,6 +1772,13 @@ void Terrace::write_summary_generation(){
 
 void Terrace::write_warning_stop(int type){
     
+    if(task_master){
+        // a task of parallel generation: the master reports the stop, once all tasks have returned
+        int no_stop = 0;
+        task_master->task_stop_type.compare_exchange_strong(no_stop, type);
+        return;
+    }
+    
     cout<<"\n"<<"=========================================="<<"\n";
     cout<<"WARNING: stopping condition is active!"<<"\n";
     cout<<"The total number of trees on the stand is NOT yet computed!"<<"\n";
@@ -9,10 +9,24 @@
 #define terrace_hpp
 
 #include <stdio.h>
+#include <atomic>
 #include "terracetree.hpp"
 #include "terracenode.hpp"
 #include "presenceabsencematrix.hpp"
 
+/*
+ *  A subtree of the search for parallel generation of trees from a stand:
+ *  taxa inserted above the split depth, the branches they were inserted on (as taxon bipartitions,
+ *  since the order of allowed branches is not kept by insertions and removals),
+ *  and the taxon lists the generation continues with below that depth.
+ */
+struct TerraceTask{
+    vector<string> taxa;
+    vector<string> branches;
+    vector<string> list_taxa_to_insert;
+    vector<string> ordered_taxa_to_insert;
+};
+
 class Terrace: public TerraceTree
 {
 public:
@@ -99,6 +113,29 @@ public:
     unsigned int intermediate_max_trees;
     int seconds_max;
     
+    /*
+     *  Parallel generation. The master terrace collects tasks (subtrees of the search) at depth task_depth,
+     *  each task is then generated by its own terrace and part_tree_pairs, which point to the master via task_master.
+     */
+    int task_depth{0};
+    vector<TerraceTask> *tasks{nullptr};
+    TerraceTask current_task;
+    Terrace *task_master{nullptr};
+    
+    /*
+     *  Counters and stopping rule shared by all tasks, kept by the master
+     */
+    std::atomic<unsigned int> shared_terrace_trees_num{0};
+    std::atomic<unsigned int> shared_intermediated_trees_num{0};
+    std::atomic<int> task_stop_type{0};
+    
+    /*
+     *  TRUE if a task hit a stopping rule and the generation should unwind
+     */
+    bool task_stopped(){
+        return task_master && task_master->task_stop_type != 0;
+    }
+    
     /*
      *  Print terrace info: a representative tree, induced trees and presence-absence matrix
      */
@@ -175,7 +212,7 @@ public:
      *  Prepare top-low induced partition tree pairs: induced tree from the terrace and a common subtree with the initial tree (to be modified by inserting new taxa). Top level provided by the passed terrace, low level by the current terrace (which is initial terrace).
      */
     
-    void create_Top_Low_Part_Tree_Pairs(vector<Terrace*> &part_tree_pairs, Terrace *terrace);
+    void create_Top_Low_Part_Tree_Pairs(vector<Terrace*> &part_tree_pairs, Terrace *terrace, bool check_compatibility = true);
     
     /*
      *  The main function to generate trees by recursive taxon insertion
@@ -183,6 +220,17 @@ public:
     
     void generateTerraceTrees(Terrace *terrace, vector<Terrace*> &part_tree_pairs, vector<string> &list_taxa_to_insert, int taxon_to_insert = -1,vector<string> *ordered_taxa_to_insert = nullptr);
     
+    /*
+     *  Task of parallel generation: insert the taxa of the task on its branches and generate trees below it.
+     *  Counters and stopping rules are shared with the master terrace, which collected the task.
+     */
+    void generateTaskTrees(Terrace *terrace, vector<Terrace*> &part_tree_pairs, TerraceTask &task, Terrace *master);
+    
+    /*
+     *  Bipartition of taxa defined by a branch, as a string independent of the node ids and of the branch direction
+     */
+    string getBranchSplitName(Node *node1, Node *node2);
+    
     /*
      *  Get next taxon to be inserted - a taxon with the least number of allowed branches
      */
@@ -8,7 +8,7 @@ import sys, os, time, multiprocessing, optparse
 import subprocess, logging, datetime
 
 def parse_config(config_file):
-  singleAln, partitionAln, partOpts, genericOpts = [], [], [], []
+  singleAln, partitionAln, partOpts, genericOpts, alisimCompare, lnlCompare, outCompare = [], [], [], [], [], [], []
   with open(config_file) as f:
     #lines = f.readlines()
     lines = [line.strip() for line in f if line.strip()]
@@ -16,6 +16,9 @@ def parse_config(config_file):
   readPartAln = False
   partOpt = False
   genericOpt = False
+  alisimOpt = False
+  lnlOpt = False
+  outOpt = False
   for line in lines:
     #print line
     if line == 'START_SINGLE_ALN':
@@ -46,11 +49,38 @@ def parse_config(config_file):
     if line == 'END_GENERIC_OPTIONS':
       genericOpt = False
       continue
+    if line == 'START_ALISIM_COMPARE':
+      alisimOpt = True
+      continue
+    if line == 'END_ALISIM_COMPARE':
+      alisimOpt = False
+      continue
+    if line == 'START_LNL_COMPARE':
+      lnlOpt = True
+      continue
+    if line == 'END_LNL_COMPARE':
+      lnlOpt = False
+      continue
+    if line == 'START_OUTPUT_COMPARE':
+      outOpt = True
+      continue
+    if line == 'END_OUTPUT_COMPARE':
+      outOpt = False
+      continue
     if partOpt:
       partOpts.append(line)
     if genericOpt:
       genericOpts.append(line)
-  return (singleAln, partitionAln, genericOpts, partOpts)
+    if alisimOpt:
+      alisimCompare.append([opt.strip() for opt in line.split('|')])
+    if lnlOpt:
+      fields = [opt.strip() for opt in line.split('|')]
+      if len(fields) < 3:
+        fields.append('0.01')
+      lnlCompare.append(fields)
+    if outOpt:
+      outCompare.append([opt.strip() for opt in line.split('|')])
+  return (singleAln, partitionAln, genericOpts, partOpts, alisimCompare, lnlCompare, outCompare)
 
 
 if __name__ == '__main__':
@@ -64,7 +94,7 @@ if __name__ == '__main__':
   if not options.iqtree_bin or not options.config_file:
     parser.print_help()
     exit(0)
-  (singleAln, partitionAln, genericOpts, partOpts) = parse_config(options.config_file)
+  (singleAln, partitionAln, genericOpts, partOpts, alisimCompare, lnlCompare, outCompare) = parse_config(options.config_file)
   testCmds = []
   # Generate test commands for single model
   for aln in singleAln:
@@ -89,6 +119,42 @@ if __name__ == '__main__':
     testCMD = testIDRel + " " + os.path.abspath(options.iqtree_bin) + " -pre " + testIDRel + " " + cmd
     testNr = testNr + 1
     jobs.append(testCMD)
+  # Generate AliSim tests that must output the same alignments with and without an option
+  for (opt, flag) in alisimCompare:
+    testIDRel = os.path.basename(options.iqtree_bin) + "_TEST_" + str(testNr)
+    binary = os.path.abspath(options.iqtree_bin)
+    if options.flags:
+      opt = opt + ' ' + options.flags
+    testCMD = testIDRel + " " + binary + " --alisim " + testIDRel + "_ref -redo " + opt + \
+      " && " + binary + " --alisim " + testIDRel + "_new -redo " + opt + " " + flag + \
+      " && for f in " + testIDRel + "_ref*.phy; do cmp $f `echo $f | sed s/_ref/_new/` || exit 1; done"
+    testNr = testNr + 1
+    jobs.append(testCMD)
+  # Generate tests that must give the same log-likelihood with and without an option
+  for (opt, flag, tol) in lnlCompare:
+    testIDRel = os.path.basename(options.iqtree_bin) + "_TEST_" + str(testNr)
+    binary = os.path.abspath(options.iqtree_bin)
+    if options.flags:
+      opt = opt + ' ' + options.flags
+    testCMD = testIDRel + " " + binary + " -pre " + testIDRel + "_ref -redo " + opt + \
+      " && " + binary + " -pre " + testIDRel + "_new -redo " + opt + " " + flag + \
+      " && awk -v tol=" + tol + " '/^Log-likelihood of the tree:/ {lnl[n++] = $5}" + \
+      " END {d = lnl[0] - lnl[1]; if (d < 0) d = -d;" + \
+      " if (n != 2 || d > tol) {print \"ERROR: log-likelihoods differ: \" lnl[0] \" \" lnl[1]; exit 1}}' " + \
+      testIDRel + "_ref.iqtree " + testIDRel + "_new.iqtree"
+    testNr = testNr + 1
+    jobs.append(testCMD)
+  # Generate tests that must write the same output file with and without an option
+  for (opt, flag, ext) in outCompare:
+    testIDRel = os.path.basename(options.iqtree_bin) + "_TEST_" + str(testNr)
+    binary = os.path.abspath(options.iqtree_bin)
+    if options.flags:
+      opt = opt + ' ' + options.flags
+    testCMD = testIDRel + " " + binary + " -pre " + testIDRel + "_ref -redo " + opt + \
+      " && " + binary + " -pre " + testIDRel + "_new -redo " + opt + " " + flag + \
+      " && cmp " + testIDRel + "_ref." + ext + " " + testIDRel + "_new." + ext
+    testNr = testNr + 1
+    jobs.append(testCMD)
 #  print "\n".join(jobs)
   outfile = open(options.outFile, "wb")
   for job in jobs:
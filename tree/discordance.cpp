@@ -358,6 +358,9 @@ void PhyloTree::computeSubtreeAncestralState(PhyloNeighbor *dad_branch, PhyloNod
     computeLikelihoodBranch(dad_branch, dad);
 
     //double *lh_state = _pattern_lh_cat_state;
+    // initMarginalAncestralState switched to the nonrev kernel, which never stores
+    // partial likelihoods in single precision (--lk-float)
+    ASSERT(!float_lh);
     double *lh_state = dad_branch->partial_lh;
     memset(ptn_ancestral_prob, 0, sizeof(double)*nptn*nstates);
 
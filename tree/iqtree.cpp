@@ -56,6 +56,7 @@ void IQTree::init() {
     estimate_nni_cutoff = false;
     nni_cutoff = -1e6;
     nni_sort = false;
+    nni_workers_ready = false;
     testNNI = false;
 //    print_tree_lh = false;
 //    write_intermediate_trees = 0;
@@ -66,6 +67,7 @@ void IQTree::init() {
     duplication_counter = 0;
     //boot_splits = new SplitGraph;
     pll2iqtree_pattern_index = NULL;
+    ufboot_buffer_lh = NULL;
 
     treels_name = Params::getInstance().out_prefix;
     treels_name += ".treels";
@@ -132,6 +134,8 @@ void IQTree::saveUFBoot(Checkpoint *checkpoint) {
 }
 
 void IQTree::saveCheckpoint() {
+    // buffered trees must be in boot_trees before saving
+    flushUFBootBuffer();
     stop_rule.saveCheckpoint();
     candidateTrees.saveCheckpoint();
     
@@ -440,6 +444,8 @@ IQTree::~IQTree() {
     //delete bonus_values;
     //bonus_values = NULL;
 
+    deleteNNIWorkers();
+
     for (vector<SplitGraph*>::reverse_iterator it2 = boot_splits.rbegin(); it2 != boot_splits.rend(); it2++)
         delete (*it2);
     boot_splits.clear();
@@ -449,6 +455,8 @@ IQTree::~IQTree() {
         aligned_free(boot_samples[0]); // free memory
         boot_samples.clear();
     }
+    if (ufboot_buffer_lh)
+        aligned_free(ufboot_buffer_lh);
 }
 
 extern const char *aa_model_names_rax[];
@@ -2291,6 +2299,7 @@ double IQTree::doTreeSearch() {
 
         searchinfo.curIter = stop_rule.getCurIt();
         // estimate logl_cutoff for bootstrap
+        flushUFBootBuffer();
         if (!boot_orig_logl.empty())
             logl_cutoff = *min_element(boot_orig_logl.begin(), boot_orig_logl.end());
 
@@ -2404,6 +2413,8 @@ double IQTree::doTreeSearch() {
 
     }
 
+    flushUFBootBuffer();
+
     // 2019-06-03: check convergence here to avoid effect of refineBootTrees
     if (boot_splits.size() >= 2 && MPIHelper::getInstance().isMaster()) {
         // check the stopping criterion for ultra-fast bootstrap
@@ -3012,6 +3023,10 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         tabuSplits = initTabuSplits;
     }
 
+    // the tree copies for parallel NNI evaluation are set up once per NNI search
+    if (leafNum > 4 && isParallelNNI(leafNum-3))
+        nni_workers_ready = prepareNNIWorkers(min(num_threads, (int)leafNum-3));
+
     initProgress(MAXSTEPS, "Optimizing NNI", "done", "step");
     double originalScore = curScore;
     for (numSteps = 1; numSteps <= MAXSTEPS; numSteps++) {
@@ -3150,6 +3165,8 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         trackProgress(1);
     }
     doneProgress();
+    // the model may change before the next NNI search
+    nni_workers_ready = false;
 
     if (totalNNIApplied == 0 && verbose_mode >= VB_MED) {
         cout << "NOTE: Input tree is already NNI-optimal" << endl;
@@ -3329,13 +3346,17 @@ void IQTree::pllDestroyUFBootData(){
 
 
 void IQTree::doNNIs(vector<NNIMove> &compatibleNNIs, bool changeBran) {
+    // partial likelihoods of a single tree are cleared once for all NNIs
+    bool batch_clear = !isSuperTree() && compatibleNNIs.size() > 1;
     for (vector<NNIMove>::iterator it = compatibleNNIs.begin(); it != compatibleNNIs.end(); it++) {
-        doNNI(*it);
+        doNNI(*it, !batch_clear);
         if (!params->leastSquareNNI && changeBran) {
             // apply new branch lengths
             changeNNIBrans(*it);
         }
     }
+    if (batch_clear)
+        clearNNIPartialLh(compatibleNNIs);
     // 2015-10-14: has to reset this pointer when read in
     current_it = current_it_back = NULL;
 
@@ -3422,6 +3443,10 @@ void IQTree::setDelete(int _delete) {
 }
 
 void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs) {
+    if (nni_workers_ready && isParallelNNI(nniBranches.size())) {
+        evaluateNNIsParallel(nniBranches, positiveNNIs);
+        return;
+    }
     for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end(); it++) {
         NNIMove nni = getBestNNIForBran((PhyloNode*) it->second.first, (PhyloNode*) it->second.second, NULL);
         if (nni.newloglh > curScore) {
@@ -3436,6 +3461,116 @@ void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs)
     }
 }
 
+bool IQTree::isParallelNNI(size_t num_branches) {
+#ifdef _OPENMP
+    // the tree copies share the model, but not the mixture branch lengths or saved trees for UFBoot
+    return params->parallel_nni && num_threads > 1 && num_branches > 1 && !isSuperTree() && !isMixlen() &&
+        !isTreeMix() && params->lh_mem_save != LM_MEM_SAVE && save_all_trees != 2;
+#else
+    return false;
+#endif
+}
+
+/** collect nodes of the subtree at node by their ID */
+static void getNodesByID(Node *node, Node *dad, vector<PhyloNode*> &nodes) {
+    nodes[node->id] = (PhyloNode*)node;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        getNodesByID((*it)->node, node, nodes);
+}
+
+bool IQTree::prepareNNIWorkers(int num_workers) {
+    // each tree copy has its own partial likelihoods and kernel buffers
+    uint64_t worker_mem = getMemoryRequired() + getBufferPartialLhSize()*sizeof(double);
+    uint64_t total_mem = getMemorySize();
+    if ((num_workers+1)*worker_mem >= total_mem*0.95) {
+        cout << "NOTE: Not enough RAM for " << num_workers << " tree copies of --parallel-nni, evaluating NNIs serially" << endl;
+        params->parallel_nni = false;
+        deleteNNIWorkers();
+        return false;
+    }
+    while (nni_workers.size() < num_workers) {
+        PhyloTree *worker = new PhyloTree;
+        worker->setParams(params);
+        worker->optimize_by_newton = optimize_by_newton;
+        if (!constraintTree.empty())
+            worker->constraintTree.readConstraint(constraintTree);
+        worker->copyTopology(this);
+        worker->setAlignment(aln);
+        nni_workers.push_back(worker);
+    }
+    size_t ptn_size = get_safe_upper_limit(aln->getNPattern()) + get_safe_upper_limit(model_factory->unobserved_ptns.size());
+    // pattern frequencies may differ from the alignment, e.g. for bootstrap
+    computePtnFreq();
+    for (int i = 0; i < num_workers; i++) {
+        PhyloTree *worker = nni_workers[i];
+        worker->setNumThreads(1);
+        worker->setModelFactory(model_factory);
+        worker->setLikelihoodKernel(sse);
+        // buffers are only allocated the first time
+        worker->initializeAllPartialLh();
+        memcpy(worker->ptn_freq, ptn_freq, ptn_size*sizeof(double));
+        worker->ptn_freq_computed = true;
+        // the model is shared, so fill the tip likelihoods before going parallel
+        worker->computeTipPartialLikelihood();
+    }
+    return true;
+}
+
+void IQTree::deleteNNIWorkers() {
+    for (auto worker : nni_workers) {
+        // model is owned by this tree
+        worker->setModelFactory(NULL);
+        delete worker;
+    }
+    nni_workers.clear();
+}
+
+void IQTree::evaluateNNIsParallel(Branches &nniBranches, vector<NNIMove> &positiveNNIs) {
+#ifdef _OPENMP
+    vector<pair<int, int> > branches;
+    for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end(); it++)
+        branches.push_back(make_pair(it->second.first->id, it->second.second->id));
+    int num_workers = min((int)nni_workers.size(), (int)branches.size());
+    // NNIs applied since the last call changed the topology and branch lengths
+    for (int i = 0; i < num_workers; i++) {
+        nni_workers[i]->syncTopology(this);
+        nni_workers[i]->setCurScore(curScore);
+    }
+
+    vector<PhyloNode*> nodes(nodeNum, NULL);
+    getNodesByID(root, NULL, nodes);
+    vector<vector<PhyloNode*> > worker_nodes(num_workers, vector<PhyloNode*>(nodeNum, NULL));
+    for (int i = 0; i < num_workers; i++)
+        getNodesByID(nni_workers[i]->root, NULL, worker_nodes[i]);
+
+    vector<NNIMove> nnis(branches.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+    for (size_t i = 0; i < branches.size(); i++) {
+        int thread_id = omp_get_thread_num();
+        PhyloTree *worker = nni_workers[thread_id];
+        vector<PhyloNode*> &wnodes = worker_nodes[thread_id];
+        NNIMove nni = worker->getBestNNIForBran(wnodes[branches[i].first], wnodes[branches[i].second], NULL);
+        // map the move back onto this tree
+        NNIMove &res = nnis[i];
+        res = nni;
+        res.node1 = nodes[nni.node1->id];
+        res.node2 = nodes[nni.node2->id];
+        res.node1Nei_it = res.node1->findNeighborIt(nodes[(*nni.node1Nei_it)->node->id]);
+        res.node2Nei_it = res.node2->findNeighborIt(nodes[(*nni.node2Nei_it)->node->id]);
+    }
+
+    for (auto it = nnis.begin(); it != nnis.end(); it++)
+        if (it->newloglh > curScore)
+            positiveNNIs.push_back(*it);
+
+    // synchronize tree during optimization step
+    if (MPIHelper::getInstance().isMaster() && candidateset_changed.size() > 0
+        && MPIHelper::getInstance().gotMessage()) {
+        syncCurrentTree();
+    }
+#endif
+}
+
 //Branches IQTree::getReducedListOfNNIBranches(Branches &previousNNIBranches) {
 //    Branches resBranches;
 //    for (Branches::iterator it = previousNNIBranches.begin(); it != previousNNIBranches.end(); it++) {
@@ -3576,63 +3711,29 @@ void IQTree::saveCurrentTree(double cur_logl) {
 #endif
 
 
+#ifdef _OPENMP
+    // seed of the tie-breaking streams, drawn when the tree is saved so that
+    // --ufboot-batch consumes the random stream like scoring the trees one by one
+    int rand_seed = boot_samples.empty() ? 0 : random_int(1000);
+#else
+    int rand_seed = 0;
+#endif
+
     if (boot_samples.empty()) {
         // for runGuidedBootstrap
+    } else if (params->ufboot_batch > 1) {
+        // buffer the tree, RELL scores are computed for the whole batch at once
+        if (!ufboot_buffer_lh)
+            ufboot_buffer_lh = aligned_alloc<BootValType>((size_t)maxnptn * params->ufboot_batch);
+        memcpy(ufboot_buffer_lh + (size_t)maxnptn * ufboot_buffer_logl.size(), pattern_lh, sizeof(BootValType)*maxnptn);
+        ufboot_buffer_logl.push_back(cur_logl);
+        ufboot_buffer_trees.push_back(getUFBootTreeString());
+        ufboot_buffer_seeds.push_back(rand_seed);
+        if (ufboot_buffer_logl.size() >= (size_t)params->ufboot_batch)
+            flushUFBootBuffer();
     } else {
-        // online bootstrap
-//        int ptn;
-//        int updated = 0;
-//        int nsamples = boot_samples.size();
-        ostringstream ostr;
-        string tree_str;
-        setRootNode(params->root);
-        if (params->print_ufboot_trees == 2)
-            printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA + WT_BR_LEN + WT_BR_LEN_SHORT);
-        else
-            printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA);
-        tree_str = ostr.str();
-
-    #ifdef _OPENMP
-        int rand_seed = random_int(1000);
-        #pragma omp parallel
-        {
-        int *rstream;
-        init_random(rand_seed + omp_get_thread_num(), false, &rstream);
-        #pragma omp for
-    #else
-        int *rstream = randstream;
-    #endif
-        for (int sample = sample_start; sample < sample_end; sample++) {
-            double rell = 0.0;
-
-            {
-                // SSE optimized version of the above loop
-                BootValType *boot_sample = boot_samples[sample];
-
-                BootValType res = (this->*dotProduct)(pattern_lh, boot_sample, nptn);
-
-                rell = res;
-            }
-
-            bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
-            if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
-                better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
-            }
-            if (better) {
-                if (rell <= boot_logl[sample] + params->ufboot_epsilon) {
-                    boot_counts[sample]++;
-                } else {
-                    boot_counts[sample] = 1;
-                }
-                boot_logl[sample] = max(boot_logl[sample], rell);
-                boot_orig_logl[sample] = cur_logl;
-                boot_trees[sample] = tree_str;
-            }
-        }
-    #ifdef _OPENMP
-        finish_random(rstream);
-        }
-    #endif
+        // online bootstrap, tree string is only printed if some sample is updated
+        updateUFBootTrees(pattern_lh, 1, maxnptn, &cur_logl, NULL, &rand_seed);
     }
     if (Params::getInstance().print_tree_lh) {
         out_treelh << cur_logl;
@@ -3665,6 +3766,105 @@ void IQTree::saveCurrentTree(double cur_logl) {
 
 }
 
+string IQTree::getUFBootTreeString() {
+    ostringstream ostr;
+    setRootNode(params->root);
+    if (params->print_ufboot_trees == 2)
+        printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA + WT_BR_LEN + WT_BR_LEN_SHORT);
+    else
+        printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA);
+    return ostr.str();
+}
+
+void IQTree::updateUFBootTrees(BootValType *pattern_lh, int ntrees, size_t stride, double *cur_logl, string *tree_strs, int *rand_seeds) {
+    // samples per task of the RELL kernel
+    const int SAMPLE_BLOCK = 64;
+    int nptn = getAlnNPattern();
+    int nsamples = sample_end - sample_start;
+    double *rell = new double[(size_t)nsamples * ntrees];
+    // index of the last tree that updated each sample, -1 if none
+    int *winner = new int[nsamples];
+
+#ifdef _OPENMP
+    #pragma omp parallel
+    {
+    #pragma omp for schedule(static)
+#endif
+    for (int block = 0; block < nsamples; block += SAMPLE_BLOCK) {
+        int block_size = min(SAMPLE_BLOCK, nsamples - block);
+        (this->*rellProduct)(pattern_lh, ntrees, stride, &boot_samples[sample_start + block], block_size, nptn, rell + (size_t)block * ntrees);
+        for (int i = 0; i < block_size; i++)
+            winner[block + i] = -1;
+    }
+    // trees in the order they were saved, each with the tie-breaking stream it would get if saved one by one
+    for (int t = 0; t < ntrees; t++) {
+#ifdef _OPENMP
+        int *rstream;
+        init_random(rand_seeds[t] + omp_get_thread_num(), false, &rstream);
+        #pragma omp for schedule(static)
+#else
+        int *rstream = randstream;
+#endif
+        for (int block = 0; block < nsamples; block += SAMPLE_BLOCK) {
+            int block_size = min(SAMPLE_BLOCK, nsamples - block);
+            for (int i = 0; i < block_size; i++) {
+                int sample = sample_start + block + i;
+                double tree_rell = rell[(size_t)(block + i) * ntrees + t];
+                bool better = tree_rell > boot_logl[sample] + params->ufboot_epsilon;
+                if (!better && tree_rell > boot_logl[sample] - params->ufboot_epsilon) {
+                    better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
+                }
+                if (better) {
+                    if (tree_rell <= boot_logl[sample] + params->ufboot_epsilon) {
+                        boot_counts[sample]++;
+                    } else {
+                        boot_counts[sample] = 1;
+                    }
+                    boot_logl[sample] = max(boot_logl[sample], tree_rell);
+                    boot_orig_logl[sample] = cur_logl[t];
+                    winner[block + i] = t;
+                }
+            }
+        }
+#ifdef _OPENMP
+        finish_random(rstream);
+#endif
+    }
+#ifdef _OPENMP
+    }
+#endif
+
+    string tree_str;
+    for (int i = 0; i < nsamples; i++) {
+        if (winner[i] < 0)
+            continue;
+        if (tree_strs) {
+            boot_trees[sample_start + i] = tree_strs[winner[i]];
+        } else {
+            if (tree_str.empty())
+                tree_str = getUFBootTreeString();
+            boot_trees[sample_start + i] = tree_str;
+        }
+    }
+    delete [] winner;
+    delete [] rell;
+}
+
+void IQTree::flushUFBootBuffer() {
+    if (ufboot_buffer_logl.empty())
+        return;
+    int nptn = getAlnNPattern();
+#ifdef BOOT_VAL_FLOAT
+    size_t maxnptn = get_safe_upper_limit_float(nptn);
+#else
+    size_t maxnptn = get_safe_upper_limit(nptn);
+#endif
+    updateUFBootTrees(ufboot_buffer_lh, ufboot_buffer_logl.size(), maxnptn, &ufboot_buffer_logl[0], &ufboot_buffer_trees[0], &ufboot_buffer_seeds[0]);
+    ufboot_buffer_logl.clear();
+    ufboot_buffer_trees.clear();
+    ufboot_buffer_seeds.clear();
+}
+
 void IQTree::saveNNITrees(PhyloNode *node, PhyloNode *dad) {
     if (!node) {
         node = (PhyloNode*) root;
@@ -3782,6 +3982,7 @@ void IQTree::summarizeBootstrap(Params &params, MTreeSet &trees) {
 }
 
 void IQTree::writeUFBootTrees(Params &params) {
+    flushUFBootBuffer();
     MTreeSet trees;
 //    IntVector tree_weights;
     int i, j;
@@ -3812,6 +4013,7 @@ void IQTree::writeUFBootTrees(Params &params) {
 }
 
 void IQTree::summarizeBootstrap(Params &params) {
+    flushUFBootBuffer();
     setRootNode(params.root);
     MTreeSet trees;
     trees.init(boot_trees, rooted);
@@ -3819,6 +4021,7 @@ void IQTree::summarizeBootstrap(Params &params) {
 }
 
 void IQTree::summarizeBootstrap(SplitGraph &sg) {
+    flushUFBootBuffer();
     MTreeSet trees;
     //SplitGraph sg;
     trees.init(boot_trees, rooted);
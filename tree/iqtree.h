@@ -449,6 +449,30 @@ public:
      */
     void evaluateNNIs(Branches &nniBranches, vector<NNIMove> &outNNIMoves);
 
+    /**
+     * @brief Evaluate NNIs of different branches concurrently (--parallel-nni):
+     * each thread works on its own copy of the tree with single-threaded kernels
+     *
+     * @param nniBranches [IN] branches the branches on which NNIs will be evaluated
+     * @return list positive NNIs, in the order of nniBranches
+     */
+    void evaluateNNIsParallel(Branches &nniBranches, vector<NNIMove> &outNNIMoves);
+
+    /**
+     * @return TRUE if evaluateNNIsParallel can be used for the given number of branches
+     */
+    bool isParallelNNI(size_t num_branches);
+
+    /**
+     * set up num_workers trees in nni_workers for one NNI search, sharing the alignment
+     * and model of this tree; their topology is synchronized by evaluateNNIsParallel
+     * @return FALSE if their partial likelihoods do not fit into RAM
+     */
+    bool prepareNNIWorkers(int num_workers);
+
+    /** free nni_workers */
+    void deleteNNIWorkers();
+
     double optimizeNNIBranches(Branches &nniBranches);
 
     /**
@@ -795,6 +819,14 @@ public:
     /** corresponding log-likelihood on original alignment */
     DoubleVector boot_orig_logl;
 
+    /** pattern log-likelihoods of candidate trees not yet scored on the bootstrap samples, for --ufboot-batch */
+    BootValType *ufboot_buffer_lh;
+
+    /** log-likelihoods, tree strings and tie-breaking seeds of the buffered candidate trees */
+    DoubleVector ufboot_buffer_logl;
+    StrVector ufboot_buffer_trees;
+    IntVector ufboot_buffer_seeds;
+
     /** Set of splits occurring in bootstrap trees */
     vector<SplitGraph*> boot_splits;
 
@@ -854,6 +886,12 @@ protected:
     bool testNNI;
 
     ofstream outNNI;
+
+    /** tree copies, one per thread, for evaluateNNIsParallel */
+    vector<PhyloTree*> nni_workers;
+
+    /** TRUE if nni_workers are set up for the current NNI search */
+    bool nni_workers_ready;
 protected:
 
     //bool print_tree_lh;
@@ -867,6 +905,23 @@ protected:
 
     virtual void saveCurrentTree(double logl); // save current tree
 
+    /**
+        update UFBoot trees of all samples with the RELL scores of one or more candidate trees
+        @param pattern_lh ntrees rows of pattern log-likelihoods, rows are stride apart
+        @param ntrees number of candidate trees
+        @param stride distance between two rows of pattern_lh
+        @param cur_logl log-likelihoods of the candidate trees on the original alignment
+        @param tree_strs tree strings of the candidate trees, NULL to print the current tree if needed
+        @param rand_seeds seeds of the tie-breaking random streams of the candidate trees (OpenMP only)
+    */
+    void updateUFBootTrees(BootValType *pattern_lh, int ntrees, size_t stride, double *cur_logl, string *tree_strs, int *rand_seeds);
+
+    /** score the candidate trees buffered by saveCurrentTree for --ufboot-batch */
+    void flushUFBootBuffer();
+
+    /** @return tree string of the current tree as stored in boot_trees */
+    string getUFBootTreeString();
+
 
     void saveNNITrees(PhyloNode *node = NULL, PhyloNode *dad = NULL);
 
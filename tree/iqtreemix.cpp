@@ -62,6 +62,11 @@ IQTreeMix::IQTreeMix() : IQTree() {
 IQTreeMix::IQTreeMix(Params &params, Alignment *aln, vector<IQTree*> &trees) : IQTree(aln) {
     size_t i;
 
+    if (params.lk_float) {
+        outWarning("Single-precision partial likelihoods (--lk-float) not supported for tree mixtures");
+        params.lk_float = false;
+    }
+
     clear();
     weights.clear();
     weight_logs.clear();
@@ -598,6 +598,7 @@ string IQTreeMixHmm::optimizeModelParamMAST(bool printInfo, double logl_epsilon)
 void IQTreeMixHmm::setNumThreads(int num_threads) {
 
     PhyloTree::setNumThreads(num_threads);
+    hmm_num_threads = num_threads;
 
     for (size_t i = 0; i < size(); i++)
         at(i)->setNumThreads(num_threads);
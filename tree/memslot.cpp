@@ -25,13 +25,37 @@
 const int MEM_LOCKED = 1;
 const int MEM_SPECIAL = 2;
 
+MemSlotVector::MemSlotVector() {
+    free_count = 0;
+    inflation = 0.0;
+    leaf_cost = 1.0;
+    lh_size = scale_size = 0;
+    extra_warned = false;
+}
+
+MemSlotVector::~MemSlotVector() {
+    freeExtraSlots();
+}
+
+void MemSlotVector::freeExtraSlots() {
+    for (auto lh : extra_partial_lh)
+        aligned_free(lh);
+    for (auto scale : extra_scale_num)
+        aligned_free(scale);
+    extra_partial_lh.clear();
+    extra_scale_num.clear();
+}
+
 void MemSlotVector::init(PhyloTree *tree, int num_slot) {
     if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
         return;
+    freeExtraSlots();
+    clear();
     reserve(num_slot+2);
     resize(num_slot);
-    size_t lh_size = tree->getPartialLhSize();
-    size_t scale_size = tree->getScaleNumSize();
+    lh_size = tree->getPartialLhSize();
+    scale_size = tree->getScaleNumSize();
+    leaf_cost = tree->aln->getNPattern();
     reset();
     for (iterator it = begin(); it != end(); it++) {
         it->partial_lh = tree->central_partial_lh + lh_size*(it-begin());
@@ -45,11 +69,91 @@ void MemSlotVector::reset() {
     for (iterator it = begin(); it != end(); it++) {
         it->status = 0;
         it->nei = NULL;
+        it->priority = 0.0;
     }
     nei_id_map.clear();
     free_count = 0;
+    inflation = 0.0;
 }
 
+void MemSlotVector::touch(iterator it) {
+    // size may be unknown (0) after clearing; a subtree has at least 2 leaves
+    it->priority = inflation + max(it->nei->size, 2) * leaf_cost;
+}
+
+MemSlotVector::iterator MemSlotVector::addExtraSlot() {
+    if (!extra_warned)
+        outWarning("Too low -mem for the current traversal, partial likelihood vectors are allocated beyond it");
+    extra_warned = true;
+    MemSlot ms;
+    ms.status = 0;
+    ms.nei = NULL;
+    ms.saved_nei = NULL;
+    ms.priority = 0.0;
+    ms.partial_lh = aligned_alloc<double>(lh_size);
+    ms.scale_num = aligned_alloc<UBYTE>(scale_size);
+    extra_partial_lh.push_back(ms.partial_lh);
+    extra_scale_num.push_back(ms.scale_num);
+    // special slots behind free_count move up by one
+    for (auto nei_id = nei_id_map.begin(); nei_id != nei_id_map.end(); nei_id++)
+        if (nei_id->second >= free_count)
+            nei_id->second++;
+    iterator it = insert(begin() + free_count, ms);
+    free_count++;
+    return it;
+}
+
+void MemSlotVector::releaseExtraSlots() {
+    if (extra_partial_lh.empty())
+        return;
+    // neighbors of released slots are treated as evicted from the cheapest
+    // slot within the budget, which update() takes back when they are recomputed
+    double min_priority = DBL_MAX;
+    iterator target = end();
+    for (iterator it = begin(); it != end(); it++)
+        if ((it->status & (MEM_LOCKED | MEM_SPECIAL)) == 0 && min_priority > it->priority &&
+            find(extra_partial_lh.begin(), extra_partial_lh.end(), it->partial_lh) == extra_partial_lh.end()) {
+            target = it;
+            min_priority = it->priority;
+        }
+    if (target == end())
+        return;
+    // compact the slots, recording where each kept one moves to
+    vector<int> new_id(size(), -1);
+    double *target_lh = target->partial_lh;
+    UBYTE *target_scale = target->scale_num;
+    int target_id = target-begin();
+    iterator kept = begin();
+    int num_released = 0;
+    for (iterator it = begin(); it != end(); it++) {
+        auto extra = find(extra_partial_lh.begin(), extra_partial_lh.end(), it->partial_lh);
+        if (extra == extra_partial_lh.end() || (it->status & MEM_LOCKED)) {
+            new_id[it-begin()] = kept-begin();
+            *kept++ = *it;
+            continue;
+        }
+        aligned_free(it->partial_lh);
+        aligned_free(it->scale_num);
+        extra_scale_num.erase(extra_scale_num.begin() + (extra-extra_partial_lh.begin()));
+        extra_partial_lh.erase(extra);
+        if (it-begin() < free_count)
+            num_released++;
+    }
+    erase(kept, end());
+    free_count -= num_released;
+    target_id = new_id[target_id];
+    for (auto nei_id = nei_id_map.begin(); nei_id != nei_id_map.end(); nei_id++) {
+        int id = new_id[nei_id->second];
+        if (id >= 0) {
+            nei_id->second = id;
+            continue;
+        }
+        nei_id->first->clearPartialLh();
+        nei_id->first->partial_lh = target_lh;
+        nei_id->first->scale_num = target_scale;
+        nei_id->second = target_id;
+    }
+}
 
 MemSlotVector::iterator MemSlotVector::findNei(PhyloNeighbor *nei) {
     auto it = nei_id_map.find(nei);
@@ -99,6 +203,8 @@ bool MemSlotVector::lock(PhyloNeighbor *nei) {
         return false;
     ASSERT((id->status & MEM_LOCKED) == 0);
     id->status |= MEM_LOCKED;
+    // cache hit
+    touch(id);
     return true;
 }
 
@@ -139,32 +245,38 @@ int MemSlotVector::allocate(PhyloNeighbor *nei) {
         iterator it = begin() + free_count;
         ASSERT(it->nei == NULL);
         addNei(nei, it);
+        touch(it);
         free_count++;
         return it-begin();
     }
 
-    int min_size = INT_MAX;
+    double min_priority = DBL_MAX;
     iterator best = end();
 
-
-    // no free slot found, find an unlocked slot with minimal size
+    // no free slot found, find the unlocked slot that is cheapest to recompute
     for (iterator it = begin(); it != end(); it++)
-        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_size > it->nei->size) {
+        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_priority > it->priority) {
             best = it;
-            min_size = it->nei->size;
-            // 2 is the minimum size
-            if (min_size == 2)
-                break;
+            min_priority = it->priority;
         }
 
-    if (best == end())
-        return -1;
+    if (best == end()) {
+        // all slots are locked by the current traversal
+        best = addExtraSlot();
+        addNei(nei, best);
+        touch(best);
+        return best-begin();
+    }
+
+    // age the remaining slots
+    inflation = min_priority;
 
     // clear mem assigned to it->nei
     best->nei->clearPartialLh();
 
     // assign mem to nei
     addNei(nei, best);
+    touch(best);
     return best-begin();
 
 }
@@ -183,6 +295,7 @@ void MemSlotVector::update(PhyloNeighbor *nei) {
         // assign mem to nei
         addNei(nei, it);
     }
+    touch(it);
 }
 
 /*
@@ -34,16 +34,27 @@ struct MemSlot {
     PhyloNeighbor *nei; // neighbor assigned to this slot
     double *partial_lh; // partial_lh assigned to this slot
     UBYTE *scale_num; // scale_num assigned to this slot
+    double priority; // eviction priority: aging value at last use + recomputation cost
 
     PhyloNeighbor *saved_nei;
 };
 
 /**
-    all memory slots, used for memory saving technique
+    all memory slots, used for memory saving technique.
+    Works as a cache of partial likelihood vectors within the -mem budget:
+    when full, the unlocked vector that is cheapest to recompute is evicted
+    (GreedyDual: cost is subtree size times number of patterns, aged by the
+    priority of the last eviction) and recomputed on demand later.
+    If a traversal locks all slots, extra slots are added beyond the budget;
+    they are released before the next traversal and their vectors recomputed.
 */
 class MemSlotVector : public vector<MemSlot> {
 public:
 
+    MemSlotVector();
+
+    ~MemSlotVector();
+
     /** initialize with a specified number of slots */
     void init(PhyloTree *tree, int num_slot);
 
@@ -87,6 +98,12 @@ public:
     /** erase special neihbor e.g. for NNI */
     void eraseSpecialNei();
 
+    /**
+        free the slots added beyond the -mem budget that are no longer locked,
+        the neighbors assigned to them have to be recomputed
+    */
+    void releaseExtraSlots();
+
     /** replace a neighbor, used for NNI */
     void replace(PhyloNeighbor *new_nei, PhyloNeighbor *old_nei);
 
@@ -105,6 +122,31 @@ protected:
     /** counter of free slot ID */
     int free_count;
 
+    /** mark slot as just used, updating its eviction priority */
+    void touch(iterator it);
+
+    /** insert a slot with its own memory beyond the -mem budget at free_count */
+    iterator addExtraSlot();
+
+    /** free the memory of slots added by addExtraSlot */
+    void freeExtraSlots();
+
+    /** priority of the last evicted slot, added to the cost of newly used slots */
+    double inflation;
+
+    /** recomputation cost per leaf of a subtree (number of patterns) */
+    double leaf_cost;
+
+    /** size of partial_lh and scale_num of one slot */
+    size_t lh_size, scale_size;
+
+    /** true once the user was warned about slots beyond the budget */
+    bool extra_warned;
+
+    /** memory of slots added beyond the budget */
+    vector<double*> extra_partial_lh;
+    vector<UBYTE*> extra_scale_num;
+
 };
 
 
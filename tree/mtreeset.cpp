@@ -18,6 +18,7 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 #include "mtreeset.h"
+#include "splittable.h"
 #include "alignment/alignment.h"
 #include "utils/gzstream.h"
 
@@ -553,6 +554,11 @@ void MTreeSet::computeRFDist(double *rfdist, int mode, double weight_threshold)
     }
 	cout << "Computing Robinson-Foulds distance..." << endl;
 
+	if (Params::getInstance().rf_engine != RF_ENGINE_SPLIT_MAP) {
+		computeRFDistParallel(rfdist, mode, weight_threshold, Params::getInstance().rf_engine);
+		return;
+	}
+
 	vector<string> taxname(front()->leafNum);
 	vector<SplitIntMap*> hs_vec;
 	vector<SplitGraph*> sg_vec;
@@ -607,6 +613,77 @@ void MTreeSet::computeRFDist(double *rfdist, int mode, double weight_threshold)
 }
 
 
+void MTreeSet::computeRFDistParallel(double *rfdist, int mode, double weight_threshold, int engine) {
+	int ntrees = size();
+	SplitTable table;
+	vector<CompactTree> compact;
+	if (engine == RF_ENGINE_SPLIT_TABLE) {
+		table.build(*this, weight_threshold);
+		if (verbose_mode >= VB_MED)
+			cout << table.getNSplits() << " distinct non-trivial splits in " << ntrees << " trees" << endl;
+	} else {
+		compact.resize(ntrees);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int id = 0; id < ntrees; id++)
+			compact[id].build(at(id), weight_threshold);
+	}
+
+	if (mode == RF_ADJACENT_PAIR) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int id = 0; id < ntrees-1; id++) {
+			if (engine == RF_ENGINE_SPLIT_TABLE)
+				rfdist[id] = table.computeRFDist(id, id+1);
+			else {
+				DayTable day;
+				day.build(compact[id]);
+				rfdist[id] = day.computeRFDist(compact[id+1]);
+			}
+		}
+		return;
+	}
+
+	// all pairs: the upper triangle is cut into square tiles of trees,
+	// so that one thread reuses the same rows (and Day table) within a tile
+	const int tile_size = 64;
+	int ntiles = (ntrees + tile_size - 1) / tile_size;
+	vector<pair<int,int> > tiles;
+	for (int tile1 = 0; tile1 < ntiles; tile1++)
+		for (int tile2 = tile1; tile2 < ntiles; tile2++)
+			tiles.push_back(make_pair(tile1, tile2));
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		DayTable day;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+		for (int t = 0; t < tiles.size(); t++) {
+			int start1 = tiles[t].first * tile_size;
+			int stop1 = min(ntrees, start1 + tile_size);
+			int start2 = tiles[t].second * tile_size;
+			int stop2 = min(ntrees, start2 + tile_size);
+			for (int id = start1; id < stop1; id++) {
+				int first2 = max(start2, id+1);
+				if (first2 >= stop2)
+					continue;
+				if (engine == RF_ENGINE_DAY)
+					day.build(compact[id]);
+				for (int id2 = first2; id2 < stop2; id2++) {
+					int rf_val = (engine == RF_ENGINE_SPLIT_TABLE) ?
+						table.computeRFDist(id, id2) : day.computeRFDist(compact[id2]);
+					rfdist[id*ntrees + id2] = rfdist[id2*ntrees + id] = rf_val;
+				}
+			}
+		}
+	}
+}
+
 void MTreeSet::computeRFDist(double *rfdist, MTreeSet *treeset2, bool k_by_k,
 	const char *info_file, const char *tree_file, double *incomp_splits)
 {
@@ -164,6 +164,16 @@ public:
 	*/
 	void computeRFDist(double *rfdist, int mode = RF_ALL_PAIR, double weight_threshold = -1000);
 
+	/**
+		compute the Robinson-Foulds distance between trees in parallel,
+		with the split table or Day's algorithm (see Params::rf_engine)
+		@param rfdist (OUT) RF distance
+		@param mode RF_ALL_PAIR or RF_ADJACENT_PAIR
+		@param weight_threshold minimum weight cutoff
+		@param engine RF_ENGINE_SPLIT_TABLE or RF_ENGINE_DAY
+	*/
+	void computeRFDistParallel(double *rfdist, int mode, double weight_threshold, int engine);
+
 	/**
 		compute the Robinson-Foulds distance between trees
 		@param[out] rfdist output RF distance
@@ -6,6 +6,16 @@
 //
 
 #include "phylohmm.h"
+#include <cfloat>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// minimum number of sites per thread for the parallel forward/backward algorithm
+#define HMM_MIN_SITES_PER_THREAD 1000
+
+// tolerance for the rows of a chunk to differ by a constant from the correct rows
+#define HMM_CHUNK_EPS 1e-10
 
 PhyloHmm::PhyloHmm() {
     nsite = ncat = 0;
@@ -19,12 +29,14 @@ PhyloHmm::PhyloHmm() {
     fwd_array = NULL;
     marginal_prob = NULL;
     marginal_tran = NULL;
+    hmm_num_threads = 1;
 }
 
 PhyloHmm::PhyloHmm(int n_site, int n_cat) {
     
     nsite = n_site;
     ncat = n_cat;
+    hmm_num_threads = 1;
     
     // allocate memory for the arrays
     size_t prob_size = get_safe_upper_limit(ncat);
@@ -74,6 +86,8 @@ PhyloHmm::~PhyloHmm() {
 // prerequisite: array site_like_cat has been updated (i.e. computeLogLikelihoodSiteTree() has been invoked)
 // note: site_like_cat[i * ntree + j] : log-likelihood of site nsite-i-1 and tree j
 double PhyloHmm::computeBackLike(bool showInterRst) {
+    if (!showInterRst && useParallelHmm())
+        return computeBackLikeArray();
     int showlines = 5;
     size_t pre_k = 0;
     size_t k;
@@ -182,6 +196,11 @@ double PhyloHmm::optimizeProbEM() {
     double* work;
     double* site_lh_arr;
     double* transit_arr;
+    if (useParallelHmm()) {
+        computeBackLikeArray();
+        pre_work = bwd_array;
+        pre_k = 1;
+    } else {
     site_lh_arr = site_like_cat;
     memcpy(work_arr, site_lh_arr, sizeof(double) * ncat);
     pre_work = work_arr;
@@ -197,6 +216,7 @@ double PhyloHmm::optimizeProbEM() {
         pre_k = k;
         pre_work = work;
     }
+    }
     
     k = pre_k ^ 1;
     work = work_arr + k * ncat;
@@ -395,6 +415,11 @@ double PhyloHmm::computeBackLikeArray() {
     site_lh_arr = site_like_cat;
     work = bwd_array + (nsite - 1) * ncat;
     memcpy(work, site_lh_arr, sizeof(double) * ncat);
+    if (useParallelHmm()) {
+        // row t is bwd_array[nsite-1-t], computed with site t and the transition matrix for site nsite-t
+        computeLikeArrayParallel(work, -ncat, site_like_cat, ncat, nsite, -1);
+        return logDotProd(prob_log, bwd_array, ncat);
+    }
     for (int i = nsite - 1; i >= 1; i--) {
         pre_work = work;
         work = bwd_array + (i - 1) * ncat;
@@ -422,6 +447,11 @@ double PhyloHmm::computeFwdLikeArray() {
     site_lh_arr = site_like_cat + (nsite-1) * ncat;
     work = fwd_array;
     memcpy(work, prob_log, sizeof(double) * ncat);
+    if (useParallelHmm()) {
+        // row t is fwd_array[t], computed with site nsite-t and the transition matrix for site t
+        computeLikeArrayParallel(work, ncat, site_like_cat + nsite * ncat, -ncat, 0, 1);
+        return logDotProd(site_like_cat, fwd_array + (nsite - 1) * ncat, ncat);
+    }
     for (int i = 1; i < nsite; i++) {
         pre_work = work;
         work += ncat;
@@ -468,6 +498,29 @@ void PhyloHmm::computeMarginalProb(ostream* out) {
         }
         *out << endl;
     }
+    if (useParallelHmm()) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(hmm_num_threads)
+#endif
+        for (int i=0; i<nsite; i++) {
+            double* f_arr = fwd_array + (size_t)i * ncat;
+            double* b_arr = bwd_array + (size_t)i * ncat;
+            double* m_arr = marginal_prob + (size_t)i * ncat;
+            double site_score = logDotProd(f_arr, b_arr, ncat);
+            for (int j=0; j<ncat; j++)
+                m_arr[j] = exp(f_arr[j]+b_arr[j]-site_score);
+        }
+        if (out != NULL) {
+            for (i=0; i<nsite; i++) {
+                *out << i+1;
+                for (int j=0; j<ncat; j++)
+                    *out << "\t" << mprob[j];
+                *out << endl;
+                mprob += ncat;
+            }
+        }
+        return;
+    }
     for (i=0; i<nsite; i++) {
         if (out != NULL)
             *out << i+1;
@@ -501,6 +554,42 @@ void PhyloHmm::computeMarginalTransitProb() {
     computeBackLikeArray();
     computeFwdLikeArray();
 
+    if (useParallelHmm()) {
+#ifdef _OPENMP
+#pragma omp parallel num_threads(hmm_num_threads)
+#endif
+        {
+            double* t1_arr = new double[sq_ncat];
+            double* t2_arr = new double[sq_ncat];
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (int i=1; i<=nsite-1; i++) {
+                double* f_arr = fwd_array + (size_t)(i-1) * ncat;
+                double* b_arr = bwd_array + (size_t)i * ncat;
+                double* c_arr = site_like_cat + (size_t)(nsite-i) * ncat;
+                double* m_arr = marginal_tran + (size_t)(i-1) * sq_ncat;
+                double* tr_arr = modelHmm->getTransitLog(i);
+                int l = 0;
+                for (int j1=0; j1<ncat; j1++) {
+                    for (int j2=0; j2<ncat; j2++) {
+                        t1_arr[l] = f_arr[j1] + c_arr[j1];
+                        t2_arr[l] = b_arr[j2] + tr_arr[l];
+                        l++;
+                    }
+                }
+                double tran_score = logDotProd(t1_arr, t2_arr, sq_ncat);
+                for (l=0; l<sq_ncat; l++)
+                    m_arr[l] = exp(t1_arr[l] + t2_arr[l] - tran_score);
+            }
+            delete[] t1_arr;
+            delete[] t2_arr;
+        }
+        delete[] t1;
+        delete[] t2;
+        return;
+    }
+
     // cout << "Marginal transition probabilities:" << endl;
     for (int i=1; i<=nsite-1; i++) {
         // cout << "(" << i << "," << i+1 << ")";
@@ -558,3 +647,84 @@ void PhyloHmm::showTransiteLog() {
 }
 
 
+
+bool PhyloHmm::useParallelHmm() {
+    return Params::getInstance().parallel_hmm && hmm_num_threads > 1 &&
+        nsite >= HMM_MIN_SITES_PER_THREAD * hmm_num_threads;
+}
+
+void PhyloHmm::computeLikeArrayParallel(double* row0, int row_step, double* site_lh0, int site_step,
+                                        int transit_first, int transit_step) {
+    int nchunk = hmm_num_threads;
+    vector<int> chunk_start(nchunk + 1);
+    vector<int> chunk_conv(nchunk);
+    vector<double> chunk_offset(nchunk, 0.0);
+    for (int c = 0; c <= nchunk; c++)
+        chunk_start[c] = 1 + (int)((int64_t)(nsite - 1) * c / nchunk);
+
+    // first pass: chunk 0 from row 0, the other chunks from a flat start
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(hmm_num_threads)
+#endif
+    for (int c = 0; c < nchunk; c++) {
+        double* flat = new double[ncat];
+        for (int j = 0; j < ncat; j++)
+            flat[j] = 0.0;
+        double* pre_row = (c == 0) ? row0 : flat;
+        for (int t = chunk_start[c]; t < chunk_start[c+1]; t++) {
+            double* row = row0 + (int64_t)t * row_step;
+            logTransitStep(modelHmm->getTransitLog(transit_first + t * transit_step), pre_row,
+                           site_lh0 + (int64_t)t * site_step, row, ncat);
+            pre_row = row;
+        }
+        delete[] flat;
+    }
+    chunk_conv[0] = chunk_start[1];
+
+    // reconcile the chunks in order
+    double* pre_row = new double[ncat];
+    double* new_row = new double[ncat];
+    for (int c = 1; c < nchunk; c++) {
+        double* last_row = row0 + (int64_t)(chunk_start[c] - 1) * row_step;
+        // the last row of the previous chunk is shifted unless it was recomputed
+        double pre_offset = (chunk_conv[c-1] < chunk_start[c]) ? chunk_offset[c-1] : 0.0;
+        for (int j = 0; j < ncat; j++)
+            pre_row[j] = last_row[j] + pre_offset;
+        chunk_conv[c] = chunk_start[c+1];
+        for (int t = chunk_start[c]; t < chunk_start[c+1]; t++) {
+            double* row = row0 + (int64_t)t * row_step;
+            logTransitStep(modelHmm->getTransitLog(transit_first + t * transit_step), pre_row,
+                           site_lh0 + (int64_t)t * site_step, new_row, ncat);
+            double min_diff = new_row[0] - row[0];
+            double max_diff = min_diff;
+            for (int j = 1; j < ncat; j++) {
+                double diff = new_row[j] - row[j];
+                min_diff = min(min_diff, diff);
+                max_diff = max(max_diff, diff);
+            }
+            memcpy(row, new_row, sizeof(double) * ncat);
+            memcpy(pre_row, new_row, sizeof(double) * ncat);
+            // the rows grow with the number of sites, so the tolerance is bounded by their rounding error
+            if (max_diff - min_diff < max(HMM_CHUNK_EPS, 64.0 * DBL_EPSILON * fabs(new_row[0]))) {
+                // the rest of the chunk only differs by a constant
+                chunk_offset[c] = 0.5 * (min_diff + max_diff);
+                chunk_conv[c] = t + 1;
+                break;
+            }
+        }
+    }
+    delete[] pre_row;
+    delete[] new_row;
+
+    // shift the rest of the chunks
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(hmm_num_threads)
+#endif
+    for (int c = 1; c < nchunk; c++) {
+        for (int t = chunk_conv[c]; t < chunk_start[c+1]; t++) {
+            double* row = row0 + (int64_t)t * row_step;
+            for (int j = 0; j < ncat; j++)
+                row[j] += chunk_offset[c];
+        }
+    }
+}
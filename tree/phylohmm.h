@@ -18,37 +18,42 @@ using namespace std;
 // compute the log of dotproduct of the logorithm arrays
 inline double logDotProd(double* ln_x, double* ln_y, int n) {
     double max;
-    double max_i;
+    size_t max_i;
     size_t i;
-    double* w;
+    double w;
     double ans;
     
-    w = new double[n];
-    for (i = 0; i < n; i++) {
-        w[i] = ln_x[i] + ln_y[i];
-    }
     // find the max
-    max = w[0];
+    max = ln_x[0] + ln_y[0];
     max_i = 0;
     for (i = 1; i < n; i++) {
-        if (max < w[i]) {
-            max = w[i];
+        w = ln_x[i] + ln_y[i];
+        if (max < w) {
+            max = w;
             max_i = i;
         }
     }
     // compute the dotproduct
     ans = 0.0;
     for (i = 0; i < max_i; i++) {
-        ans += exp(w[i] - max);
+        ans += exp(ln_x[i] + ln_y[i] - max);
     }
     ans += 1.0;
     for (i = max_i+1; i < n; i++) {
-        ans += exp(w[i] - max);
+        ans += exp(ln_x[i] + ln_y[i] - max);
     }
-    delete[] w;
     return log(ans) + max;
 }
 
+// one step of the backward/forward algorithm in log space:
+// out[j] = log(sum_l exp(transit[j*n+l] + in[l])) + site_lh[j]
+inline void logTransitStep(double* transit, double* in, double* site_lh, double* out, int n) {
+    for (int j = 0; j < n; j++) {
+        out[j] = logDotProd(transit, in, n) + site_lh[j];
+        transit += n;
+    }
+}
+
 class ModelHmm;
 class ModelHmmGm;
 
@@ -163,8 +168,23 @@ public:
     // compute the marginal probabilities for transitions between every pair of sites
     void computeMarginalTransitProb();
     
+    // number of threads for the forward/backward algorithm
+    int hmm_num_threads;
+
 private:
 
+    // true if the forward/backward arrays are computed by chunks of sites in parallel
+    bool useParallelHmm();
+
+    // compute the rows 1..nsite-1 of the backward or forward array from row 0 in parallel
+    // row t = row0 + t * row_step is computed from row t-1, the site log-likelihoods at
+    // site_lh0 + t * site_step and the transition matrix for site transit_first + t * transit_step.
+    // Each chunk of rows is first computed from a flat start; going through the chunks in order,
+    // a chunk is then recomputed from the correct start only until its rows differ from the
+    // first pass by a constant, which is then added to the rest of the chunk.
+    void computeLikeArrayParallel(double* row0, int row_step, double* site_lh0, int site_step,
+                                  int transit_first, int transit_step);
+
     // compute the log values of prob
     void computeLogProb();
 };
@@ -69,6 +69,49 @@ Numeric PhyloTree::dotProductSIMD(Numeric *x, Numeric *y, int size) {
     return horizontal_add(res);
 }
 
+template <class Numeric, class VectorClass>
+void PhyloTree::rellProductSIMD(Numeric *tree_lh, int ntrees, size_t stride, Numeric **samples, int nsamples, int size, double *rell) {
+    // patterns per tile, so that 4 sample rows and a tree row stay in L1/L2 cache
+    const int PTN_TILE = 1024;
+    const int VS = VectorClass::size();
+    int ptn_start, s, t, i;
+    memset(rell, 0, sizeof(double)*ntrees*nsamples);
+    for (ptn_start = 0; ptn_start < size; ptn_start += PTN_TILE) {
+        int ptn_end = min(ptn_start + PTN_TILE, size);
+        // 4 samples at a time, each tile of tree_lh is loaded once for 4 samples
+        for (s = 0; s+4 <= nsamples; s += 4) {
+            Numeric *w0 = samples[s], *w1 = samples[s+1], *w2 = samples[s+2], *w3 = samples[s+3];
+            for (t = 0; t < ntrees; t++) {
+                Numeric *x = tree_lh + t*stride;
+                VectorClass res0(0.0), res1(0.0), res2(0.0), res3(0.0), lh;
+                for (i = ptn_start; i < ptn_end; i += VS) {
+                    lh.load_a(&x[i]);
+                    res0 = mul_add(lh, VectorClass().load_a(&w0[i]), res0);
+                    res1 = mul_add(lh, VectorClass().load_a(&w1[i]), res1);
+                    res2 = mul_add(lh, VectorClass().load_a(&w2[i]), res2);
+                    res3 = mul_add(lh, VectorClass().load_a(&w3[i]), res3);
+                }
+                double *out = rell + s*ntrees + t;
+                out[0] += horizontal_add(res0);
+                out[ntrees] += horizontal_add(res1);
+                out[2*ntrees] += horizontal_add(res2);
+                out[3*ntrees] += horizontal_add(res3);
+            }
+        }
+        // remaining samples
+        for (; s < nsamples; s++) {
+            Numeric *w = samples[s];
+            for (t = 0; t < ntrees; t++) {
+                Numeric *x = tree_lh + t*stride;
+                VectorClass res(0.0);
+                for (i = ptn_start; i < ptn_end; i += VS)
+                    res = mul_add(VectorClass().load_a(&x[i]), VectorClass().load_a(&w[i]), res);
+                rell[s*ntrees + t] += horizontal_add(res);
+            }
+        }
+    }
+}
+
 /************************************************************************************************
  *
  *   Highly optimized vectorized versions of likelihood functions
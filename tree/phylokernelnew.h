@@ -18,6 +18,7 @@
 #endif
 
 #include "phylotree.h"
+#include "vectorclass/vectorf64.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -883,6 +884,139 @@ inline void scaleLikelihood(VectorClass &lh_max, double *invar, double *dad_part
     }
 }
 
+#ifndef KERNEL_FIX_STATES
+/**
+    select between two Vec1d of the scalar kernels, as select() of vectorclass does for SIMD vectors
+    @return s ? a : b
+*/
+static inline Vec1d select(Vec1db const & s, Vec1d const & a, Vec1d const & b) {
+    return s.xmm ? a : b;
+}
+
+/**
+    rescale a block of partial likelihoods without branching (exponent tracking, --lk-exp-scaling):
+    count per pattern how many scaling units (up to EXP_SCALING_MAX_UNITS) bring lh_max back
+    above the scaling threshold and multiply the whole block by all of them at once
+    @param lh_max maximal absolute partial likelihood of the block per pattern
+    @param invar ptn_invar of the patterns, constant sites are never scaled
+    @param[in,out] partial_lh block of partial likelihoods
+    @param N number of vectors in the block
+    @param[in,out] scale_num scaling number of the first pattern
+    @param scale_step distance between scaling numbers of consecutive patterns
+*/
+template <class VectorClass>
+inline void scaleLikelihoodExp(VectorClass lh_max, double *invar, VectorClass *partial_lh, size_t N,
+    UBYTE *scale_num, size_t scale_step, double scaling_threshold, int scaling_threshold_exp)
+{
+    auto variant = (VectorClass().load_a(invar) == 0.0);
+    double unit = ldexp(1.0, scaling_threshold_exp);
+    double threshold = scaling_threshold;
+    VectorClass units = 0.0;
+    // two factors of at most 2^512 each, their product would overflow
+    VectorClass factor[2] = {1.0, 1.0};
+    for (int i = 0; i < EXP_SCALING_MAX_UNITS; i++) {
+        auto underflown = (lh_max < threshold) & variant;
+        units = select(underflown, units + 1.0, units);
+        factor[i & 1] = select(underflown, factor[i & 1] * unit, factor[i & 1]);
+        threshold *= scaling_threshold;
+    }
+    for (size_t i = 0; i < N; i++)
+        partial_lh[i] = partial_lh[i] * factor[0] * factor[1];
+    for (size_t x = 0; x < VectorClass::size(); x++)
+        scale_num[x*scale_step] += (UBYTE)units[x];
+}
+#endif
+
+/*******************************************************
+ *
+ * Helper functions for single-precision partial likelihoods
+ *
+ ******************************************************/
+
+#ifndef KERNEL_FIX_STATES
+/**
+    convert partial likelihoods stored in single precision into a double buffer
+    @param src single-precision partial likelihoods
+    @param[out] dst double-precision buffer
+    @param N number of elements
+*/
+inline void loadFloatPartialLh(float *src, double *dst, size_t N) {
+    for (size_t i = 0; i < N; i++)
+        dst[i] = src[i];
+}
+
+/**
+    store partial likelihoods computed in double precision as single precision
+    @param src double-precision buffer
+    @param[out] dst single-precision partial likelihoods
+    @param N number of elements
+*/
+inline void storeFloatPartialLh(double *src, float *dst, size_t N) {
+    for (size_t i = 0; i < N; i++)
+        dst[i] = (float)src[i];
+}
+
+/**
+    @return per-packet buffer to stage 3 single-precision partial likelihood blocks in double,
+    it is located right after the thread buffer used by computePartialLikelihood
+    @param buffer_end end of buffer_partial_lh
+    @param block number of partial likelihoods per pattern
+*/
+template<class VectorClass>
+inline double *getFloatStageBuffer(double *buffer_end, size_t block, size_t nstates, int num_packets, int packet_id) {
+    size_t thread_buf_size = (5*block+nstates)*VectorClass::size();
+    return buffer_end - thread_buf_size*(num_packets-packet_id) + (2*block+nstates)*VectorClass::size();
+}
+
+/**
+    @return pointer to the partial likelihoods at offset, converted into stage if stored in single precision
+    @param partial_lh partial likelihood vector of a neighbor
+    @param offset element offset of the pattern block
+    @param N number of elements of the pattern block
+    @param stage double buffer of N elements
+*/
+template<const bool FLOAT_LH>
+inline double *getPartialLhBlock(double *partial_lh, size_t offset, size_t N, double *stage) {
+    if (!FLOAT_LH)
+        return partial_lh + offset;
+    loadFloatPartialLh((float*)partial_lh + offset, stage, N);
+    return stage;
+}
+
+/**
+    copy partial likelihoods and scaling numbers of a block of patterns from the first patterns
+    with the same tip states in the subtree (site repeats)
+    @param site_repeats first pattern of the repeat, per pattern
+    @param partial_lh partial likelihoods of dad_branch
+    @param ptn first pattern of the block
+    @param ptn_lower first pattern computed by the current packet
+    @return false if some pattern of the block has no repeat already computed by the current packet
+*/
+template<class VectorClass, const bool SAFE_NUMERIC, class Numeric>
+inline bool copySiteRepeats(int *site_repeats, double *ptn_invar, Numeric *partial_lh, UBYTE *scale_num,
+                            size_t ptn, size_t ptn_lower, size_t block, size_t ncat_mix) {
+    const size_t VS = VectorClass::size();
+    for (size_t i = 0; i < VS; i++) {
+        size_t rep = site_repeats[ptn+i];
+        // invariant sites are never rescaled, so they are neither copied nor copied from
+        if (rep >= ptn || rep < ptn_lower || ptn_invar[ptn+i] != 0.0 || ptn_invar[rep] != 0.0)
+            return false;
+    }
+    for (size_t i = 0; i < VS; i++) {
+        size_t rep = site_repeats[ptn+i];
+        Numeric *src = partial_lh + ((rep - rep%VS)*block + rep%VS);
+        Numeric *dst = partial_lh + (ptn*block + i);
+        for (size_t x = 0; x < block; x++)
+            dst[x*VS] = src[x*VS];
+        if (SAFE_NUMERIC)
+            memcpy(scale_num + (ptn+i)*ncat_mix, scale_num + rep*ncat_mix, sizeof(UBYTE)*ncat_mix);
+        else
+            scale_num[ptn+i] = scale_num[rep];
+    }
+    return true;
+}
+#endif
+
 
 /*******************************************************
  *
@@ -1107,6 +1241,36 @@ void PhyloTree::computePartialInfo(TraversalInfo &info, VectorClass* buffer, dou
             echild += block*nstates;
         }
     }
+
+    if (info.partial_lh_cherry && partial_lh_leaves == NULL) {
+        // cherry: combine the two tip vectors for all pairs of states, multiplied with inv_evec
+        double *inv_evec = model->getInverseEigenvectors();
+        size_t num_tip_states = aln->STATE_UNKNOWN+1;
+        double *partial_lh_left = info.partial_lh_leaves;
+        double *partial_lh_right = partial_lh_left + num_tip_states*block;
+        double *partial_lh_cherry = info.partial_lh_cherry;
+        double partial_lh_tmp[nstates];
+        for (size_t left_state = 0; left_state < num_tip_states; left_state++)
+            for (size_t right_state = 0; right_state < num_tip_states; right_state++) {
+                double *vleft = partial_lh_left + left_state*block;
+                double *vright = partial_lh_right + right_state*block;
+                for (c = 0; c < ncat_mix; c++) {
+                    double *inv_evec_ptr = inv_evec + mix_addr[c];
+                    for (x = 0; x < nstates; x++)
+                        partial_lh_tmp[x] = vleft[x] * vright[x];
+                    for (i = 0; i < nstates; i++) {
+                        double res = 0.0;
+                        for (x = 0; x < nstates; x++)
+                            res += inv_evec_ptr[x] * partial_lh_tmp[x];
+                        partial_lh_cherry[i] = res;
+                        inv_evec_ptr += nstates;
+                    }
+                    vleft += nstates;
+                    vright += nstates;
+                    partial_lh_cherry += nstates;
+                }
+            }
+    }
 }
 
 #ifndef KERNEL_FIX_STATES
@@ -1187,6 +1351,11 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
 
     PhyloNeighbor *dad_branch = (PhyloNeighbor*)dad->findNeighbor(node);
     PhyloNeighbor *node_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+    if (params->lh_mem_save == LM_MEM_SAVE && !theta_computed) {
+        // the previous traversal has unlocked its slots, give back those beyond -mem;
+        // not while derivatives reuse theta_all, they do not recompute partial likelihoods
+        mem_slots.releaseExtraSlots();
+    }
     bool dad_locked = computeTraversalInfo(dad_branch, dad, buffer);
     bool node_locked = computeTraversalInfo(node_branch, node, buffer);
     if (params->lh_mem_save == LM_MEM_SAVE) {
@@ -1239,7 +1408,16 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
         }
 
         
-        if (!Params::getInstance().buffer_mem_save) {
+        if (!Params::getInstance().buffer_mem_save && isThreadPool() && num_info >= 3) {
+            getThreadPool()->parallelFor(num_info, [&](int i, int thread_id) {
+                VectorClass *buffer_tmp = (VectorClass*)buffer + aln->num_states*thread_id;
+            #ifdef KERNEL_FIX_STATES
+                computePartialInfo<VectorClass, nstates>(traversal_info[i], buffer_tmp);
+            #else
+                computePartialInfo<VectorClass>(traversal_info[i], buffer_tmp);
+            #endif
+            }, num_threads);
+        } else if (!Params::getInstance().buffer_mem_save) {
 #ifdef _OPENMP
 #pragma omp parallel if (num_info >= 3) num_threads(num_threads)
         {
@@ -1261,12 +1439,21 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
         }
     }
 
-    if (compute_partial_lh) {
+    size_t orig_nptn = roundUpToMultiple(aln->size(), VectorClass::size());
+    size_t nptn      = roundUpToMultiple(orig_nptn+model_factory->unobserved_ptns.size(),VectorClass::size());
+    if (Params::getInstance().subtree_tasks) {
+        computeTraversalSubtrees(nptn, VectorClass::size());
+    }
+
+    // with the thread pool, the callers' packet loops find traversal_info already done
+    if (compute_partial_lh || isThreadPool()) {
         vector<size_t> limits;
-        size_t orig_nptn = roundUpToMultiple(aln->size(), VectorClass::size());
-        size_t nptn      = roundUpToMultiple(orig_nptn+model_factory->unobserved_ptns.size(),VectorClass::size());
         computeBounds<VectorClass>(num_threads, num_packets, nptn, limits);
 
+        if (isThreadPool()) {
+            computeTraversalGraph(limits);
+            return;
+        }
         #ifdef _OPENMP
         #pragma omp parallel for schedule(dynamic,1) num_threads(num_threads)
         #endif
@@ -1287,11 +1474,11 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computePartialLikelihoodSIMD(TraversalInfo &info
                                              , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                                                     , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #endif
@@ -1350,8 +1537,18 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 	}
 
     // precomputed buffer to save times
-    size_t thread_buf_size        = (2*block+nstates)*VectorClass::size();
+    size_t thread_buf_size        = (FLOAT_LH ? 5*block+nstates : 2*block+nstates)*VectorClass::size();
     double *buffer_partial_lh_ptr = buffer_partial_lh + (getBufferPartialLhSize() - thread_buf_size*num_packets);
+    // single precision: partial likelihoods of dad and children are staged in double
+    double *stage_dad = FLOAT_LH ? getFloatStageBuffer<VectorClass>(buffer_partial_lh + getBufferPartialLhSize(), block, nstates, num_packets, packet_id) : NULL;
+    double *stage_left = stage_dad + block*VectorClass::size();
+    double *stage_right = stage_left + block*VectorClass::size();
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    // patterns with the same tip states in the subtree as an earlier pattern
+    int *site_repeats = (!SITE_MODEL && !dad_branch->site_repeats.empty() && isSiteRepeats()) ? &dad_branch->site_repeats[0] : NULL;
+    const int scaling_threshold_exp = FLOAT_LH ? SCALING_THRESHOLD_FLOAT_EXP : SCALING_THRESHOLD_EXP;
+    // branch-free rescaling of all pattern blocks (--lk-exp-scaling)
+    const bool exp_scaling = params->lk_exp_scaling;
     double *echildren = NULL;
     double *partial_lh_leaves = NULL;
 
@@ -1459,7 +1656,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     } else {
                         // internal node
                         VectorClass *partial_lh = partial_lh_all;
-                        VectorClass *partial_lh_child = (VectorClass*)(child->partial_lh + ptn*block);
+                        VectorClass *partial_lh_child = (VectorClass*)getPartialLhBlock<FLOAT_LH>(child->partial_lh, ptn*block, block*VectorClass::size(), stage_left);
                         if (!SAFE_NUMERIC) {
                             for (size_t i = 0; i < VectorClass::size(); i++)
                                 dad_branch->scale_num[ptn+i] += child->scale_num[ptn+i];
@@ -1526,7 +1723,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     } else {
                         // internal node
                         VectorClass *partial_lh = partial_lh_all;
-                        VectorClass *partial_lh_child = (VectorClass*)(child->partial_lh + ptn*block);
+                        VectorClass *partial_lh_child = (VectorClass*)getPartialLhBlock<FLOAT_LH>(child->partial_lh, ptn*block, block*VectorClass::size(), stage_left);
                         if (!SAFE_NUMERIC) {
                             for (size_t i = 0; i < VectorClass::size(); i++)
                                 dad_branch->scale_num[ptn+i] += child->scale_num[ptn+i];
@@ -1562,8 +1759,14 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                         VectorClass lh_max = 0.0;
                         for (size_t x = 0; x < nstates; x++)
                             lh_max = max(lh_max,abs(partial_lh_tmp[x]));
+                        if (exp_scaling) {
+                            scaleLikelihoodExp(lh_max, &ptn_invar[ptn], partial_lh_tmp, nstates,
+                                dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix, scaling_threshold, scaling_threshold_exp);
+                            partial_lh_tmp += nstates;
+                            continue;
+                        }
                         // check if one should scale partial likelihoods
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++)
                             if (underflown[x]) {
@@ -1571,7 +1774,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                                 // now do the likelihood scaling
                                 double *partial_lh = (double*)partial_lh_tmp + (x);
                                 for (size_t i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                             }
                         }
@@ -1582,14 +1785,19 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     VectorClass lh_max = 0.0;
                     for (size_t x = 0; x < block; x++)
                         lh_max = max(lh_max,abs(partial_lh_all[x]));
-                    auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+                    if (exp_scaling) {
+                        scaleLikelihoodExp(lh_max, &ptn_invar[ptn], partial_lh_all, block,
+                            dad_branch->scale_num + ptn, 1, scaling_threshold, scaling_threshold_exp);
+                        continue;
+                    }
+                    auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                     if (horizontal_or(underflown)) { // at least one site has numerical underflown
                         for (size_t x = 0; x < VectorClass::size(); x++) {
                             if (underflown[x]) {
                                 double *partial_lh = (double*)partial_lh_all + (x);
                                 // now do the likelihood scaling
                                 for (size_t i = 0; i < block; i++) {
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 }
                                 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                                 dad_branch->scale_num[ptn+x] += 1;
@@ -1603,7 +1811,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         
             // compute dot-product with inv_eigenvector
             VectorClass *partial_lh_tmp = partial_lh_all;
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            VectorClass *partial_lh = (VectorClass*)(FLOAT_LH ? stage_dad : dad_branch->partial_lh + ptn*block);
             VectorClass lh_max = 0.0;
             double *inv_evec_ptr = SITE_MODEL ? &inv_evec[ptn*states_square] : NULL;
             for (size_t c = 0; c < ncat_mix; c++) {
@@ -1625,6 +1833,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 partial_lh += nstates;
                 partial_lh_tmp += nstates;
             }
+            if (FLOAT_LH)
+                storeFloatPartialLh(stage_dad, (float*)dad_branch->partial_lh + ptn*block, block*VectorClass::size());
 
         } // for ptn
 
@@ -1646,9 +1856,11 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         auto leftStateRow  = this->getConvertedSequenceByNumber(left->node->id);
         auto rightStateRow = this->getConvertedSequenceByNumber(right->node->id);
         auto unknown = aln->STATE_UNKNOWN;
+        // lookup table for all pairs of tip states, precomputed by computePartialInfo
+        double *partial_lh_cherry = SITE_MODEL ? NULL : info.partial_lh_cherry;
 
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            VectorClass *partial_lh = (VectorClass*)(FLOAT_LH ? stage_dad : dad_branch->partial_lh + ptn*block);
 
             if (SITE_MODEL) {
                 VectorClass* expleft = (VectorClass*) vec_left;
@@ -1709,6 +1921,16 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                         leftState  = unknown;
                         rightState = unknown;
                     }
+                    if (partial_lh_cherry) {
+                        // gather the final partial likelihoods from the lookup table
+                        double *cherry = partial_lh_cherry + block*(leftState*(aln->STATE_UNKNOWN+1) + rightState);
+                        double *this_partial_lh = (double*)partial_lh + x;
+                        for (size_t i = 0; i < block; i++) {
+                            *this_partial_lh = cherry[i];
+                            this_partial_lh += VectorClass::size();
+                        }
+                        continue;
+                    }
                     double* tip_left  = partial_lh_left  + block*leftState;
                     double* tip_right = partial_lh_right + block*rightState;
                     double* this_vec_left = vec_left+x;
@@ -1721,8 +1943,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     }
                 }
 
-
-                for (size_t c = 0; c < ncat_mix; c++) {
+                // otherwise compute from the two tip vectors
+                for (size_t c = 0; c < ncat_mix && !partial_lh_cherry; c++) {
                     double *inv_evec_ptr = inv_evec + mix_addr[c];
                     // compute real partial likelihood vector
                     for (size_t x = 0; x < nstates; x++) {
@@ -1742,6 +1964,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     partial_lh += nstates;
                 } // FOR category
             } // IF SITE_MODEL
+            if (FLOAT_LH)
+                storeFloatPartialLh(stage_dad, (float*)dad_branch->partial_lh + ptn*block, block*VectorClass::size());
 		} // FOR LOOP
 
 
@@ -1765,8 +1989,13 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         auto unknown = aln->STATE_UNKNOWN;
         
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-            VectorClass *partial_lh_right = (VectorClass*)(right->partial_lh + ptn*block);
+            if (site_repeats && (FLOAT_LH ?
+                copySiteRepeats<VectorClass, SAFE_NUMERIC>(site_repeats, ptn_invar, (float*)dad_branch->partial_lh, dad_branch->scale_num, ptn, ptn_lower, block, ncat_mix) :
+                copySiteRepeats<VectorClass, SAFE_NUMERIC>(site_repeats, ptn_invar, dad_branch->partial_lh, dad_branch->scale_num, ptn, ptn_lower, block, ncat_mix)))
+                continue;
+            double *dad_partial_lh = FLOAT_LH ? stage_dad : dad_branch->partial_lh + ptn*block;
+            VectorClass *partial_lh = (VectorClass*)dad_partial_lh;
+            VectorClass *partial_lh_right = (VectorClass*)getPartialLhBlock<FLOAT_LH>(right->partial_lh, ptn*block, block*VectorClass::size(), stage_right);
             VectorClass lh_max = 0.0;
 
             if (SITE_MODEL) {
@@ -1797,16 +2026,19 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     productVecMat<VectorClass, VectorClass, FMA> (partial_lh_tmp, inv_evec_ptr, partial_lh, lh_max, nstates);
 #endif
                     // check if one should scale partial likelihoods
-                    if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                    if (SAFE_NUMERIC && exp_scaling) {
+                        scaleLikelihoodExp(lh_max, &ptn_invar[ptn], (VectorClass*)dad_partial_lh + c*nstates, nstates,
+                            dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix, scaling_threshold, scaling_threshold_exp);
+                    } else if (SAFE_NUMERIC) {
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++)
                             if (underflown[x]) {
                                 // BQM 2016-05-03: only scale for non-constant sites
                                 // now do the likelihood scaling
-                                double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                                double *partial_lh = dad_partial_lh + (c*nstates*VectorClass::size() + x);
                                 for (size_t i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                             }
                         }
@@ -1865,16 +2097,19 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     productVecMat<VectorClass, double, FMA> (partial_lh_tmp, inv_evec_ptr, partial_lh, lh_max, nstates);
     #endif
                     // check if one should scale partial likelihoods
-                    if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                    if (SAFE_NUMERIC && exp_scaling) {
+                        scaleLikelihoodExp(lh_max, &ptn_invar[ptn], (VectorClass*)dad_partial_lh + c*nstates, nstates,
+                            dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix, scaling_threshold, scaling_threshold_exp);
+                    } else if (SAFE_NUMERIC) {
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++) {
                                 if (underflown[x]) {
                                     // BQM 2016-05-03: only scale for non-constant sites
                                     // now do the likelihood scaling
-                                    double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                                    double *partial_lh = dad_partial_lh + (c*nstates*VectorClass::size() + x);
                                     for (size_t i = 0; i < nstates; i++)
-                                        partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                        partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                     dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                                 }
                             }
@@ -1886,21 +2121,26 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 } // FOR category
             } // IF SITE_MODEL
 
-            if (!SAFE_NUMERIC) {
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+            if (!SAFE_NUMERIC && exp_scaling) {
+                scaleLikelihoodExp(lh_max, &ptn_invar[ptn], (VectorClass*)dad_partial_lh, block,
+                    dad_branch->scale_num + ptn, 1, scaling_threshold, scaling_threshold_exp);
+            } else if (!SAFE_NUMERIC) {
+                auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                 if (horizontal_or(underflown)) { // at least one site has numerical underflown
                     for (size_t x = 0; x < VectorClass::size(); x++)
                     if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
+                        double *partial_lh = dad_partial_lh + x;
                         // now do the likelihood scaling
                         for (size_t i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                         }
 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                         dad_branch->scale_num[ptn+x] += 1;
                     }
                 }
             }
+            if (FLOAT_LH)
+                storeFloatPartialLh(stage_dad, (float*)dad_branch->partial_lh + ptn*block, block*VectorClass::size());
 
 		} // big for loop over ptn
 
@@ -1911,9 +2151,14 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         VectorClass *partial_lh_tmp
             = (VectorClass*)(buffer_partial_lh_ptr + thread_buf_size * packet_id);
 		for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-			VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-			VectorClass *partial_lh_left = (VectorClass*)(left->partial_lh + ptn*block);
-			VectorClass *partial_lh_right = (VectorClass*)(right->partial_lh + ptn*block);
+            if (site_repeats && (FLOAT_LH ?
+                copySiteRepeats<VectorClass, SAFE_NUMERIC>(site_repeats, ptn_invar, (float*)dad_branch->partial_lh, dad_branch->scale_num, ptn, ptn_lower, block, ncat_mix) :
+                copySiteRepeats<VectorClass, SAFE_NUMERIC>(site_repeats, ptn_invar, dad_branch->partial_lh, dad_branch->scale_num, ptn, ptn_lower, block, ncat_mix)))
+                continue;
+            double *dad_partial_lh = FLOAT_LH ? stage_dad : dad_branch->partial_lh + ptn*block;
+			VectorClass *partial_lh = (VectorClass*)dad_partial_lh;
+			VectorClass *partial_lh_left = (VectorClass*)getPartialLhBlock<FLOAT_LH>(left->partial_lh, ptn*block, block*VectorClass::size(), stage_left);
+			VectorClass *partial_lh_right = (VectorClass*)getPartialLhBlock<FLOAT_LH>(right->partial_lh, ptn*block, block*VectorClass::size(), stage_right);
             VectorClass lh_max = 0.0;
             UBYTE *scale_dad, *scale_left, *scale_right;
 
@@ -1991,16 +2236,20 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 }
 
                 // check if one should scale partial likelihoods
-                if (SAFE_NUMERIC) {
-                    auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                if (SAFE_NUMERIC && exp_scaling) {
+                    scaleLikelihoodExp(lh_max, &ptn_invar[ptn], (VectorClass*)dad_partial_lh + c*nstates, nstates,
+                        scale_dad, ncat_mix, scaling_threshold, scaling_threshold_exp);
+                    scale_dad++;
+                } else if (SAFE_NUMERIC) {
+                    auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                     if (horizontal_or(underflown))
                         for (size_t x = 0; x < VectorClass::size(); x++)
                         if (underflown[x]) {
                             // BQM 2016-05-03: only scale for non-constant sites
                             // now do the likelihood scaling
-                            double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                            double *partial_lh = dad_partial_lh + (c*nstates*VectorClass::size() + x);
                             for (size_t i = 0; i < nstates; i++)
-                                partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                             scale_dad[x*ncat_mix] += 1;
                         }
                     scale_dad++;
@@ -2012,22 +2261,27 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 partial_lh += nstates;
 			}
 
-            if (!SAFE_NUMERIC) {
+            if (!SAFE_NUMERIC && exp_scaling) {
+                scaleLikelihoodExp(lh_max, &ptn_invar[ptn], (VectorClass*)dad_partial_lh, block,
+                    dad_branch->scale_num + ptn, 1, scaling_threshold, scaling_threshold_exp);
+            } else if (!SAFE_NUMERIC) {
                 // check if one should scale partial likelihoods
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+                auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                 if (horizontal_or(underflown)) { // at least one site has numerical underflown
                     for (size_t x = 0; x < VectorClass::size(); x++)
                     if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
+                        double *partial_lh = dad_partial_lh + x;
                         // now do the likelihood scaling
                         for (size_t i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                         }
 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                         dad_branch->scale_num[ptn+x] += 1;
                     }
                 }
             }
+            if (FLOAT_LH)
+                storeFloatPartialLh(stage_dad, (float*)dad_branch->partial_lh + ptn*block, block*VectorClass::size());
         } // big for loop over ptn
     }
 
@@ -2046,11 +2300,11 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodBufferSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad
                                             , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad
                                                    , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #endif
@@ -2083,6 +2337,9 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         buffer_partial_lh_ptr += nmix*(nmix+1)*VectorClass::size() + (nmix+3)*nmix*VectorClass::size()*num_packets;
     }
 
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    const double log_scaling_threshold = FLOAT_LH ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
+
     // first compute partial_lh
     for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
         computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
@@ -2098,7 +2355,8 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         size_t offset     = ptn_lower*block;
         size_t offsetStep = block*VectorClass::size();
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size(), offset+=offsetStep) {
-            VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + offset);
+            // single precision: partial_lh_dad is converted in-place into theta
+            VectorClass *partial_lh_dad = (VectorClass*)getPartialLhBlock<FLOAT_LH>(dad_branch->partial_lh, offset, offsetStep, theta_all + offset);
             VectorClass *theta = (VectorClass*)(theta_all + offset);
             //load tip vector
             if (!SITE_MODEL) {
@@ -2155,7 +2413,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                         if (scale_dad[c] == min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
                             for (size_t x = 0; x < nstates; x++) {
-                                this_theta[x*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_theta[x*VectorClass::size()] *= scaling_threshold;
                             }
                         } else if (scale_dad[c] > min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
@@ -2172,18 +2430,20 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                 }
             }
             VectorClass *buf = (VectorClass*)(buffer_scale_all+ptn);
-            *buf *= LOG_SCALING_THRESHOLD;
+            *buf *= log_scaling_threshold;
 
         } // FOR PTN LOOP
 //            aligned_free(vec_tip);
     } else {
         //------- both dad and node are internal nodes  --------//
 
+        double *stage_dad = FLOAT_LH ? getFloatStageBuffer<VectorClass>(buffer_partial_lh + getBufferPartialLhSize(), block, nstates, num_packets, packet_id) : NULL;
+
         // now compute theta
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
             VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
-            VectorClass *partial_lh_node = (VectorClass*)(node_branch->partial_lh + ptn*block);
-            VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            VectorClass *partial_lh_node = (VectorClass*)getPartialLhBlock<FLOAT_LH>(node_branch->partial_lh, ptn*block, block*VectorClass::size(), theta_all + ptn*block);
+            VectorClass *partial_lh_dad = (VectorClass*)getPartialLhBlock<FLOAT_LH>(dad_branch->partial_lh, ptn*block, block*VectorClass::size(), stage_dad);
             for (size_t i = 0; i < block; i++) {
                 theta[i] = partial_lh_node[i] * partial_lh_dad[i];
             }
@@ -2207,7 +2467,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                         if (sum_scale[c] == min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
                             for (size_t x = 0; x < nstates; x++) {
-                                this_theta[x*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_theta[x*VectorClass::size()] *= scaling_threshold;
                             }
                         } else if (sum_scale[c] > min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
@@ -2225,16 +2485,16 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                 }
             }
             VectorClass *buf = (VectorClass*)(buffer_scale_all+ptn);
-            *buf *= LOG_SCALING_THRESHOLD;
+            *buf *= log_scaling_threshold;
         } // FOR ptn
     } // internal node
 }
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf)
 #endif
 {
@@ -2372,20 +2632,18 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
         for (size_t i = 0; i < nmixlen2; i++) all_ddfvec[i] = 0.0;
     }
     
-    double all_lh(0.0), all_df(0.0), all_ddf(0.0), all_prob_const(0.0), all_df_const(0.0), all_ddf_const(0.0);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) reduction(+:all_lh,all_df,all_ddf,all_prob_const,all_df_const,all_ddf_const)
-#endif
-    for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+    // all_sums: lh, df, ddf, prob_const, df_const, ddf_const
+    double all_sums[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    runPackets([&](int packet_id, double *packet_sums) {
         VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
         size_t ptn_lower = limits[packet_id];
         size_t ptn_upper = limits[packet_id+1];
 
         if (!theta_computed)
         #ifdef KERNEL_FIX_STATES
-            computeLikelihoodBufferSIMD<VectorClass, SAFE_NUMERIC, nstates, FMA, SITE_MODEL>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
+            computeLikelihoodBufferSIMD<VectorClass, SAFE_NUMERIC, nstates, FMA, SITE_MODEL, FLOAT_LH>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
         #else
-            computeLikelihoodBufferGenericSIMD<VectorClass, SAFE_NUMERIC, FMA, SITE_MODEL>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
+            computeLikelihoodBufferGenericSIMD<VectorClass, SAFE_NUMERIC, FMA, SITE_MODEL, FLOAT_LH>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
         #endif
 
         if (isMixlen()) {
@@ -2448,7 +2706,7 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                     ASSERT(0 && "TODO +ASC not supported");
                 }
             } // FOR ptn
-            all_lh += horizontal_add(my_lh); //handled by reduction clause
+            packet_sums[0] += horizontal_add(my_lh);
         #ifdef _OPENMP
         #pragma omp critical
         #endif
@@ -2518,9 +2776,9 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                         double *ddf_ptn_dbl = (double*)&ddf_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (buffer_scale_all[ptn+i] != 0.0) {
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
-                                df_ptn_dbl[i] *= SCALING_THRESHOLD;
-                                ddf_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= (FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD);
+                                df_ptn_dbl[i] *= (FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD);
+                                ddf_ptn_dbl[i] *= (FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD);
                             }
                     }
                     if (ASC_Holder) {
@@ -2535,20 +2793,20 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                 }
             } // FOR ptn
             {
-                //These adds don't need to be in a critical section, as the
-                //shared variables are all mentioned in the reduction clause
-                //Note that, since those variables are now double, the
-                //horizontal_add operations need to be done here.
-                all_df  += horizontal_add(my_df);
-                all_ddf += horizontal_add(my_ddf);
+                //These adds don't need to be in a critical section, as
+                //every packet has its own sums (added up by runPackets).
+                packet_sums[1] += horizontal_add(my_df);
+                packet_sums[2] += horizontal_add(my_ddf);
                 if (ASC_Lewis) {
-                    all_prob_const += horizontal_add(vc_prob_const);
-                    all_df_const   += horizontal_add(vc_df_const);
-                    all_ddf_const  += horizontal_add(vc_ddf_const);
+                    packet_sums[3] += horizontal_add(vc_prob_const);
+                    packet_sums[4] += horizontal_add(vc_df_const);
+                    packet_sums[5] += horizontal_add(vc_ddf_const);
                 }
             }
         } // else isMixlen()
-    } // FOR packet
+    }, 6, all_sums); // FOR packet
+    double all_lh = all_sums[0], all_df = all_sums[1], all_ddf = all_sums[2];
+    double all_prob_const = all_sums[3], all_df_const = all_sums[4], all_ddf_const = all_sums[5];
 
     // mark buffer as computed
     theta_computed = true;
@@ -2639,10 +2897,10 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, bool save_log_value)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, bool save_log_value)
 #endif
 {
@@ -2744,8 +3002,10 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
         }
     }
 
-    double all_tree_lh(0.0);
-    double all_prob_const(0.0);
+    // all_sums: tree_lh, prob_const
+    double all_sums[2] = {0.0, 0.0};
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    const double log_scaling_threshold = FLOAT_LH ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
 
     vector<size_t> limits;
     computeBounds<VectorClass>(num_threads, num_packets, nptn, limits);
@@ -2805,10 +3065,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
         // cout << "num_packets = " << num_packets << endl;
         // cout << "num_threads = " << num_threads << endl;
         // cout << "nptn = " << nptn << endl;
-#ifdef _OPENMP
-#pragma omp parallel for  schedule(dynamic,1) num_threads(num_threads) reduction(+:all_tree_lh,all_prob_const)
-#endif
-        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+        runPackets([&](int packet_id, double *packet_sums) {
             // cout << "packet_id = " << packet_id << " ptn_lower = " << limits[packet_id] << " ptn_upper = " << limits[packet_id+1] << endl;
             VectorClass vc_tree_lh(0.0);
             VectorClass vc_prob_const(0.0);
@@ -2823,11 +3080,12 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                 computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
             }
             double *vec_tip = buffer_partial_lh_ptr + block*VectorClass::size() * packet_id;
+            double *stage_dad = FLOAT_LH ? getFloatStageBuffer<VectorClass>(buffer_partial_lh + getBufferPartialLhSize(), block, nstates, num_packets, packet_id) : NULL;
 
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0);
                 VectorClass *lh_cat = (VectorClass*)(_pattern_lh_cat + ptn*ncat_mix);
-                VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+                VectorClass *partial_lh_dad = (VectorClass*)getPartialLhBlock<FLOAT_LH>(dad_branch->partial_lh, ptn*block, block*VectorClass::size(), stage_dad);
                 VectorClass *lh_node = SITE_MODEL ? (VectorClass*)&partial_lh_node[ptn*nstates] : (VectorClass*)vec_tip;
 
                 if (SITE_MODEL) {
@@ -2904,7 +3162,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         for (size_t c = 0; c < ncat_mix; c++) {
                             // rescale lh_cat if neccessary
                             if (scale_dad[c] == min_scale+1) {
-                                this_lh_cat[c*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_lh_cat[c*VectorClass::size()] *= scaling_threshold;
                             } else if (scale_dad[c] > min_scale+1) {
                                 this_lh_cat[c*VectorClass::size()] = 0.0;
                             }
@@ -2919,7 +3177,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         vc_min_scale_ptr[i] = dad_branch->scale_num[ptn+i];
                     }
                 }
-                vc_min_scale *= LOG_SCALING_THRESHOLD;
+                vc_min_scale *= log_scaling_threshold;
 
                 // Sum later to avoid underflow of invariant sites
                 lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
@@ -2945,7 +3203,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *lh_ptn_dbl = (double*)&lh_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (vc_min_scale_ptr[i] != 0.0)
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= scaling_threshold;
                     }
                     if (ASC_Holder)
                         lh_ptn.store_a(&_pattern_lh[ptn]);
@@ -2954,22 +3212,18 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                 }
             } // FOR PTN
             {
-                //These additions are not in a critical section, because the
-                //all_tree_lh and all_prob_const variables are mentioned in
-                //the reduction clause of the omp parallel for.
-                all_tree_lh += horizontal_add(vc_tree_lh);
+                //These additions are not in a critical section, because
+                //every packet has its own sums (added up by runPackets).
+                packet_sums[0] += horizontal_add(vc_tree_lh);
                 if (ASC_Lewis) {
-                    all_prob_const += horizontal_add(vc_prob_const);
+                    packet_sums[1] += horizontal_add(vc_prob_const);
                 }
             }
-        } // FOR packet
+        }, 2, all_sums); // FOR packet
     } else {
         //ASSERT(0 && "Don't compute tree log-likelihood from internal branch!");
     	//-------- both dad and node are internal nodes -----------/
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) reduction(+:all_tree_lh,all_prob_const)
-#endif
-        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+        runPackets([&](int packet_id, double *packet_sums) {
             size_t ptn_lower = limits[packet_id];
             size_t ptn_upper = limits[packet_id+1];
 
@@ -2983,11 +3237,13 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
 
             VectorClass vc_tree_lh(0.0);
             VectorClass vc_prob_const(0.0);
+            double *stage_dad = FLOAT_LH ? getFloatStageBuffer<VectorClass>(buffer_partial_lh + getBufferPartialLhSize(), block, nstates, num_packets, packet_id) : NULL;
+            double *stage_node = stage_dad + block*VectorClass::size();
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0);
                 VectorClass *lh_cat = (VectorClass*)(_pattern_lh_cat + ptn*ncat_mix);
-                VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-                VectorClass *partial_lh_node = (VectorClass*)(node_branch->partial_lh + ptn*block);
+                VectorClass *partial_lh_dad = (VectorClass*)getPartialLhBlock<FLOAT_LH>(dad_branch->partial_lh, ptn*block, block*VectorClass::size(), stage_dad);
+                VectorClass *partial_lh_node = (VectorClass*)getPartialLhBlock<FLOAT_LH>(node_branch->partial_lh, ptn*block, block*VectorClass::size(), stage_node);
 
                 // compute likelihood per category
                 if (SITE_MODEL) {
@@ -3041,7 +3297,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *this_lh_cat = &_pattern_lh_cat[ptn*ncat_mix + i];
                         for (size_t c = 0; c < ncat_mix; c++) {
                             if (sum_scale[c] == min_scale+1) {
-                                this_lh_cat[c*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_lh_cat[c*VectorClass::size()] *= scaling_threshold;
                             } else if (sum_scale[c] > min_scale+1) {
                                 // reset if category is scaled a lot
                                 this_lh_cat[c*VectorClass::size()] = 0.0;
@@ -3056,7 +3312,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         vc_min_scale_ptr[i] = dad_branch->scale_num[ptn+i] + node_branch->scale_num[ptn+i];
                     }
                 } // if SAFE_NUMERIC
-                vc_min_scale *= LOG_SCALING_THRESHOLD;
+                vc_min_scale *= log_scaling_threshold;
 
                 // Sum later to avoid underflow of invariant sites
                 lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
@@ -3083,7 +3339,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *lh_ptn_dbl = (double*)&lh_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (vc_min_scale_ptr[i] != 0.0)
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= scaling_threshold;
                     }
                     if (ASC_Holder)
                         lh_ptn.store_a(&_pattern_lh[ptn]);
@@ -3093,16 +3349,16 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
             } // FOR LOOP ptn
             {
                 //These additions don't need to be in a critical section,
-                //because of the reduction(+:all_tree_lh,all_prob_const)
-                //clause in the omp parallel for.
-                all_tree_lh += horizontal_add(vc_tree_lh);
+                //because every packet has its own sums.
+                packet_sums[0] += horizontal_add(vc_tree_lh);
                 if (ASC_Lewis) {
-                    all_prob_const += horizontal_add(vc_prob_const);
+                    packet_sums[1] += horizontal_add(vc_prob_const);
                 }
             }
-        } // FOR thread
+        }, 2, all_sums); // FOR thread
     } // else
 
+    double all_tree_lh = all_sums[0], all_prob_const = all_sums[1];
     tree_lh += all_tree_lh;
     if (!std::isfinite(tree_lh)) {
         if (SAFE_NUMERIC) {
@@ -3230,10 +3486,10 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodFromBufferSIMD()
 #else
-template <class VectorClass, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
 #endif
 {
@@ -3305,67 +3561,65 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
         }
     }
 
-    double all_tree_lh(0.0), all_prob_const(0.0);
+    vector<size_t> limits;
+    computeBounds<VectorClass>(num_threads, num_packets, nptn, limits);
 
-    #ifdef _OPENMP
-    #pragma omp parallel for num_threads(num_threads) reduction(+:all_tree_lh,all_prob_const)
-    #endif
-    for (size_t ptn = 0; ptn < nptn; ptn+=VectorClass::size()) {
-        VectorClass lh_ptn(0.0);
-        VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
-        if (SITE_MODEL) {
-            VectorClass *eval_ptr = (VectorClass*)&eval[ptn*nstates];
-            for (size_t c = 0; c < ncat; c++) {
-                VectorClass lh_cat;
+    // all_sums: tree_lh, prob_const
+    double all_sums[2] = {0.0, 0.0};
+    runPackets([&](int packet_id, double *packet_sums) {
+        VectorClass vc_tree_lh(0.0);
+        VectorClass vc_prob_const(0.0);
+        for (size_t ptn = limits[packet_id]; ptn < limits[packet_id+1]; ptn+=VectorClass::size()) {
+            VectorClass lh_ptn(0.0);
+            VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
+            if (SITE_MODEL) {
+                VectorClass *eval_ptr = (VectorClass*)&eval[ptn*nstates];
+                for (size_t c = 0; c < ncat; c++) {
+                    VectorClass lh_cat;
 #ifdef KERNEL_FIX_STATES
-                dotProductExp<VectorClass, double, nstates, FMA>(eval_ptr, theta, cat_length[c], lh_cat);
+                    dotProductExp<VectorClass, double, nstates, FMA>(eval_ptr, theta, cat_length[c], lh_cat);
 #else
-                dotProductExp<VectorClass, double, FMA>(eval_ptr, theta, cat_length[c], lh_cat, nstates);
+                    dotProductExp<VectorClass, double, FMA>(eval_ptr, theta, cat_length[c], lh_cat, nstates);
 #endif
-                lh_ptn = mul_add(lh_cat, cat_prop[c], lh_ptn);
-                theta += nstates;
+                    lh_ptn = mul_add(lh_cat, cat_prop[c], lh_ptn);
+                    theta += nstates;
+                }
+            } else {
+                dotProductVec<VectorClass, double, FMA>(val0, theta, lh_ptn, block);
             }
-        } else {
-            dotProductVec<VectorClass, double, FMA>(val0, theta, lh_ptn, block);
-        }
 
-        // Sum later to avoid underflow of invariant sites
-        lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
+            // Sum later to avoid underflow of invariant sites
+            lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
 
-        VectorClass vc_tree_lh(0.0);
-        VectorClass vc_prob_const(0.0);
-        if (ptn < orig_nptn) {
-            lh_ptn = log(abs(lh_ptn)) + VectorClass().load_a(&buffer_scale_all[ptn]);
-            lh_ptn.store_a(&_pattern_lh[ptn]);
-            vc_tree_lh = mul_add(lh_ptn, VectorClass().load_a(&ptn_freq[ptn]), vc_tree_lh);
-        } else {
-            if (ptn+VectorClass::size() > nptn) {
-                // cutoff the last entries if going beyond
-                lh_ptn.cutoff(nptn-ptn);
-            }
-            if (horizontal_or(VectorClass().load_a(&buffer_scale_all[ptn]) != 0.0)) {
-                // some entries are rescaled
-                double *lh_ptn_dbl = (double*)&lh_ptn;
-                for (size_t i = 0; i < VectorClass::size(); i++)
-                    if (buffer_scale_all[ptn+i] != 0.0)
-                        lh_ptn_dbl[i] *= SCALING_THRESHOLD;
-            }
-            if (ASC_Holder) {
+            if (ptn < orig_nptn) {
+                lh_ptn = log(abs(lh_ptn)) + VectorClass().load_a(&buffer_scale_all[ptn]);
                 lh_ptn.store_a(&_pattern_lh[ptn]);
+                vc_tree_lh = mul_add(lh_ptn, VectorClass().load_a(&ptn_freq[ptn]), vc_tree_lh);
+            } else {
+                if (ptn+VectorClass::size() > nptn) {
+                    // cutoff the last entries if going beyond
+                    lh_ptn.cutoff(nptn-ptn);
+                }
+                if (horizontal_or(VectorClass().load_a(&buffer_scale_all[ptn]) != 0.0)) {
+                    // some entries are rescaled
+                    double *lh_ptn_dbl = (double*)&lh_ptn;
+                    for (size_t i = 0; i < VectorClass::size(); i++)
+                        if (buffer_scale_all[ptn+i] != 0.0)
+                            lh_ptn_dbl[i] *= (FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD);
+                }
+                if (ASC_Holder) {
+                    lh_ptn.store_a(&_pattern_lh[ptn]);
+                }
+                else {
+                    vc_prob_const += lh_ptn;
+                }
             }
-            else {
-                vc_prob_const += lh_ptn;
-            }
-        }
-        {
-            //Don't need a critical section here, because of the
-            //reduction(+:all_tree_lh,all_prob_const) clause on
-            //the omp parallel for.
-            all_tree_lh += horizontal_add(vc_tree_lh);
-            if (ASC_Lewis)
-                all_prob_const += horizontal_add(vc_prob_const);
         }
-    }
+        packet_sums[0] += horizontal_add(vc_tree_lh);
+        if (ASC_Lewis)
+            packet_sums[1] += horizontal_add(vc_prob_const);
+    }, 2, all_sums);
+    double all_tree_lh = all_sums[0], all_prob_const = all_sums[1];
 
     double tree_lh = all_tree_lh;
     if (!safe_numeric && !std::isfinite(tree_lh))
@@ -3522,12 +3776,9 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
         }
     }
 
-    double all_df(0.0), all_ddf(0.0), all_prob_const(0.0), all_df_const(0.0), all_ddf_const(0.0);
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads) reduction(+:all_df,all_ddf,all_prob_const,all_df_const,all_ddf_const)
-#endif
-    for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+    // all_sums: df, ddf, prob_const, df_const, ddf_const
+    double all_sums[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+    runPackets([&](int packet_id, double *packet_sums) {
         VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
         size_t ptn_lower = limits[packet_id];
         size_t ptn_upper = limits[packet_id+1];
@@ -3578,18 +3829,19 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
             }
         } // FOR ptn
         {
-            //These additions don't need to be in a critical section, because of the
-            //reduction(+:all_df,all_ddf,all_prob_const,all_df_const,all_ddf_const)
-            //clause in the omp parallel for.
-            all_df  += horizontal_add(my_df);
-            all_ddf += horizontal_add(my_ddf);
+            //These additions don't need to be in a critical section, because
+            //every packet has its own sums (added up by runPackets).
+            packet_sums[0] += horizontal_add(my_df);
+            packet_sums[1] += horizontal_add(my_ddf);
             if (ASC_Lewis) {
-                all_prob_const += horizontal_add(vc_prob_const);
-                all_df_const   += horizontal_add(vc_df_const);
-                all_ddf_const  += horizontal_add(vc_ddf_const);
+                packet_sums[2] += horizontal_add(vc_prob_const);
+                packet_sums[3] += horizontal_add(vc_df_const);
+                packet_sums[4] += horizontal_add(vc_ddf_const);
             }
         }
-    } // FOR packet
+    }, 5, all_sums); // FOR packet
+    double all_df = all_sums[0], all_ddf = all_sums[1];
+    double all_prob_const = all_sums[2], all_df_const = all_sums[3], all_ddf_const = all_sums[4];
 
     // mark buffer as computed
     theta_computed = true;
@@ -52,6 +52,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        repeat_stamp = -1;
     }
 
     /**
@@ -68,6 +69,7 @@ public:
         partial_pars = NULL;
         direction = UNDEFINED_DIRECTION;
         size = 0;
+        repeat_stamp = -1;
     }
 
     /**
@@ -82,6 +84,7 @@ public:
         partial_pars = NULL;
         direction = nei->direction;
         size = nei->size;
+        repeat_stamp = -1;
     }
 
     
@@ -182,6 +185,18 @@ private:
     /** size of subtree below this neighbor in terms of number of taxa */
     int size;
 
+    /**
+        site repeats: for each pattern the first pattern with the same tip states in the subtree,
+        empty if there are none
+     */
+    vector<int> site_repeats;
+
+    /** stamp of site_repeats, renewed whenever they are recomputed, -1 if not computed */
+    int64_t repeat_stamp;
+
+    /** stamps of the two children that site_repeats was computed from */
+    int64_t repeat_children[2];
+
 };
 
 /**
@@ -35,6 +35,11 @@ PhyloSuperTree::PhyloSuperTree()
 PhyloSuperTree::PhyloSuperTree(SuperAlignment *alignment, bool new_iqtree) :  IQTree(alignment) {
     totalNNIs = evalNNIs = 0;
 
+    if (Params::getInstance().lk_float) {
+        outWarning("Single-precision partial likelihoods (--lk-float) not supported for partition models");
+        Params::getInstance().lk_float = false;
+    }
+
     rescale_codon_brlen = false;
     bool has_codon = false;
     vector<Alignment*>::iterator it;
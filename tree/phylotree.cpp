@@ -27,6 +27,8 @@
 #include "alignment/alignmentsummary.h"
 #include <algorithm>
 #include <limits>
+#include <unordered_map>
+#include <queue>
 #include "utils/timeutil.h"
 #include "utils/pllnni.h"
 #include "phylosupertree.h"
@@ -135,6 +137,10 @@ void PhyloTree::init() {
     num_partial_lh_computations = 0;
     vector_size = 0;
     safe_numeric = false;
+    float_lh = false;
+    site_repeat_counter = (int64_t)1 << 32; // above any leaf ID
+    site_repeat_min_stamp = site_repeat_counter;
+    site_repeat_orig_nptn = site_repeat_nptn = 0;
     summary = nullptr;
     isSummaryBorrowed = false;
     progress = nullptr;
@@ -377,9 +383,65 @@ void PhyloTree::copyPhyloTreeMixlen(PhyloTree *tree, int mix, bool borrowSummary
     }
 }
 
+void PhyloTree::copyTopology(PhyloTree *tree) {
+    if (root) freeNode();
+    leafNum = tree->leafNum;
+    nodeNum = tree->nodeNum;
+    branchNum = tree->branchNum;
+    rooted = tree->rooted;
+    root = copyTopology(tree->root, NULL, NULL);
+    // 2015-10-14: has to reset this pointer when read in
+    current_it = current_it_back = NULL;
+}
+
+Node *PhyloTree::copyTopology(Node *node, Node *dad, Node *new_dad) {
+    Node *new_node = newNode(node->id, node->name.c_str());
+    for (NeighborVec::iterator it = node->neighbors.begin(); it != node->neighbors.end(); it++) {
+        Node *new_nei_node = ((*it)->node == dad) ? new_dad : copyTopology((*it)->node, node, new_node);
+        new_node->addNeighbor(new_nei_node, (*it)->length, (*it)->id);
+        ((PhyloNeighbor*)new_node->neighbors.back())->direction = ((PhyloNeighbor*)*it)->direction;
+    }
+    return new_node;
+}
+
+/** collect nodes of the subtree at node by their ID */
+static void getNodesByID(Node *node, Node *dad, NodeVector &nodes) {
+    nodes[node->id] = node;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        getNodesByID((*it)->node, node, nodes);
+}
+
+void PhyloTree::syncTopology(PhyloTree *tree) {
+    ASSERT(nodeNum == tree->nodeNum);
+    NodeVector nodes(nodeNum, NULL), tree_nodes(nodeNum, NULL);
+    getNodesByID(root, NULL, nodes);
+    getNodesByID(tree->root, NULL, tree_nodes);
+    for (int id = 0; id < nodeNum; id++) {
+        ASSERT(nodes[id]->degree() == tree_nodes[id]->degree());
+        for (int i = 0; i < nodes[id]->degree(); i++) {
+            PhyloNeighbor *nei = (PhyloNeighbor*)nodes[id]->neighbors[i];
+            PhyloNeighbor *tree_nei = (PhyloNeighbor*)tree_nodes[id]->neighbors[i];
+            nei->node = nodes[tree_nei->node->id];
+            nei->length = tree_nei->length;
+            nei->id = tree_nei->id;
+            nei->direction = tree_nei->direction;
+            nei->size = tree_nei->size;
+        }
+    }
+    root = nodes[tree->root->id];
+    // assign the allocated partial likelihoods to the neighbors of the new topology
+    int index, indexlh;
+    initializeAllPartialLh(index, indexlh);
+    int tip_computed = tip_partial_lh_computed;
+    clearAllPartialLH();
+    clearAllSiteRepeats();
+    tip_partial_lh_computed = tip_computed;
+}
+
 #define FAST_NAME_CHECK 1
 void PhyloTree::setAlignment(Alignment *alignment) {
     aln = alignment;
+    clearAllSiteRepeats();
     //double checkStart = getRealTime();
     size_t nseq = aln->getNSeq();
     bool err = false;
@@ -861,6 +923,15 @@ int PhyloTree::computeParsimony() {
  likelihood function
  ****************************************************************************/
 
+bool PhyloTree::isCherryLookup() {
+    size_t num_tip_states = aln->STATE_UNKNOWN+1;
+    // site-specific models never use the table
+    return Params::getInstance().cherry_lookup && !Params::getInstance().buffer_mem_save &&
+        model && !model->isSiteSpecificModel() &&
+        (aln->seq_type == SEQ_DNA || aln->seq_type == SEQ_PROTEIN || aln->seq_type == SEQ_BINARY) &&
+        aln->size() >= 2*num_tip_states*num_tip_states;
+}
+
 size_t PhyloTree::getBufferPartialLhSize() {
     const size_t VECTOR_SIZE = 8; // TODO, adjusted
     // 2017-12-13: make sure that num_threads was already set
@@ -873,6 +944,9 @@ size_t PhyloTree::getBufferPartialLhSize() {
     if (!Params::getInstance().buffer_mem_save) {
         buffer_size += get_safe_upper_limit(block * model->num_states * 2) * aln->getNSeq();
         buffer_size += get_safe_upper_limit(block *(aln->STATE_UNKNOWN+1)) * aln->getNSeq();
+        // traversal_info.partial_lh_cherry, at most one per two taxa
+        if (isCherryLookup())
+            buffer_size += get_safe_upper_limit(block * (aln->STATE_UNKNOWN+1) * (aln->STATE_UNKNOWN+1)) * (aln->getNSeq()/2);
     }
 
     buffer_size += get_safe_upper_limit(block *(aln->STATE_UNKNOWN+1));
@@ -887,6 +961,10 @@ size_t PhyloTree::getBufferPartialLhSize() {
         size_t nmix = max(getMixlen(), getRate()->getNRate());
         buffer_size += nmix*(nmix+1)*VECTOR_SIZE + (nmix+3)*nmix*VECTOR_SIZE*num_packets;
     }
+
+    // staging of single-precision partial likelihoods in double (dad, left, right child)
+    if (float_lh)
+        buffer_size += 3*block*VECTOR_SIZE*num_packets;
     return buffer_size;
 }
 
@@ -962,6 +1040,7 @@ void PhyloTree::deleteAllPartialLh() {
     tip_partial_pars  = nullptr;
 
     clearAllPartialLH();
+    clearAllSiteRepeats();
 }
  
 uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
@@ -994,7 +1073,15 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
     if (model)
         mem_size += model->getMemoryRequired();
 
-    int64_t lh_scale_size = block_size * sizeof(double) + scale_block_size * sizeof(UBYTE);
+    // memory for cherry lookup tables, at most one per two taxa
+    if (isCherryLookup())
+        mem_size += (block_size / nptn) * (aln->STATE_UNKNOWN+1) * (aln->STATE_UNKNOWN+1) * (leafNum/2) * sizeof(double);
+
+    // memory for site repeats of all neighbors pointing to an internal node
+    if (params->site_repeats)
+        mem_size += 3 * leafNum * nptn * sizeof(int);
+
+    int64_t lh_scale_size = block_size * (float_lh ? sizeof(float) : sizeof(double)) + scale_block_size * sizeof(UBYTE);
 
     max_lh_slots = leafNum-2;
 
@@ -1064,6 +1151,9 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
     uint64_t block_size;
     uint64_t scale_block_size = nptn * site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
     block_size = scale_block_size * model->num_states;
+    // single-precision vectors take half the number of doubles
+    if (float_lh)
+        block_size /= 2;
 
     if (!node) {
         node = (PhyloNode*) root;
@@ -1196,6 +1286,9 @@ size_t PhyloTree::getPartialLhSize() {
     size_t block_size = get_safe_upper_limit(aln->size())+max(get_safe_upper_limit(aln->num_states),
         get_safe_upper_limit(model_factory->unobserved_ptns.size()));
     block_size *= model->num_states * site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
+    // single-precision vectors take half the number of doubles
+    if (float_lh)
+        block_size /= 2;
     return block_size;
 }
 
@@ -1261,7 +1354,7 @@ double PhyloTree::computeLikelihood(double *pattern_lh, bool save_log_value) {
         int nptn = aln->getNPattern();
         //double check_score = 0.0;
         for (int i = 0; i < nptn; i++) {
-            pattern_lh[i] += max(current_it->scale_num[i], UBYTE(0)) * LOG_SCALING_THRESHOLD;
+            pattern_lh[i] += max(current_it->scale_num[i], UBYTE(0)) * getLogScalingThreshold();
             //check_score += (pattern_lh[i] * (aln->at(i).frequency));
         }
         /*       if (fabs(score - check_score) > 1e-6) {
@@ -1455,6 +1548,232 @@ void PhyloTree::computePatternStateFreq(double *ptn_state_freq) {
 
 
 
+bool PhyloTree::isRateMatrixGradientSupported() {
+    return !isSuperTree() && !isMixlen() && !isTreeMix() && !float_lh && model_factory &&
+        model == model_factory->model && model->isReversible() && !params->kernel_nonrev &&
+        !model->isMixture() && !model->isSiteSpecificModel() && !site_rate->isHeterotachy() &&
+        model_factory->getASC() == ASC_NONE && model_factory->unobserved_ptns.empty() &&
+        params->lh_mem_save != LM_MEM_SAVE && params->robust_phy_keep >= 1.0 && !params->robust_median;
+}
+
+double PhyloTree::computeRateMatrixGradient(double *grad_Q, double *grad_freq) {
+    ASSERT(root->isLeaf());
+    size_t nstates = aln->num_states;
+    double *grad_eigen = new double[nstates*nstates];
+    memset(grad_eigen, 0, sizeof(double)*nstates*nstates);
+    memset(grad_freq, 0, sizeof(double)*nstates);
+    double tree_lh = 0.0;
+
+    // root is a leaf, branches are directed away from it
+    computeRateMatrixGradient(grad_eigen, grad_freq, tree_lh, (PhyloNode*)root->neighbors[0]->node, (PhyloNode*)root);
+
+    // back to the state space: grad_Q = inv_evec^T * grad_eigen * evec^T
+    double *evec = model->getEigenvectors();
+    double *inv_evec = model->getInverseEigenvectors();
+    double *tmp = new double[nstates*nstates];
+    size_t i, j, x, y;
+    for (i = 0; i < nstates; i++)
+        for (y = 0; y < nstates; y++) {
+            double sum = 0.0;
+            for (j = 0; j < nstates; j++)
+                sum += grad_eigen[i*nstates+j] * evec[y*nstates+j];
+            tmp[i*nstates+y] = sum;
+        }
+    for (x = 0; x < nstates; x++)
+        for (y = 0; y < nstates; y++) {
+            double sum = 0.0;
+            for (i = 0; i < nstates; i++)
+                sum += inv_evec[i*nstates+x] * tmp[i*nstates+y];
+            grad_Q[x*nstates+y] = sum;
+        }
+    delete [] tmp;
+    delete [] grad_eigen;
+    return tree_lh;
+}
+
+void PhyloTree::computeRateMatrixGradient(double *grad_eigen, double *grad_freq, double &tree_lh, PhyloNode *node, PhyloNode *dad) {
+    PhyloNeighbor *dad_branch = (PhyloNeighbor*)dad->findNeighbor(node);
+    PhyloNeighbor *node_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+
+    // make partial likelihoods of both sides available, as for branch length optimization
+    tree_lh = computeLikelihoodBranch(dad_branch, dad);
+
+    size_t nstates = aln->num_states;
+    size_t nstates2 = nstates*nstates;
+    size_t ncat = site_rate->getNRate();
+    size_t block = ncat*nstates;
+    size_t nptn = aln->size();
+    size_t vsize = vector_size;
+    double *eval = model->getEigenvalues();
+    double *evec = model->getEigenvectors();
+    bool is_root = (dad == root);
+
+    // upper (root) side is alpha, lower side is beta, both in eigen coordinates (inv_evec * partial)
+    double *alpha_lh = dad->isLeaf() ? NULL : node_branch->partial_lh;
+    double *beta_lh = node->isLeaf() ? NULL : dad_branch->partial_lh;
+    UBYTE *alpha_scale = dad->isLeaf() ? NULL : node_branch->scale_num;
+    UBYTE *beta_scale = node->isLeaf() ? NULL : dad_branch->scale_num;
+
+    double *cat_rate = new double[ncat];
+    double *cat_prop = new double[ncat];
+    double *val = new double[block];
+    for (size_t c = 0; c < ncat; c++) {
+        cat_rate[c] = site_rate->getRate(c) * dad_branch->length;
+        cat_prop[c] = site_rate->getProp(c);
+        for (size_t i = 0; i < nstates; i++)
+            val[c*nstates+i] = exp(eval[i]*cat_rate[c]) * cat_prop[c];
+    }
+
+    // W[c][i][j] = sum over patterns of freq * alpha[c][i] * beta[c][j] / lh
+    double *W = new double[ncat*nstates2];
+    memset(W, 0, sizeof(double)*ncat*nstates2);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+    {
+        double *my_W = new double[ncat*nstates2];
+        double *my_grad_freq = new double[nstates];
+        double *alpha = new double[block];
+        double *beta = new double[block];
+        double *cat_scale = new double[ncat];
+        int *sum_scale = new int[ncat];
+        double *tip_state = new double[nstates];
+        memset(my_W, 0, sizeof(double)*ncat*nstates2);
+        memset(my_grad_freq, 0, sizeof(double)*nstates);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (size_t ptn = 0; ptn < nptn; ptn++) {
+            if (ptn_freq[ptn] == 0.0)
+                continue;
+            size_t lane = ptn % vsize;
+            size_t ptn_block = (ptn - lane) * block;
+            size_t c, i, j;
+            // gather both sides, tips are the same for all categories
+            if (alpha_lh) {
+                for (i = 0; i < block; i++)
+                    alpha[i] = alpha_lh[ptn_block + i*vsize + lane];
+            } else {
+                double *tip = tip_partial_lh + aln->at(ptn)[dad->id]*nstates;
+                for (c = 0; c < ncat; c++)
+                    memcpy(alpha + c*nstates, tip, sizeof(double)*nstates);
+            }
+            if (beta_lh) {
+                for (i = 0; i < block; i++)
+                    beta[i] = beta_lh[ptn_block + i*vsize + lane];
+            } else {
+                double *tip = tip_partial_lh + aln->at(ptn)[node->id]*nstates;
+                for (c = 0; c < ncat; c++)
+                    memcpy(beta + c*nstates, tip, sizeof(double)*nstates);
+            }
+
+            // categories scaled more than the least scaled one, as in computeLikelihoodBranch
+            if (safe_numeric) {
+                int min_scale = INT_MAX;
+                for (c = 0; c < ncat; c++) {
+                    sum_scale[c] = (alpha_scale ? alpha_scale[ptn*ncat+c] : 0) + (beta_scale ? beta_scale[ptn*ncat+c] : 0);
+                    min_scale = min(min_scale, sum_scale[c]);
+                }
+                for (c = 0; c < ncat; c++)
+                    cat_scale[c] = (sum_scale[c] == min_scale) ? 1.0 : ((sum_scale[c] == min_scale+1) ? SCALING_THRESHOLD : 0.0);
+            } else {
+                for (c = 0; c < ncat; c++)
+                    cat_scale[c] = 1.0;
+            }
+
+            double lh_ptn = 0.0;
+            for (c = 0; c < ncat; c++) {
+                double lh_cat = 0.0;
+                for (i = 0; i < nstates; i++)
+                    lh_cat += val[c*nstates+i] * alpha[c*nstates+i] * beta[c*nstates+i];
+                lh_ptn += lh_cat * cat_scale[c];
+            }
+            lh_ptn = fabs(lh_ptn) + ptn_invar[ptn];
+            double weight = ptn_freq[ptn] / lh_ptn;
+
+            for (c = 0; c < ncat; c++) {
+                if (cat_scale[c] == 0.0)
+                    continue;
+                double *this_W = my_W + c*nstates2;
+                double *this_alpha = alpha + c*nstates;
+                double *this_beta = beta + c*nstates;
+                double cat_weight = weight * cat_scale[c];
+                for (i = 0; i < nstates; i++) {
+                    double a = cat_weight * this_alpha[i];
+                    for (j = 0; j < nstates; j++)
+                        this_W[i*nstates+j] += a * this_beta[j];
+                }
+            }
+
+            if (is_root) {
+                // root frequencies: dL/dpi[x] = tip[x] * (evec * exp(eval*t) * beta)[x]
+                for (size_t x = 0; x < nstates; x++) {
+                    double sum = 0.0;
+                    for (i = 0; i < nstates; i++)
+                        sum += evec[x*nstates+i] * alpha[i];
+                    tip_state[x] = sum;
+                }
+                for (c = 0; c < ncat; c++) {
+                    if (cat_scale[c] == 0.0)
+                        continue;
+                    for (size_t x = 0; x < nstates; x++) {
+                        if (tip_state[x] == 0.0)
+                            continue;
+                        double sum = 0.0;
+                        for (i = 0; i < nstates; i++)
+                            sum += evec[x*nstates+i] * val[c*nstates+i] * beta[c*nstates+i];
+                        my_grad_freq[x] += weight * cat_scale[c] * tip_state[x] * sum;
+                    }
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (size_t i = 0; i < ncat*nstates2; i++)
+                W[i] += my_W[i];
+            for (size_t i = 0; i < nstates; i++)
+                grad_freq[i] += my_grad_freq[i];
+        }
+        delete [] tip_state;
+        delete [] sum_scale;
+        delete [] cat_scale;
+        delete [] beta;
+        delete [] alpha;
+        delete [] my_grad_freq;
+        delete [] my_W;
+    }
+
+    // d exp(Q*t) = evec * (F o (inv_evec * dQ * evec)) * inv_evec, with
+    // F[i][j] = (exp(eval[i]*t) - exp(eval[j]*t)) / (eval[i]-eval[j]), or t*exp(eval[i]*t) if equal
+    for (size_t c = 0; c < ncat; c++) {
+        double t = cat_rate[c];
+        double *this_W = W + c*nstates2;
+        for (size_t i = 0; i < nstates; i++) {
+            double exp_i = exp(eval[i]*t);
+            for (size_t j = 0; j < nstates; j++) {
+                double diff = eval[i] - eval[j];
+                double F;
+                if (fabs(diff*t) < 1e-8)
+                    F = t * exp_i;
+                else
+                    F = (exp_i - exp(eval[j]*t)) / diff;
+                grad_eigen[i*nstates+j] += cat_prop[c] * F * this_W[i*nstates+j];
+            }
+        }
+    }
+
+    delete [] W;
+    delete [] val;
+    delete [] cat_prop;
+    delete [] cat_rate;
+
+    FOR_NEIGHBOR_IT(node, dad, it)
+        computeRateMatrixGradient(grad_eigen, grad_freq, tree_lh, (PhyloNode*)(*it)->node, node);
+}
+
 void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, double *ptn_lh_cat, SiteLoglType wsl) {
     /*    if (!dad_branch) {
      dad_branch = (PhyloNeighbor*) root->neighbors[0];
@@ -1473,16 +1792,16 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
     if (sum_scaling < 0.0) {
         if (current_it->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it_back->scale_num[i])) * getLogScalingThreshold();
             }
         } else if (current_it_back->lh_scale_factor == 0.0){
             for (i = 0; i < nptn; i++) {
-                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i])) * getLogScalingThreshold();
             }
         } else {
             for (i = 0; i < nptn; i++) {
                 ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i]) +
-                    max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                    max(UBYTE(0), current_it_back->scale_num[i])) * getLogScalingThreshold();
             }
         }
     } else {
@@ -1502,20 +1821,20 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             }
         } else if (current_it->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                double scale = (max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                double scale = (max(UBYTE(0), current_it_back->scale_num[i])) * getLogScalingThreshold();
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
         } else if (current_it_back->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                double scale = (max(UBYTE(0), current_it->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                double scale = (max(UBYTE(0), current_it->scale_num[i])) * getLogScalingThreshold();
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
         } else {
             for (i = 0; i < nptn; i++) {
                 double scale = (max(UBYTE(0), current_it->scale_num[i]) +
-                        max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                        max(UBYTE(0), current_it_back->scale_num[i])) * getLogScalingThreshold();
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
@@ -1543,7 +1862,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             // per-category scaling
             for (ptn = 0; ptn < nptn; ptn++) {
                 for (i = 0; i < ncat; i++) {
-                    out_lh_cat[i] = log(lh_cat[i]) + nei2_scale[i] * LOG_SCALING_THRESHOLD;
+                    out_lh_cat[i] = log(lh_cat[i]) + nei2_scale[i] * getLogScalingThreshold();
                 }
                 lh_cat += ncat;
                 out_lh_cat += ncat;
@@ -1552,7 +1871,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
         } else {
             // normal scaling
             for (ptn = 0; ptn < nptn; ptn++) {
-                double scale = nei2_scale[ptn] * LOG_SCALING_THRESHOLD;
+                double scale = nei2_scale[ptn] * getLogScalingThreshold();
                 for (i = 0; i < ncat; i++)
                     out_lh_cat[i] = log(lh_cat[i]) + scale;
                 lh_cat += ncat;
@@ -1569,7 +1888,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             // per-category scaling
             for (ptn = 0; ptn < nptn; ptn++) {
                 for (i = 0; i < ncat; i++) {
-                    out_lh_cat[i] = log(lh_cat[i]) + (nei1_scale[i]+nei2_scale[i]) * LOG_SCALING_THRESHOLD;
+                    out_lh_cat[i] = log(lh_cat[i]) + (nei1_scale[i]+nei2_scale[i]) * getLogScalingThreshold();
                 }
                 lh_cat += ncat;
                 out_lh_cat += ncat;
@@ -1579,7 +1898,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
         } else {
             // normal scaling
             for (ptn = 0; ptn < nptn; ptn++) {
-                double scale = (nei1_scale[ptn] + nei2_scale[ptn]) * LOG_SCALING_THRESHOLD;
+                double scale = (nei1_scale[ptn] + nei2_scale[ptn]) * getLogScalingThreshold();
                 for (i = 0; i < ncat; i++)
                     out_lh_cat[i] = log(lh_cat[i]) + scale;
                 lh_cat += ncat;
@@ -4035,6 +4354,42 @@ void PhyloTree::doNNI(NNIMove &move, bool clearLH) {
     }
 }
 
+void PhyloTree::clearNNIPartialLh(vector<NNIMove> &moves) {
+    vector<bool> nni_node(nodeNum, false);
+    int num_nni_nodes = 0;
+    for (auto it = moves.begin(); it != moves.end(); it++) {
+        PhyloNode *nodes[2] = {it->node1, it->node2};
+        for (PhyloNode *node : nodes)
+            if (!nni_node[node->id]) {
+                nni_node[node->id] = true;
+                num_nni_nodes++;
+            }
+    }
+    if (num_nni_nodes == 0)
+        return;
+    clearNNIPartialLh(nni_node, num_nni_nodes, (PhyloNode*)root->neighbors[0]->node, (PhyloNode*)root);
+}
+
+int PhyloTree::clearNNIPartialLh(vector<bool> &nni_node, int num_nni_nodes, PhyloNode *node, PhyloNode *dad) {
+    int num_below = nni_node[node->id] ? 1 : 0;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        num_below += clearNNIPartialLh(nni_node, num_nni_nodes, (PhyloNode*)(*it)->node, node);
+
+    // subtree at node changed
+    if (num_below > 0) {
+        PhyloNeighbor *nei = (PhyloNeighbor*)dad->findNeighbor(node);
+        nei->clearPartialLh();
+        nei->size = 0;
+    }
+    // subtree at dad changed
+    if (num_below < num_nni_nodes) {
+        PhyloNeighbor *nei = (PhyloNeighbor*)node->findNeighbor(dad);
+        nei->clearPartialLh();
+        nei->size = 0;
+    }
+    return num_below;
+}
+
 void PhyloTree::changeNNIBrans(NNIMove &nnimove) {
     PhyloNode *node1 = nnimove.node1;
     PhyloNode *node2 = nnimove.node2;
@@ -5915,6 +6270,195 @@ void PhyloTree::reorientPartialLh(PhyloNeighbor* dad_branch, Node *dad) {
         helper functions for computing tree traversal
  ****************************************************************************/
 
+ThreadPool *PhyloTree::getThreadPool() {
+    // sized for the whole run, trees of partitions may use fewer threads
+    return ThreadPool::getInstance(max(num_threads, Params::getInstance().num_threads));
+}
+
+void PhyloTree::getTraversalParents(vector<int> &parent) {
+    int num_info = traversal_info.size();
+    parent.assign(num_info, -1);
+    if (params->lh_mem_save == LM_MEM_SAVE) {
+        // later steps may take over the memory slots of consumed children,
+        // so every step has to wait for the one before
+        for (int i = 0; i+1 < num_info; i++) {
+            parent[i] = i+1;
+        }
+        return;
+    }
+    // every node is the root of at most one step; the step of dad is the parent
+    // unless it points back (the two steps at both ends of the central branch)
+    unordered_map<Node*, int> step_of_node;
+    step_of_node.reserve(num_info);
+    for (int i = 0; i < num_info; i++) {
+        step_of_node[traversal_info[i].dad_branch->node] = i;
+    }
+    for (int i = 0; i < num_info; i++) {
+        auto it = step_of_node.find(traversal_info[i].dad);
+        if (it != step_of_node.end() &&
+            traversal_info[it->second].dad != traversal_info[i].dad_branch->node) {
+            parent[i] = it->second;
+        }
+    }
+}
+
+void PhyloTree::computeTraversalGraph(const vector<size_t> &limits) {
+    int num_info = traversal_info.size();
+    if (num_info == 0) {
+        return;
+    }
+    vector<int> parent;
+    getTraversalParents(parent);
+    // task (step, packet) = step*num_packets + packet; a step only waits for
+    // the same packet of its child steps
+    int num_tasks = num_info*num_packets;
+    vector<int> num_deps(num_tasks, 0);
+    vector<int> succ_index(num_tasks+1);
+    vector<int> succ_list;
+    succ_list.reserve(num_tasks);
+    for (int i = 0; i < num_info; i++) {
+        for (int packet = 0; packet < num_packets; packet++) {
+            succ_index[i*num_packets + packet] = succ_list.size();
+            if (parent[i] >= 0) {
+                int succ = parent[i]*num_packets + packet;
+                succ_list.push_back(succ);
+                num_deps[succ]++;
+            }
+        }
+    }
+    succ_index[num_tasks] = succ_list.size();
+    // a thread works on one task at a time, so its id selects the scratch buffer
+    getThreadPool()->runGraph(num_tasks, num_deps.data(), succ_index.data(), succ_list.data(),
+        [&](int task, int thread_id) {
+            int packet = task % num_packets;
+            computePartialLikelihood(traversal_info[task / num_packets],
+                                     limits[packet], limits[packet+1], thread_id);
+        }, num_threads);
+    traversal_info.clear();
+}
+
+/** fixed cost of one partial likelihood kernel call, counted in patterns */
+#define TRAVERSAL_CALL_COST 32
+
+void PhyloTree::computeTraversalSubtrees(size_t nptn, size_t vsize) {
+    int num_info = traversal_info.size();
+    // memory saving needs traversal order (see getTraversalParents)
+    if (num_threads <= 1 || num_info < 2*num_threads || params->lh_mem_save == LM_MEM_SAVE) {
+        return;
+    }
+    vector<int> parent;
+    getTraversalParents(parent);
+    // the steps of a subtree are contiguous in traversal_info and end at its root step;
+    // count steps rather than PhyloNeighbor::size, which includes already computed subtrees
+    vector<int> subtree_steps(num_info, 1);
+    for (int i = 0; i < num_info; i++) {
+        if (parent[i] >= 0) {
+            subtree_steps[parent[i]] += subtree_steps[i];
+        }
+    }
+    // cost model in pattern units: with pattern-level parallelism every thread runs
+    // num_packets/num_threads calls per step; with k pattern chunks per subtree the
+    // subtree tasks take about max(total work / threads, largest task)
+    double packets_per_thread = (double)num_packets / num_threads;
+    double step_cost = (double)nptn/num_threads + packets_per_thread*TRAVERSAL_CALL_COST;
+    double best_cost = num_info * step_cost;
+    int best_chunks = 0, best_splits = 0;
+
+    // repeatedly split the largest subtree; the roots that were split are computed
+    // afterwards with pattern-level parallelism. Keep the cheapest stage.
+    priority_queue<pair<int, int> > subtrees;
+    auto split_largest = [&]() {
+        int root = subtrees.top().second;
+        subtrees.pop();
+        for (int child = root-1; child > root-subtree_steps[root]; child -= subtree_steps[child]) {
+            subtrees.push(make_pair(subtree_steps[child], child));
+        }
+    };
+    for (int i = 0; i < num_info; i++) {
+        if (parent[i] < 0) {
+            subtrees.push(make_pair(subtree_steps[i], i));
+        }
+    }
+    for (int num_top = 0; ; num_top++) {
+        for (int chunks = 1; chunks <= num_packets; chunks *= 2) {
+            double chunk_cost = (double)nptn/chunks + TRAVERSAL_CALL_COST;
+            double cost = max((double)(num_info-num_top) * chunk_cost * chunks / num_threads,
+                              subtrees.top().first * chunk_cost) + num_top * step_cost;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_chunks = chunks;
+                best_splits = num_top;
+            }
+        }
+        if ((int)subtrees.size() >= 2*num_threads || subtrees.top().first == 1) {
+            break;
+        }
+        split_largest();
+    }
+    if (best_chunks == 0) {
+        return;
+    }
+    // replay the splits of the cheapest stage
+    subtrees = priority_queue<pair<int, int> >();
+    for (int i = 0; i < num_info; i++) {
+        if (parent[i] < 0) {
+            subtrees.push(make_pair(subtree_steps[i], i));
+        }
+    }
+    for (int split = 0; split < best_splits; split++) {
+        split_largest();
+    }
+    vector<int> roots;
+    while (!subtrees.empty()) {
+        roots.push_back(subtrees.top().second);
+        subtrees.pop();
+    }
+
+    vector<size_t> chunk_limits(best_chunks+1);
+    for (int chunk = 0; chunk < best_chunks; chunk++) {
+        chunk_limits[chunk] = (nptn/vsize) * chunk / best_chunks * vsize;
+    }
+    chunk_limits[best_chunks] = nptn;
+    // largest subtrees first; a thread owns a whole subtree (chunk), so its id selects the scratch buffer
+    auto compute_subtree = [&](int task, int thread_id) {
+        int root = roots[task / best_chunks];
+        int chunk = task % best_chunks;
+        for (int step = root-subtree_steps[root]+1; step <= root; step++) {
+            computePartialLikelihood(traversal_info[step], chunk_limits[chunk], chunk_limits[chunk+1], thread_id);
+        }
+    };
+    int num_tasks = roots.size()*best_chunks;
+    if (isThreadPool()) {
+        getThreadPool()->parallelFor(num_tasks, compute_subtree, num_threads);
+    } else {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads)
+        for (int task = 0; task < num_tasks; task++) {
+            compute_subtree(task, omp_get_thread_num());
+        }
+#else
+        for (int task = 0; task < num_tasks; task++) {
+            compute_subtree(task, 0);
+        }
+#endif
+    }
+
+    // keep only the steps above the subtrees
+    vector<bool> done(num_info, false);
+    for (int root : roots) {
+        for (int step = root-subtree_steps[root]+1; step <= root; step++) {
+            done[step] = true;
+        }
+    }
+    int num_left = 0;
+    for (int i = 0; i < num_info; i++) {
+        if (!done[i]) {
+            traversal_info[num_left++] = traversal_info[i];
+        }
+    }
+    traversal_info.erase(traversal_info.begin()+num_left, traversal_info.end());
+}
+
 bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad, double* &buffer) {
 
     size_t nstates = aln->num_states;
@@ -5954,7 +6498,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
 
     // prepare information for this branch
     TraversalInfo info(dad_branch, dad);
-    info.echildren = info.partial_lh_leaves = NULL;
+    info.echildren = info.partial_lh_leaves = info.partial_lh_cherry = NULL;
 
     // re-orient partial_lh
     reorientPartialLh(dad_branch, dad);
@@ -6013,6 +6557,9 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
         }
     }
 
+    if (isSiteRepeats())
+        computeSiteRepeats(dad_branch, dad);
+
     if (!model->isSiteSpecificModel() && !Params::getInstance().buffer_mem_save) {
         //------- normal model -----
         info.echildren = buffer;
@@ -6022,11 +6569,116 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
             info.partial_lh_leaves = buffer;
             buffer += get_safe_upper_limit((aln->STATE_UNKNOWN+1)*block*num_leaves);
         }
+        if (num_leaves == 2 && node->degree() == 3 && model->useRevKernel() && isCherryLookup()) {
+            info.partial_lh_cherry = buffer;
+            buffer += get_safe_upper_limit((aln->STATE_UNKNOWN+1)*(aln->STATE_UNKNOWN+1)*block);
+        }
     }
     traversal_info.push_back(info);
     return mem_slots.lock(dad_branch);
 }
 
+bool PhyloTree::isSiteRepeats() {
+    return params && params->site_repeats && model && model->useRevKernel() &&
+        !model->isSiteSpecificModel() && vector_size > 0;
+}
+
+void PhyloTree::computeSiteRepeats(PhyloNeighbor *dad_branch, PhyloNode *dad) {
+    PhyloNode *node = (PhyloNode*)dad_branch->node;
+    if (node->isLeaf())
+        return;
+    size_t orig_nptn = aln->size();
+    size_t max_orig_nptn = roundUpToMultiple(orig_nptn, vector_size);
+    size_t nptn = roundUpToMultiple(max_orig_nptn + model_factory->unobserved_ptns.size(), vector_size);
+    if (max_orig_nptn != site_repeat_orig_nptn || nptn != site_repeat_nptn) {
+        // pattern layout has changed
+        site_repeat_orig_nptn = max_orig_nptn;
+        site_repeat_nptn = nptn;
+        clearAllSiteRepeats();
+    }
+
+    // stamps of the children, leaf ID for tips
+    PhyloNeighbor *children[2] = {NULL, NULL};
+    int64_t stamps[2] = {-1, -1};
+    int num_children = 0;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNeighbor *child = (PhyloNeighbor*)*it;
+        if (num_children < 2) {
+            children[num_children] = child;
+            if (child->node->isLeaf()) {
+                stamps[num_children] = child->node->id;
+            } else {
+                if (child->repeat_stamp < site_repeat_min_stamp)
+                    computeSiteRepeats(child, node);
+                stamps[num_children] = child->repeat_stamp;
+            }
+        }
+        num_children++;
+    }
+    if (dad_branch->repeat_stamp >= site_repeat_min_stamp && num_children == 2 &&
+        dad_branch->repeat_children[0] == stamps[0] && dad_branch->repeat_children[1] == stamps[1])
+        return; // subtree did not change
+
+    dad_branch->repeat_stamp = ++site_repeat_counter;
+    dad_branch->repeat_children[0] = stamps[0];
+    dad_branch->repeat_children[1] = stamps[1];
+    dad_branch->site_repeats.clear();
+    if (num_children != 2) {
+        // no site repeats for multifurcating nodes
+        return;
+    }
+
+    // class of a pattern in a subtree: tip state or the first pattern of the repeat
+    int *child_classes[2];
+    vector<int> tip_classes[2];
+    for (int k = 0; k < 2; k++) {
+        PhyloNeighbor *child = children[k];
+        if (child->node->isLeaf()) {
+            tip_classes[k].resize(nptn, aln->STATE_UNKNOWN);
+            for (size_t ptn = 0; ptn < orig_nptn; ptn++)
+                tip_classes[k][ptn] = aln->at(ptn)[child->node->id];
+            for (size_t ptn = max_orig_nptn; ptn < max_orig_nptn + model_factory->unobserved_ptns.size(); ptn++)
+                tip_classes[k][ptn] = model_factory->unobserved_ptns[ptn-max_orig_nptn][child->node->id];
+            child_classes[k] = &tip_classes[k][0];
+        } else if (child->site_repeats.empty()) {
+            // every pattern is its own class
+            tip_classes[k].resize(nptn);
+            for (size_t ptn = 0; ptn < nptn; ptn++)
+                tip_classes[k][ptn] = ptn;
+            child_classes[k] = &tip_classes[k][0];
+        } else {
+            child_classes[k] = &child->site_repeats[0];
+        }
+    }
+
+    // open-addressing hash table from the pair of child classes to the first pattern
+    int64_t num_classes = max((int64_t)nptn, (int64_t)aln->STATE_UNKNOWN+1);
+    size_t hash_size = 1;
+    while (hash_size < 2*nptn)
+        hash_size <<= 1;
+    vector<int> first_ptn(hash_size, -1);
+    vector<int> &site_repeats = dad_branch->site_repeats;
+    site_repeats.resize(nptn);
+    size_t num_repeats = 0;
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        int c0 = child_classes[0][ptn], c1 = child_classes[1][ptn];
+        uint64_t key = c0 * num_classes + c1;
+        size_t pos = ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (hash_size-1);
+        while (first_ptn[pos] >= 0 &&
+            (child_classes[0][first_ptn[pos]] != c0 || child_classes[1][first_ptn[pos]] != c1))
+            pos = (pos+1) & (hash_size-1);
+        if (first_ptn[pos] < 0)
+            first_ptn[pos] = ptn;
+        else
+            num_repeats++;
+        site_repeats[ptn] = first_ptn[pos];
+    }
+    if (num_repeats == 0) {
+        // nothing to save
+        site_repeats.clear();
+    }
+}
+
 void PhyloTree::writeSiteLh(ostream &out, SiteLoglType wsl, int partid) {
     // error checking
     if (isTreeMix()) {
@@ -47,6 +47,7 @@
 #include "constrainttree.h"
 #include "memslot.h"
 #include "utils/progress.h"
+#include "utils/threadpool.h"
 
 class AlignmentPairwise;
 
@@ -79,6 +80,16 @@ const double TOL_LIKELIHOOD_PARAMOPT = 0.001; // BQM: newly introduced for Model
 //#define LOG_SCALING_THRESHOLD log(SCALING_THRESHOLD)
 #define LOG_SCALING_THRESHOLD -177.4456782233459932741
 
+// scaling for single-precision partial likelihoods: float only goes down to 2^{-126},
+// so vectors are rescaled earlier and by a smaller factor of 2^{64}
+#define SCALING_THRESHOLD_FLOAT_EXP 64
+// 2^{-64}
+#define SCALING_THRESHOLD_FLOAT 5.421010862427522170037e-20
+#define LOG_SCALING_THRESHOLD_FLOAT -44.36141955583649980270
+
+/* maximal number of scaling units applied to a pattern at once by --lk-exp-scaling */
+#define EXP_SCALING_MAX_UNITS 4
+
 const int SPR_DEPTH = 2;
 
 //using namespace Eigen;
@@ -323,6 +334,8 @@ public:
     PhyloNode *dad;
     double *echildren;
     double *partial_lh_leaves;
+    // partial likelihoods of a cherry for all pairs of tip states, NULL if not used
+    double *partial_lh_cherry;
 
     TraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad) {
         this->dad = dad;
@@ -455,6 +468,27 @@ public:
      */
     virtual void copyPhyloTreeMixlen(PhyloTree *tree, int mix, bool borrowSummary);
 
+    /**
+            copy the topology of a tree with the same node IDs, neighbor order, branch IDs and
+            (exact) branch lengths, without going through a tree string like copyTree
+            @param tree the tree to copy
+     */
+    void copyTopology(PhyloTree *tree);
+
+    /**
+            recursive part of copyTopology
+            @return copy of node
+     */
+    Node *copyTopology(Node *node, Node *dad, Node *new_dad);
+
+    /**
+            make topology and branch lengths equal to those of a tree with the same node IDs and
+            node degrees (e.g. a copyTopology source after NNIs), reusing the nodes and the allocated
+            partial likelihoods; tip partial likelihoods are kept as the model is the same
+            @param tree the tree to synchronize with
+     */
+    void syncTopology(PhyloTree *tree);
+
 
     /**
             Set the alignment, important to compute parsimony or likelihood score
@@ -613,6 +647,23 @@ public:
 
     double dotProductDoubleCall(double *x, double *y, int size);
 
+    /**
+        RELL log-likelihoods of several trees on several bootstrap samples, blocked over
+        patterns and samples so that each tile of pattern log-likelihoods is reused across samples
+        @param tree_lh ntrees rows of pattern log-likelihoods, rows are stride apart
+        @param ntrees number of trees
+        @param stride distance between two rows of tree_lh
+        @param samples nsamples rows of bootstrap pattern frequencies
+        @param nsamples number of samples
+        @param size number of patterns
+        @param[out] rell rell[s*ntrees+t] is the log-likelihood of tree t on sample s
+    */
+    template <class Numeric, class VectorClass>
+    void rellProductSIMD(Numeric *tree_lh, int ntrees, size_t stride, Numeric **samples, int nsamples, int size, double *rell);
+
+    typedef void (PhyloTree::*RellProductType)(BootValType *tree_lh, int ntrees, size_t stride, BootValType **samples, int nsamples, int size, double *rell);
+    RellProductType rellProduct;
+
 #if defined(BINARY32) || defined(__NOAVX__)
     void setDotProductAVX() {}
     void setDotProductFMA() {}
@@ -762,6 +813,12 @@ public:
 
     size_t getBufferPartialLhSize();
 
+    /**
+        @return true if cherries use a lookup table over all pairs of tip states (--cherry-lookup),
+        which pays off if there are more patterns than state pairs
+     */
+    bool isCherryLookup();
+
     /**
             initialize partial_lh vector of all PhyloNeighbors, allocating central_partial_lh
      */
@@ -834,12 +891,110 @@ public:
     /** true if using safe numeric for likelihood kernel */
     bool safe_numeric;
 
+    /** true if partial likelihood vectors are stored in single precision (float) */
+    bool float_lh;
+
+    /** @return log of the scaling factor counted by one unit of scale_num */
+    inline double getLogScalingThreshold() {
+        return float_lh ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
+    }
+
+    /** counter to generate PhyloNeighbor::repeat_stamp */
+    int64_t site_repeat_counter;
+
+    /** site repeats with a smaller stamp are outdated */
+    int64_t site_repeat_min_stamp;
+
+    /** pattern layout (rounded number of original and all patterns) of the current site repeats */
+    size_t site_repeat_orig_nptn, site_repeat_nptn;
+
+    /** @return true if partial likelihoods of repeated subtree patterns are copied instead of computed */
+    bool isSiteRepeats();
+
+    /** invalidate site repeats of all neighbors */
+    inline void clearAllSiteRepeats() {
+        site_repeat_min_stamp = ++site_repeat_counter;
+    }
+
+    /**
+        compute the site repeats of dad_branch if its subtree has changed since the last time,
+        outdated site repeats of the child neighbors are recomputed first
+        @param dad_branch branch leading to the subtree
+        @param dad its dad, used to direct the traversal
+     */
+    void computeSiteRepeats(PhyloNeighbor *dad_branch, PhyloNode *dad);
+
     /** number of threads used for likelihood kernel */
     int num_threads;
 
     /** number of packets used for likelihood kernel (typically more) */
     int num_packets;
 
+    /** @return true if multithreaded likelihood kernels run on the thread pool instead of OpenMP */
+    inline bool isThreadPool() {
+        return num_threads > 1 && Params::getInstance().thread_pool;
+    }
+
+    /**
+        @return the process-wide thread pool (--thread-pool), shared with all other trees;
+        pass num_threads to its jobs so that thread ids stay within this tree's buffers
+    */
+    ThreadPool *getThreadPool();
+
+    /**
+        run packet_func(packet_id, packet_sums) for every pattern packet, either on the
+        thread pool or in an OpenMP parallel loop, then add the per-packet sums to sums
+        in packet order
+        @param packet_func function computing one packet
+        @param num_sums number of partial sums written by each packet
+        @param[in,out] sums totals the partial sums are added to
+    */
+    template <class PacketFunc>
+    void runPackets(PacketFunc packet_func, int num_sums = 0, double *sums = NULL) {
+        vector<double> packet_sums(num_packets*num_sums + 1, 0.0);
+        if (isThreadPool()) {
+            getThreadPool()->parallelFor(num_packets, [&](int packet_id, int thread_id) {
+                packet_func(packet_id, &packet_sums[packet_id*num_sums]);
+            }, num_threads);
+        } else {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_threads)
+#endif
+            for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+                packet_func(packet_id, &packet_sums[packet_id*num_sums]);
+            }
+        }
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+            for (int i = 0; i < num_sums; i++) {
+                sums[i] += packet_sums[packet_id*num_sums + i];
+            }
+        }
+    }
+
+    /**
+        get the step of traversal_info that consumes the result of each step
+        @param[out] parent index of the consuming step, -1 for the steps at the central branch
+    */
+    void getTraversalParents(vector<int> &parent);
+
+    /**
+        tree-level parallelism (--subtree-tasks): split traversal_info into subtrees and,
+        if a cost model based on subtree and pattern counts favours it, compute each
+        subtree (or pattern chunk of it) in one task by one thread. Only the steps above
+        the subtrees are left in traversal_info for pattern-level parallelism.
+        @param nptn number of patterns rounded up to vsize
+        @param vsize SIMD vector size of the kernel
+    */
+    void computeTraversalSubtrees(size_t nptn, size_t vsize);
+
+    /**
+        compute partial likelihoods of traversal_info on the thread pool as a graph of
+        (traversal step, packet) tasks, so that steps of independent subtrees run
+        concurrently; traversal_info is cleared afterwards
+        @param limits pattern bounds of the packets
+    */
+    void computeTraversalGraph(const vector<size_t> &limits);
+
     /****************************************************************************
             helper functions for computing tree traversal
      ****************************************************************************/
@@ -915,10 +1070,10 @@ public:
     template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     void computeNonrevPartialLikelihoodSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computePartialLikelihoodSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
     /*
@@ -968,10 +1123,10 @@ public:
     template<class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     double computeNonrevLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, bool save_log_value = true);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, bool save_log_value = true);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, bool save_log_value = true);
 
     /*
@@ -1003,10 +1158,10 @@ public:
 //    template <class VectorClass, const int VCSIZE, const int nstates>
 //    double computeLikelihoodFromBufferEigenSIMD();
 
-    template <class VectorClass, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodFromBufferSIMD();
 
-    template <class VectorClass, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodFromBufferGenericSIMD();
 
     /*
@@ -1065,6 +1220,30 @@ public:
     */
     void computePatternStateFreq(double *ptn_state_freq);
 
+    /**
+        @return TRUE if computeRateMatrixGradient() supports the current tree and model:
+        a single reversible model without mixtures, ascertainment correction or -mem limit
+    */
+    bool isRateMatrixGradientSupported();
+
+    /**
+        compute the gradient of the tree log-likelihood w.r.t. the rate matrix and the root
+        state frequencies in one pass over all branches, using the partial likelihoods of
+        both sides of each branch and the eigensystem of the model
+        @param[out] grad_Q gradient w.r.t. entries of the rate matrix (num_states*num_states)
+        @param[out] grad_freq gradient w.r.t. state frequencies at the root (num_states)
+        @return tree log-likelihood
+    */
+    double computeRateMatrixGradient(double *grad_Q, double *grad_freq);
+
+    /**
+        add contribution of branch (node, dad) and its subtree below node to computeRateMatrixGradient
+        @param grad_eigen gradient accumulated in eigen coordinates
+        @param grad_freq gradient w.r.t. root frequencies, only updated at the root branch
+        @param[out] tree_lh tree log-likelihood
+    */
+    void computeRateMatrixGradient(double *grad_eigen, double *grad_freq, double &tree_lh, PhyloNode *node, PhyloNode *dad);
+
     /****************************************************************************
             ancestral sequence reconstruction
      ****************************************************************************/
@@ -1295,17 +1474,17 @@ public:
     template<class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     void computeNonrevLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodBufferSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
     /** For Mixlen stuffs */
@@ -1615,6 +1794,23 @@ public:
      */
     virtual void doNNI(NNIMove &move, bool clearLH = true);
 
+    /**
+            Clear partial likelihoods after a batch of NNIs done with doNNI(move, false):
+            those of all neighbors whose subtree contains the central branch of some NNI,
+            found in one pass over the tree instead of one pass per NNI.
+            The next traversal then recomputes exactly these vectors.
+            @param moves NNIs applied
+     */
+    void clearNNIPartialLh(vector<NNIMove> &moves);
+
+    /**
+            recursive part of clearNNIPartialLh for the subtree at node
+            @param nni_node TRUE for node IDs of the NNI branches
+            @param num_nni_nodes number of TRUE entries of nni_node
+            @return number of NNI nodes in the subtree at node
+     */
+    int clearNNIPartialLh(vector<bool> &nni_node, int num_nni_nodes, PhyloNode *node, PhyloNode *dad);
+
     /**
             Do an NNI: should only be used for topology change without any info about likelihoods
             @param move reference to an NNI move object containing information about the move
@@ -95,6 +95,17 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk) {
     safe_numeric = (params && (params->lk_safe_scaling || leafNum >= params->numseq_safe_scaling)) ||
         (aln && aln->num_states != 4 && aln->num_states != 20);
 
+    // single-precision partial likelihoods only for the reversible SIMD kernel of DNA and protein
+    bool new_float_lh = params && params->lk_float && lk >= LK_SSE2 && aln &&
+        (aln->num_states == 4 || aln->num_states == 20) &&
+        model_factory && model_factory->model->isReversible() && !params->kernel_nonrev &&
+        !model_factory->model->isSiteSpecificModel() && !isMixlen();
+    if (new_float_lh != float_lh && central_partial_lh) {
+        // memory layout of partial likelihoods changes, they will be re-allocated on demand
+        deleteAllPartialLh();
+    }
+    float_lh = new_float_lh;
+
     //--- parsimony kernel ---
     setParsimonyKernel(lk);
 
@@ -119,6 +130,7 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk) {
 //		dotProduct = &PhyloTree::dotProductSIMD<float, Vec1f>;
 #else
 		dotProduct = &PhyloTree::dotProductSIMD<double, Vec1d>;
+		rellProduct = &PhyloTree::rellProductSIMD<double, Vec1d>;
 #endif
         dotProductDouble = &PhyloTree::dotProductSIMD<double, Vec1d>;
 #endif
@@ -0,0 +1,299 @@
+/***************************************************************************
+ *   Copyright (C) 2006 by BUI Quang Minh, Steffen Klaere, Arndt von Haeseler   *
+ *   minh.bui@univie.ac.at   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#include "splittable.h"
+#include "mtreeset.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*********************************************************
+ * CompactTree
+ *********************************************************/
+
+void CompactTree::build(MTree *tree, double weight_threshold) {
+    ntaxa = tree->leafNum;
+    node.clear();
+    pass.clear();
+    node.reserve(2*ntaxa);
+    pass.reserve(2*ntaxa);
+    NodeVector taxa;
+    tree->getTaxa(taxa);
+    Node *taxon0 = NULL;
+    for (Node *leaf : taxa)
+        if (leaf->id == 0) {
+            taxon0 = leaf;
+            break;
+        }
+    ASSERT(taxon0 && taxon0->degree() == 1);
+    Neighbor *nei = taxon0->neighbors[0];
+    addSubtree(nei->node, taxon0, nei->length, weight_threshold);
+}
+
+void CompactTree::addSubtree(Node *node, Node *dad, double length, double weight_threshold) {
+    int children = 0;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        addSubtree((*it)->node, node, (*it)->length, weight_threshold);
+        children++;
+    }
+    if (children == 1) {
+        // degree-2 node: same split as its only child
+        return;
+    }
+    this->node.push_back(children == 0 ? node->id : -children);
+    pass.push_back(length >= weight_threshold);
+}
+
+/*********************************************************
+ * SplitTable
+ *********************************************************/
+
+static inline uint64_t hashSplitWords(const UINT *words, int nwords) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < nwords; i++) {
+        h = (h ^ words[i]) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+/**
+    collect the clusters (splits excluding taxon 0) of a compact tree
+    @param tree compact tree
+    @param nwords number of UINT words per cluster
+    @param[out] words bitsets of the clusters
+    @param[out] hashes hash value of each cluster
+    @param[out] cluster_pass pass flag of each cluster
+*/
+static void collectClusters(const CompactTree &tree, int nwords, vector<UINT> &words,
+                            vector<uint64_t> &hashes, vector<char> &cluster_pass)
+{
+    words.clear();
+    hashes.clear();
+    cluster_pass.clear();
+    // stack of subtree bitsets, nwords per entry
+    vector<UINT> stack;
+    stack.reserve(nwords * 64);
+    int last = tree.node.size() - 1;
+    for (int i = 0; i <= last; i++) {
+        int v = tree.node[i];
+        if (v >= 0) {
+            stack.resize(stack.size() + nwords, 0);
+            stack[stack.size() - nwords + v / UINT_BITS] |= (UINT)1 << (v % UINT_BITS);
+            continue;
+        }
+        size_t first = stack.size() - (size_t)(-v) * nwords;
+        for (size_t child = first + nwords; child < stack.size(); child += nwords)
+            for (int w = 0; w < nwords; w++)
+                stack[first + w] |= stack[child + w];
+        stack.resize(first + nwords);
+        if (i == last)
+            break;
+        words.insert(words.end(), stack.begin() + first, stack.end());
+        hashes.push_back(hashSplitWords(&stack[first], nwords));
+        cluster_pass.push_back(tree.pass[i]);
+    }
+}
+
+void SplitTable::build(MTreeSet &trees, double weight_threshold) {
+    int ntrees = trees.size();
+    nwords = (trees.front()->leafNum + UINT_BITS - 1) / UINT_BITS;
+    split_words.clear();
+    split_hash.clear();
+    split_next.clear();
+    hash_first.clear();
+    tree_split.clear();
+    tree_pass.clear();
+    tree_start.assign(1, 0);
+
+#ifdef _OPENMP
+    int chunk = 16 * omp_get_max_threads();
+#else
+    int chunk = 16;
+#endif
+    // trees are converted in parallel one chunk at a time, then inserted in
+    // order, so only a chunk of cluster bitsets is held at once
+    vector<vector<UINT> > words(chunk);
+    vector<vector<uint64_t> > hashes(chunk);
+    vector<vector<char> > passes(chunk);
+    for (int start = 0; start < ntrees; start += chunk) {
+        int stop = min(ntrees, start + chunk);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int id = start; id < stop; id++) {
+            CompactTree tree;
+            tree.build(trees[id], weight_threshold);
+            collectClusters(tree, nwords, words[id-start], hashes[id-start], passes[id-start]);
+        }
+        for (int id = start; id < stop; id++)
+            insertTree(words[id-start], hashes[id-start], passes[id-start]);
+    }
+}
+
+void SplitTable::insertTree(const vector<UINT> &words, const vector<uint64_t> &hashes,
+                            const vector<char> &cluster_pass)
+{
+    vector<pair<int, char> > ids;
+    ids.reserve(hashes.size());
+    for (size_t c = 0; c < hashes.size(); c++) {
+        const UINT *cluster = &words[c * nwords];
+        uint64_t hash = hashes[c];
+        int id = -1;
+        auto it = hash_first.find(hash);
+        int head = (it == hash_first.end()) ? -1 : it->second;
+        for (int sid = head; sid >= 0; sid = split_next[sid])
+            if (memcmp(&split_words[(size_t)sid * nwords], cluster, nwords * sizeof(UINT)) == 0) {
+                id = sid;
+                break;
+            }
+        if (id < 0) {
+            // new split, or a hash collision with a different split
+            id = split_hash.size();
+            split_words.insert(split_words.end(), cluster, cluster + nwords);
+            split_hash.push_back(hash);
+            split_next.push_back(head);
+            hash_first[hash] = id;
+        }
+        ids.push_back(make_pair(id, cluster_pass[c]));
+    }
+    sort(ids.begin(), ids.end());
+    for (auto &id : ids) {
+        tree_split.push_back(id.first);
+        tree_pass.push_back(id.second);
+    }
+    tree_start.push_back(tree_split.size());
+}
+
+int SplitTable::computeRFDist(int id1, int id2) const {
+    size_t i = tree_start[id1], end1 = tree_start[id1+1];
+    size_t j = tree_start[id2], end2 = tree_start[id2+1];
+    int diff_splits = 0;
+    while (i < end1 && j < end2) {
+        if (tree_split[i] < tree_split[j])
+            diff_splits += tree_pass[i++];
+        else if (tree_split[i] > tree_split[j])
+            diff_splits += tree_pass[j++];
+        else {
+            i++;
+            j++;
+        }
+    }
+    for (; i < end1; i++)
+        diff_splits += tree_pass[i];
+    for (; j < end2; j++)
+        diff_splits += tree_pass[j];
+    return diff_splits;
+}
+
+/*********************************************************
+ * DayTable
+ *********************************************************/
+
+void DayTable::build(const CompactTree &tree) {
+    int ntaxa = tree.ntaxa;
+    label.assign(ntaxa, -1);
+    row_left.assign(ntaxa, -1);
+    row_right.assign(ntaxa, -1);
+    row_pass.assign(ntaxa, 0);
+    npass = 0;
+    // stack of (left, right, node index) of the subtrees not yet joined
+    IntVector stack_left, stack_right, stack_node;
+    int next_label = 0;
+    int last = tree.node.size() - 1;
+    for (int i = 0; i <= last; i++) {
+        int v = tree.node[i];
+        if (v >= 0) {
+            label[v] = next_label;
+            stack_left.push_back(next_label);
+            stack_right.push_back(next_label);
+            stack_node.push_back(i);
+            next_label++;
+            continue;
+        }
+        int first = stack_node.size() + v;
+        for (int c = first; c < stack_node.size(); c++) {
+            int child = stack_node[c];
+            if (tree.node[child] >= 0)
+                continue; // leaf
+            int row = (c == first) ? stack_right[c] : stack_left[c];
+            row_left[row] = stack_left[c];
+            row_right[row] = stack_right[c];
+            row_pass[row] = tree.pass[child];
+            npass += tree.pass[child];
+        }
+        int left = stack_left[first], right = stack_right.back();
+        stack_left.resize(first);
+        stack_right.resize(first);
+        stack_node.resize(first);
+        stack_left.push_back(left);
+        stack_right.push_back(right);
+        stack_node.push_back(i);
+    }
+}
+
+int DayTable::computeRFDist(const CompactTree &tree) const {
+    int npass2 = 0, shared1 = 0, shared2 = 0;
+    // stack of (min label, max label, number of leaves) of the subtrees not yet joined
+    IntVector stack_min, stack_max, stack_size;
+    stack_min.reserve(tree.ntaxa);
+    stack_max.reserve(tree.ntaxa);
+    stack_size.reserve(tree.ntaxa);
+    int last = tree.node.size() - 1;
+    for (int i = 0; i <= last; i++) {
+        int v = tree.node[i];
+        if (v >= 0) {
+            int l = label[v];
+            ASSERT(l >= 0 && "trees must have the same taxon set");
+            stack_min.push_back(l);
+            stack_max.push_back(l);
+            stack_size.push_back(1);
+            continue;
+        }
+        int first = stack_size.size() + v;
+        int lmin = stack_min[first], lmax = stack_max[first], size = stack_size[first];
+        for (int c = first+1; c < stack_size.size(); c++) {
+            lmin = min(lmin, stack_min[c]);
+            lmax = max(lmax, stack_max[c]);
+            size += stack_size[c];
+        }
+        stack_min.resize(first);
+        stack_max.resize(first);
+        stack_size.resize(first);
+        stack_min.push_back(lmin);
+        stack_max.push_back(lmax);
+        stack_size.push_back(size);
+        if (i == last)
+            break;
+        int pass = tree.pass[i];
+        npass2 += pass;
+        if (lmax - lmin + 1 != size)
+            continue;
+        int row = -1;
+        if (row_left[lmin] == lmin && row_right[lmin] == lmax)
+            row = lmin;
+        else if (row_left[lmax] == lmin && row_right[lmax] == lmax)
+            row = lmax;
+        if (row >= 0) {
+            shared1 += row_pass[row];
+            shared2 += pass;
+        }
+    }
+    return npass + npass2 - shared1 - shared2;
+}
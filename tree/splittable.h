@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright (C) 2006 by BUI Quang Minh, Steffen Klaere, Arndt von Haeseler   *
+ *   minh.bui@univie.ac.at   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef SPLITTABLE_H
+#define SPLITTABLE_H
+
+#include "mtree.h"
+#include <unordered_map>
+
+class MTreeSet;
+
+/**
+    Compact post-order view of an MTree, rooted at the leaf with taxon ID 0.
+    Every entry is a node below that leaf: a leaf stores its taxon ID (>= 0),
+    an internal node stores -(number of children). Nodes of degree 2 are
+    skipped, since their split is the one of their only child.
+    The last entry is the neighbor of taxon 0, whose split is trivial.
+*/
+class CompactTree {
+public:
+
+    /**
+        build the compact view of a tree
+        @param tree input tree, leaf IDs are taxon IDs
+        @param weight_threshold splits with weight below this are not counted
+    */
+    void build(MTree *tree, double weight_threshold);
+
+    /** number of taxa */
+    int ntaxa;
+
+    /** post-order list of nodes (see class description) */
+    IntVector node;
+
+    /** TRUE if the branch above node[i] has weight >= weight_threshold */
+    vector<char> pass;
+
+protected:
+
+    void addSubtree(Node *node, Node *dad, double length, double weight_threshold);
+};
+
+/**
+    Split table for Robinson-Foulds distances of a tree set.
+    Each non-trivial split, oriented to exclude taxon 0, is hashed to 64 bits;
+    equal hashes are checked bit by bit, so every distinct split of the whole
+    tree set gets a single ID in one flat table. A tree is then a sorted list
+    of split IDs and its RF distance to another tree is a linear merge.
+*/
+class SplitTable {
+public:
+
+    /**
+        hash all splits of all trees
+        @param trees input tree set (same taxon set for all trees)
+        @param weight_threshold splits with weight below this are not counted
+    */
+    void build(MTreeSet &trees, double weight_threshold);
+
+    /**
+        @return RF distance between trees id1 and id2: splits of one tree with
+            weight >= weight_threshold that are missing in the other tree
+    */
+    int computeRFDist(int id1, int id2) const;
+
+    /** @return number of distinct non-trivial splits in the tree set */
+    size_t getNSplits() const { return split_hash.size(); }
+
+protected:
+
+    /**
+        add the clusters of one tree to the table
+        @param words cluster bitsets of the tree, nwords per cluster
+        @param hashes hash value of each cluster
+        @param tree_pass pass flag of each cluster
+    */
+    void insertTree(const vector<UINT> &words, const vector<uint64_t> &hashes,
+                    const vector<char> &tree_pass);
+
+    /** number of UINT words per split */
+    int nwords;
+
+    /** bitsets of all distinct splits, nwords per split */
+    vector<UINT> split_words;
+
+    /** hash value of each distinct split */
+    vector<uint64_t> split_hash;
+
+    /** next split with the same hash value, -1 if none */
+    IntVector split_next;
+
+    /** first split with a given hash value */
+    unordered_map<uint64_t, int> hash_first;
+
+    /** start of the split IDs of each tree in tree_split (size = ntrees+1) */
+    vector<size_t> tree_start;
+
+    /** sorted split IDs of all trees, one tree after another */
+    IntVector tree_split;
+
+    /** pass flag (weight >= weight_threshold) of each entry of tree_split */
+    vector<char> tree_pass;
+};
+
+/**
+    Cluster table of Day (1985) for linear-time RF distances.
+    Leaves of the reference tree are numbered in post-order, so each of its
+    clusters is an interval [L,R]. The cluster is stored in row R if it is
+    the first child of its parent, otherwise in row L; no row holds two
+    clusters. A cluster of another tree is shared if its leaf labels are
+    contiguous and the interval is found in one of the two rows.
+*/
+class DayTable {
+public:
+
+    /**
+        build the table of a reference tree
+        @param tree reference tree
+    */
+    void build(const CompactTree &tree);
+
+    /**
+        @return RF distance between the reference tree and a tree
+            with the same taxon set
+    */
+    int computeRFDist(const CompactTree &tree) const;
+
+protected:
+
+    /** post-order label of each taxon */
+    IntVector label;
+
+    /** left and right end of the cluster stored in each row, -1 if empty */
+    IntVector row_left, row_right;
+
+    /** pass flag of the cluster stored in each row */
+    vector<char> row_pass;
+
+    /** number of non-trivial clusters with weight >= weight_threshold */
+    int npass;
+};
+
+#endif
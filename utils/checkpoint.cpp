@@ -10,10 +10,22 @@
 #include "timeutil.h"
 #include "gzstream.h"
 #include <cstdio>
+#include <cstring>
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__ && !defined WIN64
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
 
 const char* CKP_HEADER =     "--- # IQ-TREE Checkpoint ver >= 1.6";
 const char* CKP_HEADER_OLD = "--- # IQ-TREE Checkpoint";
 
+/** binary checkpoint: file magic and record types */
+const char* CKP_BIN_MAGIC = "IQ-TREE binary checkpoint 1\n";
+const char CKP_BIN_SET = 'S';
+const char CKP_BIN_ERASE = 'E';
+const char CKP_BIN_COMMIT = 'C';
+
 Checkpoint::Checkpoint() {
 	filename = "";
     prev_dump_time = 0;
@@ -22,10 +34,17 @@ Checkpoint::Checkpoint() {
     struct_name = "";
     compression = true;
     header = CKP_HEADER;
+    binary = false;
+    binary_log_size = 0;
+    binary_live_size = 0;
+    binary_log_valid = false;
+    writer = NULL;
 }
 
 
 Checkpoint::~Checkpoint() {
+    if (writer)
+        delete writer;
 }
 
 
@@ -76,6 +95,8 @@ void Checkpoint::load(istream &in) {
 bool Checkpoint::load() {
 	ASSERT(filename != "");
     if (!fileExists(filename)) return false;
+    if (binary)
+        return loadBinary();
     try {
         igzstream in;
         // set the failbit and badbit
@@ -121,6 +142,24 @@ void Checkpoint::setHeader(string header) {
     this->header = "--- # " + header;
 }
 
+void Checkpoint::setBinary(bool binary) {
+    this->binary = binary;
+}
+
+void Checkpoint::setAsync(bool async) {
+    if (async && !writer)
+        writer = new CheckpointWriter(this);
+    else if (!async && writer) {
+        delete writer;
+        writer = NULL;
+    }
+}
+
+void Checkpoint::flush() {
+    if (writer)
+        writer->flush();
+}
+
 void Checkpoint::setDumpInterval(double interval) {
     dump_interval = interval;
 }
@@ -151,12 +190,35 @@ void Checkpoint::dump(bool force) {
         return;
     }
     prev_dump_time = getRealTime();
+    if (writer) {
+        map<string, string> snapshot(*this);
+        writer->push(snapshot);
+        if (force)
+            writer->flush();
+        return;
+    }
+    writeFile();
+    if (!Params::getInstance().print_all_checkpoints) {
+        // check that the dumping time is too long and increase dump_interval if necessary
+        double dump_time = getRealTime() - prev_dump_time;
+        if (dump_time*20 > dump_interval) {
+            dump_interval = ceil(dump_time*20);
+            cout << "NOTE: " << dump_time << " seconds to dump checkpoint file, increase to "
+            << dump_interval << endl;
+        }
+    }
+}
+
+void Checkpoint::writeFile() {
     string filename_tmp = filename + ".tmp";
     if (fileExists(filename_tmp)) {
         outWarning("IQ-TREE was killed while writing temporary checkpoint file " + filename_tmp);
         outWarning("You should increase checkpoint interval from the default 60 seconds");
         outWarning("via -cptime option to avoid too frequent checkpoint for large datasets");
     }
+    if (binary)
+        dumpBinary();
+    else
     try {
         ostream *out;
         if (compression) 
@@ -204,14 +266,229 @@ void Checkpoint::dump(bool force) {
         } catch (ios::failure &) {
             outError(ERR_WRITE_OUTPUT, filename_tmp.c_str());
         }
-    } else {
-        // check that the dumping time is too long and increase dump_interval if necessary
-        double dump_time = getRealTime() - prev_dump_time;
-        if (dump_time*20 > dump_interval) {
-            dump_interval = ceil(dump_time*20);
-            cout << "NOTE: " << dump_time << " seconds to dump checkpoint file, increase to "
-            << dump_interval << endl;
+    }
+}
+
+/*-------------------------------------------------------------
+ * binary checkpoint log
+ *-------------------------------------------------------------*/
+
+/** @return size of the record for a key and a value of given length */
+static inline size_t binaryRecordSize(const string &key, size_t value_len) {
+    return 1 + sizeof(uint32_t) + key.length() + sizeof(uint64_t) + value_len;
+}
+
+/**
+    64-bit hash of a value (MurmurHash64A) to detect changed keys; together with
+    the length of the value, a changed value goes unnoticed with probability 2^-64
+*/
+static uint64_t hashValue(const string &value) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    size_t len = value.length();
+    const char *data = value.data();
+    uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+    size_t nblocks = len / 8;
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64_t k;
+        memcpy(&k, data + 8*i, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    size_t rest = len & 7;
+    if (rest) {
+        const unsigned char *tail = (const unsigned char*)data + 8*nblocks;
+        uint64_t k = 0;
+        for (size_t i = 0; i < rest; i++)
+            k |= (uint64_t)tail[i] << (8*i);
+        h ^= k;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+/**
+    write a record of binary checkpoint
+    @param out output stream
+    @param type record type
+    @param key key name
+    @param value value, NULL for records without value
+    @return number of bytes written
+*/
+static size_t writeBinaryRecord(ostream &out, char type, const string &key, const string *value) {
+    uint32_t key_len = key.length();
+    out.put(type);
+    out.write((char*)&key_len, sizeof(key_len));
+    out.write(key.data(), key_len);
+    if (!value)
+        return 1 + sizeof(key_len) + key_len;
+    uint64_t value_len = value->length();
+    out.write((char*)&value_len, sizeof(value_len));
+    out.write(value->data(), value_len);
+    return 1 + sizeof(key_len) + key_len + sizeof(value_len) + value_len;
+}
+
+bool Checkpoint::loadBinary() {
+    ifstream in;
+    in.open(filename.c_str(), ios::in | ios::binary);
+    if (!in.is_open())
+        return false;
+    string magic(strlen(CKP_BIN_MAGIC), ' ');
+    uint32_t key_len = 0;
+    in.read(&magic[0], magic.length());
+    in.read((char*)&key_len, sizeof(key_len));
+    string file_header(in ? key_len : 0, ' ');
+    in.read(&file_header[0], file_header.length());
+    if (!in || magic != CKP_BIN_MAGIC)
+        outError("Invalid checkpoint file " + filename);
+    if (file_header != header)
+        outError("Invalid checkpoint file " + filename);
+
+    clear();
+    binary_dumped.clear();
+    binary_live_size = 0;
+    binary_log_size = in.tellg();
+    // records are applied when their batch is committed, so that a batch
+    // interrupted by a crash is ignored
+    vector<pair<string, string> > batch_set;
+    vector<string> batch_erase;
+    uint64_t value_len;
+    char type;
+    while (in.get(type)) {
+        string key, value;
+        if (!in.read((char*)&key_len, sizeof(key_len)))
+            break;
+        key.resize(key_len);
+        if (!in.read(&key[0], key_len))
+            break;
+        if (type == CKP_BIN_SET) {
+            if (!in.read((char*)&value_len, sizeof(value_len)))
+                break;
+            value.resize(value_len);
+            if (!in.read(&value[0], value_len))
+                break;
+            batch_erase.push_back(key);
+            batch_set.push_back(make_pair(key, std::move(value)));
+        } else if (type == CKP_BIN_ERASE) {
+            batch_erase.push_back(key);
+        } else if (type == CKP_BIN_COMMIT) {
+            for (auto &k : batch_erase) {
+                auto it = binary_dumped.find(k);
+                if (it == binary_dumped.end())
+                    continue;
+                binary_live_size -= binaryRecordSize(k, it->second.first);
+                binary_dumped.erase(it);
+                erase(k);
+            }
+            for (auto &kv : batch_set) {
+                binary_dumped[kv.first] = make_pair(kv.second.length(), hashValue(kv.second));
+                binary_live_size += binaryRecordSize(kv.first, kv.second.length());
+                (*this)[kv.first] = std::move(kv.second);
+            }
+            batch_set.clear();
+            batch_erase.clear();
+            binary_log_size = in.tellg();
+        } else
+            break;
+    }
+    // a truncated last batch is overwritten by compaction at the next dump
+    in.clear();
+    in.seekg(0, ios::end);
+    binary_log_valid = ((size_t)in.tellg() == binary_log_size);
+    in.close();
+    return true;
+}
+
+void Checkpoint::dumpBinary() {
+    if (!binary_log_valid || binary_log_size > 2*binary_live_size + 1048576) {
+        compactBinary();
+        return;
+    }
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename.c_str(), ios::out | ios::binary | ios::app);
+        size_t num_records = 0;
+        iterator it = begin();
+        auto dit = binary_dumped.begin();
+        while (it != end() || dit != binary_dumped.end()) {
+            int cmp;
+            if (it == end())
+                cmp = 1;
+            else if (dit == binary_dumped.end())
+                cmp = -1;
+            else
+                cmp = it->first.compare(dit->first);
+            if (cmp < 0) {
+                // new key
+                binary_log_size += writeBinaryRecord(out, CKP_BIN_SET, it->first, &it->second);
+                binary_live_size += binaryRecordSize(it->first, it->second.length());
+                binary_dumped.emplace_hint(dit, it->first, make_pair(it->second.length(), hashValue(it->second)));
+                num_records++;
+                it++;
+            } else if (cmp > 0) {
+                // erased key
+                binary_log_size += writeBinaryRecord(out, CKP_BIN_ERASE, dit->first, NULL);
+                binary_live_size -= binaryRecordSize(dit->first, dit->second.first);
+                dit = binary_dumped.erase(dit);
+                num_records++;
+            } else {
+                uint64_t value_hash = hashValue(it->second);
+                if (it->second.length() != dit->second.first || value_hash != dit->second.second) {
+                    // changed value
+                    binary_log_size += writeBinaryRecord(out, CKP_BIN_SET, it->first, &it->second);
+                    binary_live_size += it->second.length();
+                    binary_live_size -= dit->second.first;
+                    dit->second = make_pair(it->second.length(), value_hash);
+                    num_records++;
+                }
+                it++;
+                dit++;
+            }
         }
+        if (num_records)
+            binary_log_size += writeBinaryRecord(out, CKP_BIN_COMMIT, "", NULL);
+        out.close();
+    } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, filename.c_str());
+    }
+}
+
+void Checkpoint::compactBinary() {
+    string filename_tmp = filename + ".tmp";
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename_tmp.c_str(), ios::out | ios::binary | ios::trunc);
+        out.write(CKP_BIN_MAGIC, strlen(CKP_BIN_MAGIC));
+        uint32_t header_len = header.length();
+        out.write((char*)&header_len, sizeof(header_len));
+        out.write(header.data(), header_len);
+        binary_log_size = strlen(CKP_BIN_MAGIC) + sizeof(header_len) + header_len;
+        binary_live_size = 0;
+        binary_dumped.clear();
+        for (iterator it = begin(); it != end(); it++) {
+            binary_log_size += writeBinaryRecord(out, CKP_BIN_SET, it->first, &it->second);
+            binary_live_size += binaryRecordSize(it->first, it->second.length());
+            binary_dumped.emplace_hint(binary_dumped.end(), it->first, make_pair(it->second.length(), hashValue(it->second)));
+        }
+        binary_log_size += writeBinaryRecord(out, CKP_BIN_COMMIT, "", NULL);
+        out.close();
+        if (fileExists(filename)) {
+            if (std::remove(filename.c_str()) != 0)
+                outError("Cannot remove file ", filename);
+        }
+        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+            outError("Cannot rename file ", filename_tmp);
+        binary_log_valid = true;
+    } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, filename.c_str());
     }
 }
 
@@ -387,6 +664,109 @@ void Checkpoint::transferSubCheckpoint(Checkpoint *target, string partial_key, b
 }
 
 
+/*-------------------------------------------------------------
+ * CheckpointWriter
+ *-------------------------------------------------------------*/
+
+/** flush a written file to disk */
+static void syncFile(const string &filename) {
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__ && !defined WIN64
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+/** all running writers, to write their pending copies when the program exits */
+static vector<CheckpointWriter*> running_writers;
+static std::mutex running_writers_lock;
+
+CheckpointWriter::CheckpointWriter(Checkpoint *checkpoint) {
+    this->checkpoint = checkpoint;
+    pending_compression = true;
+    pending_binary = false;
+    has_pending = false;
+    busy = false;
+    stop = false;
+    // take over the binary log state, e.g. after loading the checkpoint
+    file_ckp.binary_dumped = checkpoint->binary_dumped;
+    file_ckp.binary_log_size = checkpoint->binary_log_size;
+    file_ckp.binary_live_size = checkpoint->binary_live_size;
+    file_ckp.binary_log_valid = checkpoint->binary_log_valid;
+    thread = std::thread(&CheckpointWriter::run, this);
+    std::lock_guard<std::mutex> guard(running_writers_lock);
+    running_writers.push_back(this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> guard(running_writers_lock);
+        running_writers.erase(std::find(running_writers.begin(), running_writers.end(), this));
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop = true;
+    }
+    cond.notify_all();
+    thread.join();
+}
+
+void CheckpointWriter::push(map<string, string> &snapshot) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        // file settings may change after the writer was started
+        pending_filename = checkpoint->filename;
+        pending_compression = checkpoint->compression;
+        pending_header = checkpoint->header;
+        pending_binary = checkpoint->binary;
+        pending.swap(snapshot);
+        has_pending = true;
+    }
+    cond.notify_all();
+}
+
+void CheckpointWriter::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    cond.wait(guard, [this] { return !has_pending && !busy; });
+}
+
+void CheckpointWriter::flushAll() {
+    std::lock_guard<std::mutex> guard(running_writers_lock);
+    for (auto writer : running_writers) {
+        // the writer thread itself may exit, e.g. via outError when the file cannot be written
+        if (writer->thread.get_id() != std::this_thread::get_id())
+            writer->flush();
+    }
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        cond.wait(guard, [this] { return has_pending || stop; });
+        if (!has_pending)
+            break;
+        file_ckp.swap(pending);
+        pending.clear();
+        file_ckp.filename = pending_filename;
+        file_ckp.compression = pending_compression;
+        file_ckp.header = pending_header;
+        file_ckp.binary = pending_binary;
+        has_pending = false;
+        busy = true;
+        guard.unlock();
+        if (file_ckp.filename != "") {
+            file_ckp.writeFile();
+            syncFile(file_ckp.filename);
+        }
+        guard.lock();
+        busy = false;
+        cond.notify_all();
+    }
+}
+
 /*-------------------------------------------------------------
  * CheckpointFactory
  *-------------------------------------------------------------*/
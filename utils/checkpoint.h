@@ -15,6 +15,9 @@
 #include <cassert>
 #include <vector>
 #include <typeinfo>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "tools.h"
 
 using namespace std;
@@ -61,6 +64,8 @@ public:
 //    return is;
 //}
 
+class CheckpointWriter;
+
 /**
  * Checkpoint as map from key strings to value strings
  */
@@ -92,6 +97,25 @@ public:
     */
     void setHeader(string header);
 
+    /**
+        set binary format for checkpoint file: dump appends only changed keys to a log of
+        length-prefixed records, which is compacted when it grows much larger than the checkpoint
+        @param binary true for binary log, or false (default): gzipped text
+    */
+    void setBinary(bool binary);
+
+    /**
+        write checkpoint file in a background thread: dump only hands over a copy of the checkpoint,
+        forced dumps wait until the file is written
+        @param async true for background writing, or false (default): write on the calling thread
+    */
+    void setAsync(bool async);
+
+    /**
+        wait until the background writer has written all dumped checkpoints
+    */
+    void flush();
+
 	/**
 	 * load checkpoint information from an input stram
      * @param in input stream
@@ -442,6 +466,28 @@ public:
 
 protected:
 
+    /**
+        load checkpoint information from binary log file
+        @return TRUE if loaded successfully, otherwise FALSE
+    */
+    bool loadBinary();
+
+    /**
+        append changed and erased keys since the previous dump to binary log file,
+        or rewrite it if the log became too large
+    */
+    void dumpBinary();
+
+    /**
+        rewrite binary log file with one record per key
+    */
+    void compactBinary();
+
+    /**
+        write checkpoint file (text or binary) without checking the dumping interval
+    */
+    void writeFile();
+
     /** filename to write checkpoint */
 	string filename;
     
@@ -459,6 +505,26 @@ protected:
     
     /** header line of checkpoint file */
     string header;
+
+    /** true to write binary log, false (default): gzipped text */
+    bool binary;
+
+    /** length and 64-bit hash of each value as written to binary log file, to detect changed keys */
+    map<string, pair<size_t, uint64_t> > binary_dumped;
+
+    /** size of binary log file in bytes */
+    size_t binary_log_size;
+
+    /** size in bytes of the records for the keys in binary_dumped */
+    size_t binary_live_size;
+
+    /** true if binary log file corresponds to binary_dumped, so that new records can be appended */
+    bool binary_log_valid;
+
+    /** background writer, NULL if checkpoint file is written on the calling thread */
+    CheckpointWriter *writer;
+
+    friend class CheckpointWriter;
     
 private:
 
@@ -475,6 +541,70 @@ private:
 
 
 
+/**
+    Background thread writing checkpoint files, including compression and fsync.
+    It holds at most one pending checkpoint copy: a copy not yet taken by
+    the thread is replaced by a newer one, so slow file systems only make
+    the thread skip intermediate dumps.
+*/
+class CheckpointWriter {
+public:
+
+    /**
+        start the writer thread
+        @param checkpoint checkpoint whose file settings are used
+    */
+    CheckpointWriter(Checkpoint *checkpoint);
+
+    /** write the pending checkpoint and stop the thread */
+    ~CheckpointWriter();
+
+    /**
+        hand over a copy of the checkpoint to be written
+        @param snapshot copy of the checkpoint, moved into the writer
+    */
+    void push(map<string, string> &snapshot);
+
+    /** wait until all pushed copies are written */
+    void flush();
+
+    /** write the pending copies of all writers, called when the program exits */
+    static void flushAll();
+
+protected:
+
+    /** thread main loop */
+    void run();
+
+    /** source checkpoint */
+    Checkpoint *checkpoint;
+
+    /** checkpoint written to file, with the file settings and binary log state of the source */
+    Checkpoint file_ckp;
+
+    /** copy waiting to be written */
+    map<string, string> pending;
+
+    /** file settings of the source when pending was pushed */
+    string pending_filename;
+    bool pending_compression;
+    string pending_header;
+    bool pending_binary;
+
+    /** true if pending holds a copy */
+    bool has_pending;
+
+    /** true while a copy is being written */
+    bool busy;
+
+    /** true to stop the thread */
+    bool stop;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::thread thread;
+};
+
 /**
     Root class handling all checkpoint facilities. Inherit this class
     if you want a class to be checkpointed.
@@ -0,0 +1,262 @@
+//
+//  threadpool.cpp
+//  utils
+//
+//  Persistent work-stealing thread pool (see threadpool.h).
+//
+//  LICENSE:
+//* This program is free software; you can redistribute it and/or modify
+//* it under the terms of the GNU General Public License as published by
+//* the Free Software Foundation; either version 2 of the License, or
+//* (at your option) any later version.
+//*
+//* This program is distributed in the hope that it will be useful,
+//* but WITHOUT ANY WARRANTY; without even the implied warranty of
+//* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//* GNU General Public License for more details.
+//
+
+#include "threadpool.h"
+
+/** number of times an idle worker yields before it goes to sleep */
+#define THREAD_POOL_SPIN_COUNT 20000
+
+/** the process-wide pool */
+static ThreadPool *pool_instance = nullptr;
+static std::mutex pool_instance_lock;
+
+ThreadPool::ThreadPool(int threadCount)
+    : num_threads(threadCount < 1 ? 1 : threadCount)
+    , queues(new TaskQueue[threadCount < 1 ? 1 : threadCount])
+    , job_func(nullptr), job_threads(0), job_succ_index(nullptr), job_succ_list(nullptr)
+    , job_deps_capacity(0), tasks_left(0), ticket(0)
+    , active_workers(0), sleeping_workers(0), stopping(false) {
+    for (int t = 1; t < num_threads; t++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool *ThreadPool::getInstance(int threadCount) {
+    std::lock_guard<std::mutex> guard(pool_instance_lock);
+    if (!pool_instance) {
+        pool_instance = new ThreadPool(threadCount);
+    }
+    return pool_instance;
+}
+
+void ThreadPool::shutdown() {
+    std::lock_guard<std::mutex> guard(pool_instance_lock);
+    if (!pool_instance) {
+        return;
+    }
+    if (!pool_instance->call_lock.try_lock()) {
+        // exiting on a crash in the middle of a job: the workers may never
+        // finish it, so leave them to the operating system
+        return;
+    }
+    pool_instance->call_lock.unlock();
+    delete pool_instance;
+    pool_instance = nullptr;
+}
+
+void ThreadPool::workerLoop(int thread_id) {
+    long long seen = 0;
+    for (;;) {
+        int spins = 0;
+        while (ticket.load() == seen) {
+            if (stopping.load()) {
+                return;
+            }
+            if (++spins < THREAD_POOL_SPIN_COUNT) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            sleeping_workers++;
+            wake_up.wait(guard, [&] {
+                return ticket.load() != seen || stopping.load();
+            });
+            sleeping_workers--;
+        }
+        long long job = ticket.load();
+        seen = job;
+        if ((job & 1) == 0) {
+            // missed that job, it is closed already
+            continue;
+        }
+        if (thread_id >= job_threads) {
+            // the caller's buffers only cover fewer threads
+            continue;
+        }
+        // join the job unless it was closed in the meantime; the caller
+        // waits for all joined workers before it reuses the job state
+        active_workers++;
+        if (ticket.load() == job) {
+            executeTasks(thread_id);
+        }
+        active_workers--;
+    }
+}
+
+bool ThreadPool::popTask(int thread_id, int &task) {
+    {
+        TaskQueue &own = queues[thread_id];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // steal the oldest task of another thread
+    for (int i = 1; i < job_threads; i++) {
+        TaskQueue &victim = queues[(thread_id + i) % job_threads];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::pushTask(int thread_id, int task) {
+    TaskQueue &own = queues[thread_id];
+    std::lock_guard<std::mutex> guard(own.lock);
+    own.tasks.push_back(task);
+}
+
+void ThreadPool::executeTasks(int thread_id) {
+    int task;
+    while (tasks_left.load(std::memory_order_acquire) > 0) {
+        if (!popTask(thread_id, task)) {
+            std::this_thread::yield();
+            continue;
+        }
+        (*job_func)(task, thread_id);
+        if (job_succ_index) {
+            for (int i = job_succ_index[task]; i < job_succ_index[task+1]; i++) {
+                int succ = job_succ_list[i];
+                if (job_deps[succ].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    pushTask(thread_id, succ);
+                }
+            }
+        }
+        tasks_left.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void ThreadPool::runJob() {
+    long long job = ticket.load() + 1;
+    ticket.store(job);
+    if (sleeping_workers.load() > 0) {
+        // taking the lock makes sure a worker about to sleep sees the new ticket
+        { std::lock_guard<std::mutex> guard(sleep_lock); }
+        wake_up.notify_all();
+    }
+    executeTasks(0);
+    // close the job: workers that did not join in time stay out of it
+    ticket.store(job + 1);
+    while (active_workers.load() > 0) {
+        std::this_thread::yield();
+    }
+    job_func = nullptr;
+}
+
+void ThreadPool::runSerial(int num_tasks, const int *num_deps, const int *succ_index,
+                           const int *succ_list, const TaskFunction &func) {
+    if (!succ_index) {
+        for (int task = 0; task < num_tasks; task++) {
+            func(task, 0);
+        }
+        return;
+    }
+    std::vector<int> deps(num_deps, num_deps + num_tasks);
+    std::vector<int> ready;
+    for (int task = num_tasks - 1; task >= 0; task--) {
+        if (deps[task] == 0) {
+            ready.push_back(task);
+        }
+    }
+    while (!ready.empty()) {
+        int task = ready.back();
+        ready.pop_back();
+        func(task, 0);
+        for (int i = succ_index[task]; i < succ_index[task+1]; i++) {
+            if (--deps[succ_list[i]] == 0) {
+                ready.push_back(succ_list[i]);
+            }
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int num_tasks, const TaskFunction &func, int max_threads) {
+    if (num_tasks <= 0) {
+        return;
+    }
+    int threads = getJobThreads(max_threads);
+    std::unique_lock<std::mutex> guard(call_lock, std::try_to_lock);
+    if (threads == 1 || num_tasks == 1 || !guard.owns_lock()) {
+        runSerial(num_tasks, nullptr, nullptr, nullptr, func);
+        return;
+    }
+    // deal out contiguous chunks, lowest task at the back (popped first)
+    for (int t = 0; t < threads; t++) {
+        int lower = (int)((long long)num_tasks * t / threads);
+        int upper = (int)((long long)num_tasks * (t+1) / threads);
+        std::deque<int> &tasks = queues[t].tasks;
+        for (int task = upper - 1; task >= lower; task--) {
+            tasks.push_back(task);
+        }
+    }
+    job_func       = &func;
+    job_threads    = threads;
+    job_succ_index = nullptr;
+    job_succ_list  = nullptr;
+    tasks_left.store(num_tasks, std::memory_order_release);
+    runJob();
+}
+
+void ThreadPool::runGraph(int num_tasks, const int *num_deps, const int *succ_index,
+                          const int *succ_list, const TaskFunction &func, int max_threads) {
+    if (num_tasks <= 0) {
+        return;
+    }
+    int threads = getJobThreads(max_threads);
+    std::unique_lock<std::mutex> guard(call_lock, std::try_to_lock);
+    if (threads == 1 || !guard.owns_lock()) {
+        runSerial(num_tasks, num_deps, succ_index, succ_list, func);
+        return;
+    }
+    if (job_deps_capacity < num_tasks) {
+        job_deps.reset(new std::atomic<int>[num_tasks]);
+        job_deps_capacity = num_tasks;
+    }
+    // spread the initially ready tasks round-robin over the threads
+    int t = 0;
+    for (int task = 0; task < num_tasks; task++) {
+        job_deps[task].store(num_deps[task], std::memory_order_relaxed);
+        if (num_deps[task] == 0) {
+            queues[t].tasks.push_front(task);
+            t = (t + 1) % threads;
+        }
+    }
+    job_func       = &func;
+    job_threads    = threads;
+    job_succ_index = succ_index;
+    job_succ_list  = succ_list;
+    tasks_left.store(num_tasks, std::memory_order_release);
+    runJob();
+}
@@ -0,0 +1,132 @@
+//
+//  threadpool.h
+//  utils
+//
+//  Persistent work-stealing thread pool, used as an alternative to
+//  per-call OpenMP parallel regions in the likelihood kernels.
+//
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+    A pool of worker threads that stay alive (and spin for a while before
+    going to sleep) between jobs, so that many small parallel jobs do not pay
+    the cost of starting and joining a parallel region each time.
+    Every thread owns a task deque; idle threads steal from the others.
+    The calling thread always takes part in a job as thread 0.
+    One pool is shared by the whole process (getInstance), so that trees of
+    partitions or of model candidates do not each start their own workers.
+*/
+class ThreadPool {
+public:
+    /**
+        @param task_id the task to run
+        @param thread_id the thread running it (0..getNumThreads()-1)
+    */
+    typedef std::function<void(int task_id, int thread_id)> TaskFunction;
+
+    /**
+        @param threadCount number of threads including the calling thread
+    */
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    /**
+        @return the process-wide pool, created on the first call
+        @param threadCount number of threads of the pool if it is created by this call
+    */
+    static ThreadPool *getInstance(int threadCount);
+
+    /** stop the process-wide pool, called once when the program exits (see funcExit) */
+    static void shutdown();
+
+    /** @return number of threads including the calling thread */
+    int getNumThreads() const { return num_threads; }
+
+    /**
+        run func(task, thread) for all tasks in [0, num_tasks)
+        @param max_threads number of threads taking part (thread ids below it), 0 for all
+    */
+    void parallelFor(int num_tasks, const TaskFunction &func, int max_threads = 0);
+
+    /**
+        run a task graph: task i may only start once all its num_deps[i]
+        predecessors have finished. The successors of task i are
+        succ_list[succ_index[i] .. succ_index[i+1]-1].
+        @param num_deps number of predecessors of each task (num_tasks entries)
+        @param succ_index start of each task's successors in succ_list (num_tasks+1 entries)
+        @param succ_list successor tasks
+        @param max_threads number of threads taking part (thread ids below it), 0 for all
+    */
+    void runGraph(int num_tasks, const int *num_deps, const int *succ_index,
+                  const int *succ_list, const TaskFunction &func, int max_threads = 0);
+
+private:
+    void workerLoop(int thread_id);
+
+    /** open the job described by the job_* members, take part in it and wait until it is done */
+    void runJob();
+
+    /** execute tasks of the current job until none are left */
+    void executeTasks(int thread_id);
+
+    bool popTask(int thread_id, int &task);
+    void pushTask(int thread_id, int task);
+
+    /** run a job on the calling thread only (nested or concurrent calls) */
+    void runSerial(int num_tasks, const int *num_deps, const int *succ_index,
+                   const int *succ_list, const TaskFunction &func);
+
+    struct TaskQueue {
+        std::mutex       lock;
+        std::deque<int>  tasks;
+    };
+
+    int num_threads;
+    std::vector<std::thread> workers;
+    std::unique_ptr<TaskQueue[]> queues;
+
+    /** @return number of threads taking part in a job limited to max_threads */
+    int getJobThreads(int max_threads) const {
+        return (max_threads > 0 && max_threads < num_threads) ? max_threads : num_threads;
+    }
+
+    /** current job */
+    const TaskFunction *job_func;
+    /** number of threads taking part in the current job */
+    int job_threads;
+    const int *job_succ_index;
+    const int *job_succ_list;
+    std::unique_ptr<std::atomic<int>[]> job_deps;
+    int job_deps_capacity;
+    std::atomic<int> tasks_left;
+
+    /**
+        job ticket: twice the job number, plus one while the job is open for
+        workers to join; workers wait for it to change
+    */
+    std::atomic<long long> ticket;
+    /** number of workers taking part in the current job */
+    std::atomic<int> active_workers;
+    /** number of workers sleeping on wake_up */
+    std::atomic<int> sleeping_workers;
+    std::atomic<bool> stopping;
+
+    std::mutex sleep_lock;
+    std::condition_variable wake_up;
+
+    /** held by the thread currently running a job */
+    std::mutex call_lock;
+};
+
+#endif /* threadpool_h */
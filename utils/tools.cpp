@@ -1049,6 +1049,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.compute_jc_dist = true;
     params.experimental = true;
     params.compute_ml_dist = true;
+    params.ml_dist_eigen = false;
     params.compute_ml_tree = true;
     params.compute_ml_tree_only = false;
     params.budget_file = NULL;
@@ -1111,6 +1112,7 @@ void parseArg(int argc, char *argv[], Params &params) {
 
     params.aln_file = NULL;
     params.phylip_sequential_format = false;
+    params.stream_alignment = false;
     params.symtest = SYMTEST_NONE;
     params.symtest_only = false;
     params.symtest_remove = 0;
@@ -1214,6 +1216,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.optimize_alg_treeweight = "EM";
     params.optimize_from_given_params = false;
     params.optimize_alg_qmix = "BFGS";
+    params.analytic_gradient = false;
     params.estimate_init_freq = 0;
 
     // defaults for new options -JD
@@ -1243,6 +1246,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.writeDistImdTrees = false;
     params.rf_dist_mode = 0;
     params.rf_same_pair = false;
+    params.rf_engine = RF_ENGINE_SPLIT_MAP;
     params.normalize_tree_dist = false;
     params.mvh_site_rate = false;
     params.rate_mh_type = true;
@@ -1261,6 +1265,13 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.lk_safe_scaling = false;
     params.numseq_safe_scaling = 2000;
     params.kernel_nonrev = false;
+    params.lk_exp_scaling = false;
+    params.lk_float = false;
+    params.cherry_lookup = false;
+    params.site_repeats = false;
+    params.thread_pool = false;
+    params.subtree_tasks = false;
+    params.parallel_nni = false;
     params.print_site_lh = WSL_NONE;
     params.print_partition_lh = false;
     params.print_marginal_prob = false;
@@ -1305,6 +1316,7 @@ void parseArg(int argc, char *argv[], Params &params) {
 
     params.gbo_replicates = 0;
 	params.ufboot_epsilon = 0.5;
+    params.ufboot_batch = 1;
     params.check_gbo_sample_size = 0;
     params.use_rell_method = true;
     params.use_elw_method = false;
@@ -1339,8 +1351,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 #endif
     params.modelEps = 0.01;
     params.modelfinder_eps = 0.1;
+    params.modelfinder_shared_tree = false;
     params.treemix_eps = 0.001;
     params.treemixhmm_eps = 0.01;
+    params.parallel_hmm = false;
     params.parbran = false;
     params.binary_aln_file = NULL;
     params.maxtime = 1000000;
@@ -1413,6 +1427,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.checkpoint_dump_interval = 60;
     params.force_unfinished = false;
     params.print_all_checkpoints = false;
+    params.checkpoint_binary = false;
+    params.checkpoint_async = false;
     params.suppress_output_flags = 0;
     params.ufboot2corr = false;
     params.u2c_nni5 = false;
@@ -1437,6 +1453,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.terrace_non_stop = false;
     params.terrace_print_lim = 0;
     params.terrace_remove_m_leaves = 0;
+    params.terrace_task_depth = 0;
     params.matrix_order = false;
     params.gen_all_NNI = false;
     
@@ -1509,6 +1526,11 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.mem_limit_factor = 0;
     params.delete_output = false;
     params.indel_rate_variation = false;
+    params.alisim_fenwick_sampler = false;
+    params.alisim_indel_rope = false;
+    params.alisim_mpi_segments = false;
+    params.alisim_batch_replicates = false;
+    params.alisim_simd_sampling = false;
     params.tmp_data_filename = "tmp_data";
     params.rebuild_indel_history_param = 1.0/3;
     params.alisim_openmp_alg = IM;
@@ -1670,6 +1692,11 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--analytic-grad") == 0) {
+                params.analytic_gradient = true;
+                continue;
+            }
+
             if (strcmp(argv[cnt], "-init_nucl_freq") == 0 || strcmp(argv[cnt], "--init_nucl_freq") == 0) {
                 cnt++;
                 if (cnt >= argc)
@@ -1847,6 +1874,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.compute_obs_dist = true;
 				continue;
 			}
+            if (strcmp(argv[cnt], "--ml-dist-eigen") == 0) {
+                params.ml_dist_eigen = true;
+                continue;
+            }
             if (strcmp(argv[cnt], "-experimental") == 0 || strcmp(argv[cnt], "--experimental") == 0) {
                 params.experimental = true;
                 continue;
@@ -2379,6 +2410,10 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.phylip_sequential_format = true;
                 continue;
             }
+            if (strcmp(argv[cnt], "--stream-aln") == 0) {
+                params.stream_alignment = true;
+                continue;
+            }
             if (strcmp(argv[cnt], "--symtest") == 0) {
                 params.symtest = SYMTEST_MAXDIV;
                 continue;
@@ -2747,6 +2782,17 @@ void parseArg(int argc, char *argv[], Params &params) {
             }
             
             
+            if (strcmp(argv[cnt], "-g_par_depth") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use -g_par_depth <number_of_taxa>";
+                params.terrace_task_depth = convert_int(argv[cnt]);
+                if(params.terrace_task_depth<0){
+                    throw "Invalid value! Use -g_par_depth <taxa_num> with taxa_num>0 to generate trees in parallel below the insertion of the first taxa_num taxa, or use taxa_num == 0 for sequential generation.";
+                }
+                continue;
+            }
+            
             if (strcmp(argv[cnt], "-g_stop_i") == 0) {
                 cnt++;
                 if (cnt >= argc)
@@ -3425,6 +3471,46 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "-lk-exp-scaling") == 0 || strcmp(argv[cnt], "--lk-exp-scaling") == 0) {
+                params.lk_exp_scaling = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-lk-float") == 0 || strcmp(argv[cnt], "--lk-float") == 0) {
+                params.lk_float = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-cherry-lookup") == 0 || strcmp(argv[cnt], "--cherry-lookup") == 0) {
+                params.cherry_lookup = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-site-repeats") == 0 || strcmp(argv[cnt], "--site-repeats") == 0) {
+                params.site_repeats = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-thread-pool") == 0 || strcmp(argv[cnt], "--thread-pool") == 0) {
+                params.thread_pool = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-subtree-tasks") == 0 || strcmp(argv[cnt], "--subtree-tasks") == 0) {
+                params.subtree_tasks = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--parallel-hmm") == 0) {
+                params.parallel_hmm = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-parallel-nni") == 0 || strcmp(argv[cnt], "--parallel-nni") == 0) {
+                params.parallel_nni = true;
+                continue;
+            }
+
 			if (strcmp(argv[cnt], "-f") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -3953,6 +4039,21 @@ void parseArg(int argc, char *argv[], Params &params) {
 				continue;
 			}
             
+            if (strcmp(argv[cnt], "--rf-engine") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --rf-engine map|table|day";
+                if (strcmp(argv[cnt], "map") == 0)
+                    params.rf_engine = RF_ENGINE_SPLIT_MAP;
+                else if (strcmp(argv[cnt], "table") == 0)
+                    params.rf_engine = RF_ENGINE_SPLIT_TABLE;
+                else if (strcmp(argv[cnt], "day") == 0)
+                    params.rf_engine = RF_ENGINE_DAY;
+                else
+                    throw "Use --rf-engine map|table|day";
+                continue;
+            }
+
             if (strcmp(argv[cnt], "--normalize-dist") == 0) {
                 params.normalize_tree_dist = true;
                 continue;
@@ -4297,6 +4398,15 @@ void parseArg(int argc, char *argv[], Params &params) {
 					throw "Epsilon must be positive";
 				continue;
 			}
+			if (strcmp(argv[cnt], "--ufboot-batch") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use --ufboot-batch <num_trees>";
+				params.ufboot_batch = convert_int(argv[cnt]);
+				if (params.ufboot_batch < 1)
+					throw "--ufboot-batch must be positive";
+				continue;
+			}
 			if (strcmp(argv[cnt], "-wbt") == 0 || strcmp(argv[cnt], "--wbt") == 0 || strcmp(argv[cnt], "--boot-trees") == 0) {
 				params.print_ufboot_trees = 1;
 				continue;
@@ -4661,6 +4771,11 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--mf-shared-tree") == 0) {
+                params.modelfinder_shared_tree = true;
+                continue;
+            }
+
             if (strcmp(argv[cnt], "-pars_ins") == 0) {
 				params.reinsert_par = true;
 				continue;
@@ -5321,6 +5436,16 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.print_all_checkpoints = true;
                 continue;
             }
+
+            if (strcmp(argv[cnt], "--ckp-binary") == 0) {
+                params.checkpoint_binary = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--ckp-async") == 0) {
+                params.checkpoint_async = true;
+                continue;
+            }
             
 			if (strcmp(argv[cnt], "--no-log") == 0) {
 				params.suppress_output_flags |= OUT_LOG;
@@ -5591,6 +5716,31 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
             
+            if (strcmp(argv[cnt], "--fenwick-sampler") == 0) {
+                params.alisim_fenwick_sampler = true;
+                continue;
+            }
+            
+            if (strcmp(argv[cnt], "--indel-rope") == 0) {
+                params.alisim_indel_rope = true;
+                continue;
+            }
+            
+            if (strcmp(argv[cnt], "--mpi-segments") == 0) {
+                params.alisim_mpi_segments = true;
+                continue;
+            }
+            
+            if (strcmp(argv[cnt], "--batch-replicates") == 0) {
+                params.alisim_batch_replicates = true;
+                continue;
+            }
+            
+            if (strcmp(argv[cnt], "--simd-sampling") == 0) {
+                params.alisim_simd_sampling = true;
+                continue;
+            }
+            
             if (strcmp(argv[cnt], "--num-alignments") == 0) {
                 cnt++;
                 if (cnt >= argc)
@@ -5928,6 +6078,8 @@ void usage_alisim(){
     << "  -t TREE_FILE              Set the input tree file name" << endl
     << "  --length LENGTH           Set the length of the root sequence" << endl
     << "  --num-alignments NUMBER   Set the number of output datasets" << endl
+    << "  --batch-replicates        Compute transition matrices once and share them" << endl
+    << "                            across all output datasets" << endl
     << "  --seqtype STRING          BIN, DNA, AA, CODON, MORPH{NUM_STATES} (default: auto-detect)" << endl
     << "                            For morphological data, 0<NUM_STATES<=32" << endl
     << "  --m MODEL_STRING          Specify the evolutionary model. See Manual for more detail" << endl
@@ -5936,6 +6088,12 @@ void usage_alisim(){
     << "  --indel <INS>,<DEL>       Set the insertion and deletion rate of the indel model,"<< endl
     << "                            relative to the substitution rate"<< endl
     << "  --indel-size <INS_DIS>,<DEL_DIS> Set the insertion and deletion size distributions" << endl
+    << "  --fenwick-sampler         Select sites of substitution/indel events in O(log L)" << endl
+    << "                            per event (rate-matrix simulation)" << endl
+    << "  --simd-sampling           Sample states by blocks of sites with SIMD compare-and-count" << endl
+    << "                            (transition-matrix simulation)" << endl
+    << "  --indel-rope              Keep sequences in chunks so that insertions do not" << endl
+    << "                            shift the whole sequence (long indel simulations)" << endl
     << "  --sub-level-mixture       Enable the feature to simulate substitution-level mixture model"<< endl
     << "  --no-unaligned            Disable outputing a file of unaligned sequences "<< endl
     << "                            when using indel models"<< endl
@@ -5961,6 +6119,8 @@ void usage_alisim(){
     << "                            are randomly generated and overridden." << endl
     << "  --branch-scale SCALE      Specify a value to scale all branch lengths" << endl
     << "  --single-output           Output all alignments into a single file" << endl
+    << "  --mpi-segments            Split the sites of each alignment across MPI processes," << endl
+    << "                            which write into a single output file (MPI version only)" << endl
     << "  --write-all               Enable outputting internal sequences" << endl
     << "  --seed NUM                Random seed number (default: CPU clock)" << endl
     << "                            Be careful to make the AliSim reproducible," << endl
@@ -5978,11 +6138,16 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  -s FILE[,...,FILE]   PHYLIP/FASTA/NEXUS/CLUSTAL/MSF alignment file(s)" << endl
     << "  -s DIR               Directory of alignment files" << endl
     << "  --seqtype STRING     BIN, DNA, AA, NT2AA, CODON, MORPH (default: auto-detect)" << endl
+    << "  --stream-aln         Read FASTA/PHYLIP in two passes to save memory" << endl
     << "  -t FILE|PARS|RAND    Starting tree (default: 99 parsimony and BIONJ)" << endl
     << "  -o TAX[,...,TAX]     Outgroup taxon (list) for writing .treefile" << endl
     << "  --prefix STRING      Prefix for all output files (default: aln/partition)" << endl
     << "  --seed NUM           Random seed number, normally used for debugging purpose" << endl
     << "  --safe               Safe likelihood kernel to avoid numerical underflow" << endl
+    << "  --lk-exp-scaling     Branch-free likelihood scaling for very deep trees" << endl
+    << "  --lk-float           Store partial likelihoods in single precision (half RAM)" << endl
+    << "  --cherry-lookup      Precompute cherries for all pairs of tip states (more RAM)" << endl
+    << "  --site-repeats       Compute partial likelihoods once per repeated subtree pattern" << endl
     << "  --mem NUM[G|M|%]     Maximal RAM usage in GB | MB | %" << endl
     << "  --runs NUM           Number of indepedent runs (default: 1)" << endl
     << "  -v, --verbose        Verbose mode, printing more messages to screen" << endl
@@ -5990,15 +6155,22 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --quiet              Quiet mode, suppress printing to screen (stdout)" << endl
     << "  -fconst f1,...,fN    Add constant patterns into alignment (N=no. states)" << endl
     << "  --epsilon NUM        Likelihood epsilon for parameter estimate (default 0.01)" << endl
+    << "  --analytic-grad      Analytic gradients for substitution model parameters" << endl
 #ifdef _OPENMP
     << "  -T NUM|AUTO          No. cores/threads or AUTO-detect (default: 1)" << endl
     << "  --threads-max NUM    Max number of threads for -T AUTO (default: all cores)" << endl
+    << "  --thread-pool        Run likelihood kernels on a persistent thread pool" << endl
+    << "  --subtree-tasks      Also spread independent subtrees over threads" << endl
+    << "  --parallel-nni       Evaluate NNIs of different branches on separate threads" << endl
+    << "  --parallel-hmm       Run HMM forward/backward passes on chunks of sites in parallel" << endl
 #endif
     << endl << "CHECKPOINT:" << endl
     << "  --redo               Redo both ModelFinder and tree search" << endl
     << "  --redo-tree          Restore ModelFinder and only redo tree search" << endl
     << "  --undo               Revoke finished run, used when changing some options" << endl
     << "  --cptime NUM         Minimum checkpoint interval (default: 60 sec and adapt)" << endl
+    << "  --ckp-binary         Write binary checkpoint .ckp.bin, appending only changed keys" << endl
+    << "  --ckp-async          Write checkpoint files in a background thread" << endl
     << endl << "PARTITION MODEL:" << endl
     << "  -p FILE|DIR          NEXUS/RAxML partition file or directory with alignments" << endl
     << "                       Edge-linked proportional partition model" << endl
@@ -6023,6 +6195,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --allnni             Perform more thorough NNI search (default: OFF)" << endl
     << "  -g FILE              (Multifurcating) topological constraint tree file" << endl
     << "  --fast               Fast search to resemble FastTree" << endl
+    << "  --ml-dist-eigen      Eigenspace kernel for initial ML distances" << endl
     << "  --polytomy           Collapse near-zero branches into polytomy" << endl
     << "  --tree-fix           Fix -t tree (no tree search performed)" << endl
     << "  --treels             Write locally optimal trees into .treels file" << endl
@@ -6044,6 +6217,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --nstep NUM          Iterations for UFBoot stopping rule (default: 100)" << endl
     << "  --bcor NUM           Minimum correlation coefficient (default: 0.99)" << endl
     << "  --beps NUM           RELL epsilon to break tie (default: 0.5)" << endl
+    << "  --ufboot-batch NUM   Compute RELL scores of NUM trees together (default: 1)" << endl
     << "  --bnni               Optimize UFBoot trees by NNI on bootstrap alignment" << endl
     << endl << "NON-PARAMETRIC BOOTSTRAP/JACKKNIFE:" << endl
     << "  -b, --boot NUM       Replicates for bootstrap + ML tree + consensus tree" << endl
@@ -6083,6 +6257,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --merit AIC|AICc|BIC  Akaike|Bayesian information criterion (default: BIC)" << endl
 //            << "  -msep                Perform model selection and then rate selection" << endl
     << "  --mtree              Perform full tree search for every model" << endl
+    << "  --mf-shared-tree     Reuse one tree and its buffers per thread for all models" << endl
     << "  --madd STR,...       List of mixture models to consider" << endl
     << "  --mdef FILE          Model definition NEXUS file (see Manual)" << endl
     << "  --modelomatic        Find best codon/protein/DNA models (Whelan et al. 2015)" << endl
@@ -6227,6 +6402,8 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  -g_print_induced     Write induced partition subtrees." << endl
     << "  -g_print_m           Write presence-absence matrix." << endl
     << "  -g_rm_leaves NUM     Invoke reverse analysis for complex datasets." << endl
+    << "  -g_par_depth NUM     Generate species-trees with -T threads, splitting the search" << endl
+    << "                       after the first NUM inserted taxa (default: 0, sequential)." << endl
     
     << endl << "GENOMIC EPIDEMIOLOGICAL ANALYSIS:" << endl
     << "  --pathogen           Apply CMAPLE tree search algorithm if sequence" << endl
@@ -6273,6 +6450,7 @@ void usage_iqtree(char* argv[], bool full_command) {
         << "  --tree-dist-all      Compute all-to-all RF distances for -t trees" << endl
         << "  --tree-dist FILE     Compute RF distances between -t trees and this set" << endl
         << "  --tree-dist2 FILE    Like -rf but trees can have unequal taxon sets" << endl
+        << "  --rf-engine STRING   map|table|day engine for --tree-dist-all (default: map)" << endl
     //            << "  -rf_adj              Computing RF distances of adjacent trees in <treefile>" << endl
     //            << "  -wja                 Write ancestral sequences by joint reconstruction" << endl
 
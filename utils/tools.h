@@ -408,6 +408,10 @@ const int RF_ALL_PAIR = 2;
 const int RF_TWO_TREE_SETS = 3;
 const int RF_TWO_TREE_SETS_EXTENDED = 4; // work for trees with non-equal taxon sets
 
+const int RF_ENGINE_SPLIT_MAP = 0;   // SplitIntMap per tree (default)
+const int RF_ENGINE_SPLIT_TABLE = 1; // one hashed split table for all trees
+const int RF_ENGINE_DAY = 2;         // Day's linear-time cluster table
+
 /**
         split weight summarization
  */
@@ -767,6 +771,12 @@ public:
      */
     double modelfinder_eps;
 
+    /**
+     TRUE to evaluate candidate models of ModelFinder on one tree per thread,
+     reusing partial likelihood buffers and warm-starting rate parameters
+     */
+    bool modelfinder_shared_tree;
+
     /**
      logl epsilon for Tree Mixture
      */
@@ -777,6 +787,11 @@ public:
      */
     double treemixhmm_eps;
 
+    /**
+     TRUE to run the forward/backward algorithm of HMM Tree Mixture on chunks of sites in parallel
+     */
+    bool parallel_hmm;
+
     /**
 	 *  New search heuristics (DEFAULT: ON)
 	 */
@@ -931,6 +946,9 @@ public:
     /** true if sequential phylip format is used, default: false (interleaved format) */
     bool phylip_sequential_format;
 
+    /** true to read FASTA/PHYLIP alignments in two passes without keeping all sequences in memory */
+    bool stream_alignment;
+
     /**
      SYMTEST_NONE to not perform test of symmetry of Jermiin et al. (default)
      SYMTEST_MAXDIV to perform symmetry test on the pair with maximum divergence
@@ -1067,6 +1085,12 @@ public:
      */
     int terrace_print_lim;
     
+    /**
+        parallel generation of terrace trees: the subtrees of the search below the insertion of the first
+        terrace_task_depth taxa are explored by different threads; 0 for sequential generation
+     */
+    int terrace_task_depth;
+    
     /**
         flag: only order pr_ab_matrix
      */
@@ -1281,6 +1305,12 @@ public:
      */
     bool compute_ml_dist;
 
+    /**
+            TRUE to evaluate ML distances in the eigenspace of the model,
+            contracting only the nonzero pair-frequency entries (--ml-dist-eigen)
+     */
+    bool ml_dist_eigen;
+
     /**
             TRUE to compute the maximum-likelihood tree
      */
@@ -1773,6 +1803,12 @@ public:
      *  Optimization algorithm for q-mixture model
      */
     string optimize_alg_qmix;
+
+    /**
+     *  TRUE to compute gradients of reversible substitution model parameters analytically
+     *  instead of by finite differences
+     */
+    bool analytic_gradient;
     
     /**
      * non-zero if want to estimate the initial frequency vectors for q-mixture model
@@ -1910,6 +1946,12 @@ public:
      true to compute distance between the same k-th tree in two sets
      */
     bool rf_same_pair;
+
+    /**
+     engine for all-pairs and adjacent-pairs RF distances:
+     RF_ENGINE_SPLIT_MAP, RF_ENGINE_SPLIT_TABLE or RF_ENGINE_DAY (--rf-engine)
+     */
+    int rf_engine;
     
     /**
      true to normalize tree distances, false otherwise
@@ -1973,6 +2015,27 @@ public:
     /** TRUE to force using non-reversible likelihood kernel */
     bool kernel_nonrev;
 
+    /** TRUE to rescale partial likelihoods branch-free by the exponent of their maximum, default: FALSE */
+    bool lk_exp_scaling;
+
+    /** TRUE to store partial likelihood vectors in single precision (float), default: FALSE */
+    bool lk_float;
+
+    /** TRUE to precompute partial likelihoods of cherries for all pairs of tip states, default: FALSE */
+    bool cherry_lookup;
+
+    /** TRUE to copy partial likelihoods of repeated subtree patterns instead of computing them, default: FALSE */
+    bool site_repeats;
+
+    /** TRUE to run multithreaded likelihood kernels on a persistent thread pool instead of OpenMP, default: FALSE */
+    bool thread_pool;
+
+    /** TRUE to compute independent subtrees of a traversal concurrently when the cost model favours it, default: FALSE */
+    bool subtree_tasks;
+
+    /** TRUE to evaluate NNIs of different branches concurrently, one tree copy per thread, default: FALSE */
+    bool parallel_nni;
+
     /**
      	 	WSL_NONE: do not print anything
             WSL_SITE: print site log-likelihood
@@ -2197,6 +2260,12 @@ public:
 	 */
 	double ufboot_epsilon;
 
+    /**
+            number of candidate trees whose RELL scores are computed together
+            with a blocked kernel (1: one tree at a time)
+     */
+    int ufboot_batch;
+
     /**
             TRUE to check with different max_candidate_trees
      */
@@ -2439,6 +2508,12 @@ public:
     /** TRUE to print checkpoints to 1.ckp.gz, 2.ckp.gz,... */
     bool print_all_checkpoints;
 
+    /** TRUE to write checkpoint as binary log .ckp.bin, appending only changed keys at each dump */
+    bool checkpoint_binary;
+
+    /** TRUE to write checkpoint files in a background thread */
+    bool checkpoint_async;
+
     /** control output files to be written
      * OUT_LOG
      * OUT_TREEFILE
@@ -2712,6 +2787,31 @@ public:
     */
     bool indel_rate_variation;
     
+    /**
+    *  TRUE to select sites of Gillespie events from a Fenwick tree over site rates (O(log L) per event)
+    */
+    bool alisim_fenwick_sampler;
+    
+    /**
+    *  TRUE to keep the evolving sequence in a chunked rope during indel simulation
+    */
+    bool alisim_indel_rope;
+    
+    /**
+    *  TRUE to split the sites of each alignment across MPI processes instead of distributing whole alignments
+    */
+    bool alisim_mpi_segments;
+    
+    /**
+    *  TRUE to compute the transition matrices of each branch once and share them across all simulated alignments
+    */
+    bool alisim_batch_replicates;
+    
+    /**
+    *  TRUE to sample states in the transition-matrix simulation by blocks of sites with vectorized compare-and-count
+    */
+    bool alisim_simd_sampling;
+    
     /**
     *  AliSim-OpenMP algorithm
     */